@@ -0,0 +1,106 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Ensayo de relé en el sitio (atr)
+ * Como el pre-inicio, el robot gira sin avanzar: primero se centra con el PID durante
+ * AUTOTUNE_RELAY_CENTER_MS y luego el PID se sustituye por un relé de ±AUTOTUNE_RELAY_OUTPUT (%)
+ * con histéresis de ±AUTOTUNE_RELAY_HYSTERESIS (posición). Tras AUTOTUNE_RELAY_SETTLE_CYCLES
+ * ciclos de asentamiento se miden AUTOTUNE_RELAY_CYCLES oscilaciones; sin completarlas en
+ * AUTOTUNE_RELAY_TIMEOUT_MS o si se pierde la línea el ensayo falla
+ *
+ */
+#define AUTOTUNE_RELAY_OUTPUT 15
+#define AUTOTUNE_RELAY_HYSTERESIS 8
+#define AUTOTUNE_RELAY_CENTER_MS 300
+#define AUTOTUNE_RELAY_SETTLE_CYCLES 2
+#define AUTOTUNE_RELAY_CYCLES 6
+#define AUTOTUNE_RELAY_TIMEOUT_MS 5000
+
+/**
+ * @brief Twiddle (descenso por coordenadas) sobre Kp y Kd de un punto de la tabla (att)
+ * Cada vuelta completa evalúa un candidato: error medio |posición| (décimas) más
+ * AUTOTUNE_TWIDDLE_LOSS_PENALTY por cada pérdida de línea; si la recuperación no encuentra la
+ * línea puntúa AUTOTUNE_TWIDDLE_FAIL_SCORE. El paso empieza en AUTOTUNE_TWIDDLE_STEP (fracción de
+ * la ganancia, o AUTOTUNE_TWIDDLE_MIN_KP/KD si es 0), crece ×AUTOTUNE_TWIDDLE_GROW al mejorar y
+ * se reduce ×AUTOTUNE_TWIDDLE_SHRINK si no; termina cuando ambos pasos bajan de
+ * AUTOTUNE_TWIDDLE_TOLERANCE (fracción de la ganancia) o tras AUTOTUNE_TWIDDLE_MAX_EVALUATIONS vueltas
+ *
+ */
+#define AUTOTUNE_TWIDDLE_STEP 0.2f
+#define AUTOTUNE_TWIDDLE_MIN_KP 0.02f
+#define AUTOTUNE_TWIDDLE_MIN_KD 0.1f
+#define AUTOTUNE_TWIDDLE_GROW 1.2f
+#define AUTOTUNE_TWIDDLE_SHRINK 0.7f
+#define AUTOTUNE_TWIDDLE_TOLERANCE 0.05f
+#define AUTOTUNE_TWIDDLE_MAX_EVALUATIONS 40
+#define AUTOTUNE_TWIDDLE_LOSS_PENALTY 500
+#define AUTOTUNE_TWIDDLE_FAIL_SCORE 5000
+
+/**
+ * @brief Estados del ensayo de relé
+ *
+ */
+enum AUTOTUNE_RELAY_STATES {
+  AUTOTUNE_RELAY_RUNNING,   // Centrando o midiendo oscilaciones
+  AUTOTUNE_RELAY_DONE,      // Oscilaciones medidas: Ku y Tu disponibles
+  AUTOTUNE_RELAY_LOST,      // Línea perdida durante el ensayo
+  AUTOTUNE_RELAY_TIMEOUT    // Sin oscilación estable en AUTOTUNE_RELAY_TIMEOUT_MS
+};
+
+/**
+ * @brief Estados del Twiddle
+ *
+ */
+enum AUTOTUNE_TWIDDLE_STATES {
+  AUTOTUNE_TWIDDLE_OFF,
+  AUTOTUNE_TWIDDLE_RUNNING,  // Cada carrera prueba candidatos en el punto elegido
+  AUTOTUNE_TWIDDLE_DONE      // Convergido: la mejor pareja queda como propuesta
+};
+
+/**
+ * @brief Ganancias propuestas (ata[n] las aplica al punto seleccionado con pt)
+ * Las tres primeras salen del ensayo de relé con Ku y Tu; la última del Twiddle
+ *
+ */
+enum AUTOTUNE_PROPOSALS {
+  AUTOTUNE_PROPOSAL_PD,               // Ziegler-Nichols PD: Kp 0.8 Ku, Td Tu/8
+  AUTOTUNE_PROPOSAL_PID,              // Ziegler-Nichols PID: Kp 0.6 Ku, Ti Tu/2, Td Tu/8
+  AUTOTUNE_PROPOSAL_PID_NO_OVERSHOOT, // PID sin sobreoscilación: Kp 0.2 Ku, Ti Tu/2, Td Tu/3
+  AUTOTUNE_PROPOSAL_TWIDDLE           // Mejor Kp/Kd del Twiddle con el Ki del punto
+};
+#define AUTOTUNE_PROPOSALS_COUNT (AUTOTUNE_PROPOSAL_TWIDDLE + 1)
+
+/**
+ * @brief Resultado del ensayo de relé
+ * ku: ganancia última (% de corrección por unidad de posición, como Kp); tu_us: periodo último
+ *
+ */
+struct autotune_relay_result_t {
+  bool valid;
+  float ku;
+  unsigned long tu_us;
+  int amplitude;
+  int cycles;
+};
+
+void autotune_relay_start();
+AUTOTUNE_RELAY_STATES autotune_relay_update(int position, bool line_detected, unsigned long period_us,
+                                            int *correction);
+bool autotune_relay();
+const autotune_relay_result_t *get_autotune_relay_result();
+
+bool set_autotune_twiddle(bool enabled, int point);
+AUTOTUNE_TWIDDLE_STATES get_autotune_twiddle_state();
+void autotune_twiddle_start();
+void autotune_twiddle_update(int position, bool line_lost);
+void autotune_twiddle_fail();
+void autotune_twiddle_stop();
+
+bool get_autotune_proposal(int proposal, float *kp, float *ki, float *kd);
+void print_autotune_twiddle();
+void print_autotune();
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,126 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <Arduino.h>
+#include <sensors.h>
+#include <control.h>
+
+/**
+ * @brief Capacidad del buffer circular de la caja negra (tramas, potencia de 2)
+ * 4096 tramas x 60 bytes = 240 KB en PSRAM (~4 s a 1 kHz)
+ * Sin PSRAM se reserva BLACKBOX_FALLBACK_CAPACITY en RAM interna
+ *
+ */
+#define BLACKBOX_CAPACITY 4096
+#define BLACKBOX_FALLBACK_CAPACITY 512
+
+/**
+ * @brief Volcado a la partición "blackbox" de la flash (ver partitions.csv)
+ * Se hace desde la tarea de interfaz BLACKBOX_COMMIT_DELAY_MS después de detener la carrera,
+ * con los motores ya deshabilitados, copiando bloques de BLACKBOX_COMMIT_CHUNK a RAM interna
+ *
+ */
+#define BLACKBOX_COMMIT_DELAY_MS 1500
+#define BLACKBOX_COMMIT_CHUNK 4096
+#define BLACKBOX_MAGIC 0x42424845  // "EHBB"
+#define BLACKBOX_VERSION 3
+
+/**
+ * @brief Tamaño del texto de la configuración en el volcado (format_blackbox_config)
+ *
+ */
+#define BLACKBOX_CONFIG_TEXT_MAX 1024
+
+/**
+ * @brief Motivo por el que se congeló la caja negra
+ *
+ */
+enum BLACKBOX_REASONS {
+  BLACKBOX_REASON_NONE,
+  BLACKBOX_REASON_LINE_LOST,  // La recuperación no encontró la línea
+  BLACKBOX_REASON_MANUAL,     // Comando x
+  BLACKBOX_REASON_BUTTON      // Botón durante la carrera
+};
+#define BLACKBOX_REASONS_COUNT (BLACKBOX_REASON_BUTTON + 1)
+
+/**
+ * @brief Trama de un ciclo de control
+ * frame_us: instante de la trama de sensores; race_ms: tiempo de carrera de la rampa de aceleración
+ * (con ambos y los sensores RAW, sim/replay.cpp reproduce el ciclo exactamente)
+ * rate: variación de la posición filtrada (posición/s); integral: término integral (unidades de corrección)
+ * flags: bits TELEMETRY_FLAG_*; recovery: RECOVERY_STATES
+ *
+ */
+struct __attribute__((packed, aligned(4))) blackbox_frame_t {
+  uint32_t us;
+  uint32_t frame_us;
+  uint32_t race_ms;
+  uint16_t sensors[SENSORS_COUNT];
+  int16_t position;
+  int32_t rate;
+  int16_t integral;
+  int16_t correction;
+  int8_t speed;
+  int8_t left_speed;
+  int8_t right_speed;
+  uint8_t fan_speed;
+  uint8_t flags;
+  uint8_t recovery;
+};
+
+/**
+ * @brief Configuración del control en el momento de congelar (la que produjo las tramas)
+ * Con ella y las tramas RAW sim/replay.cpp reproduce la carrera sin depender de la
+ * configuración actual del robot ni de la línea de comandos
+ *
+ */
+struct blackbox_config_t {
+  uint16_t sensors_min[SENSORS_COUNT];
+  uint16_t sensors_max[SENSORS_COUNT];
+  uint16_t sensors_threshold[SENSORS_COUNT];
+  uint16_t sensors_noise;
+  uint8_t position_mode;
+  uint8_t smoothing;
+  uint8_t base_speed;
+  uint8_t base_accel_speed;
+  uint8_t brake_max;
+  uint8_t decay_mode;
+  uint16_t d_filter_hz;
+  uint16_t pwm_hz;
+  uint8_t pwm_resolution;
+  uint8_t estimator_enabled;
+  uint8_t reserved[2];
+  float estimator_process_noise;
+  float pid_gains[PID_SCHEDULE_POINTS][3];
+};
+
+/**
+ * @brief Cabecera del volcado en flash; se escribe después de las tramas, así que un volcado
+ * interrumpido queda sin magic y no se confunde con uno válido
+ *
+ */
+struct blackbox_header_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t frame_size;
+  uint32_t frames;
+  uint32_t period_us;
+  uint32_t stop_us;
+  uint8_t reason;
+  uint8_t reserved[3];
+  blackbox_config_t config;
+};
+
+void init_blackbox();
+void get_blackbox_config(blackbox_config_t *config);
+int format_blackbox_config(const blackbox_config_t *config, unsigned long period_us, char *text, size_t size);
+void blackbox_start();
+void blackbox_record(const blackbox_frame_t *frame);
+void blackbox_trigger(BLACKBOX_REASONS reason);
+void blackbox_stop(unsigned long period_us);
+bool blackbox_commit_pending();
+bool blackbox_commit();
+void print_blackbox_status();
+bool print_blackbox_dump(unsigned long window_ms);
+
+#endif // BLACKBOX_H
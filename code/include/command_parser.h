@@ -0,0 +1,35 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <Arduino.h>
+#include <commands.h>
+
+/**
+ * @brief Resultado de procesar un byte del puerto serie
+ *
+ */
+enum COMMAND_PARSER_EVENTS {
+  COMMAND_PARSER_NONE,      // Comando incompleto
+  COMMAND_PARSER_TEXT,      // Línea de texto completa (sin espacios al principio ni al final)
+  COMMAND_PARSER_BINARY,    // Comando binario con CRC correcto
+  COMMAND_PARSER_TOO_LONG,  // Línea de texto demasiado larga: se descarta hasta el fin de línea
+  COMMAND_PARSER_BAD_CRC    // Comando binario con CRC incorrecto
+};
+
+/**
+ * @brief Comando completo
+ * text: línea de texto (COMMAND_PARSER_TEXT), válida hasta el siguiente byte
+ * id, length, value: comando binario (COMMAND_PARSER_BINARY); value es 0 si length es 0
+ *
+ */
+struct command_parser_result_t {
+  const char *text;
+  uint8_t id;
+  uint8_t length;
+  float value;
+};
+
+void command_parser_reset();
+COMMAND_PARSER_EVENTS command_parser_feed(uint8_t byte, command_parser_result_t *result);
+
+#endif // COMMAND_PARSER_H
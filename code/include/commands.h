@@ -0,0 +1,98 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Tamaño máximo de una línea de comando de texto (incluido el terminador)
+ * Las líneas más largas se descartan completas
+ *
+ */
+#define COMMANDS_BUFFER_SIZE 32
+
+/**
+ * @brief Formato de los comandos binarios (mismo encuadre que la telemetría)
+ * [0xA5 0x5A] [id] [longitud 0 o 4] [valor float32 LE] [CRC16 LE de id, longitud y valor]
+ *
+ */
+#define COMMANDS_SYNC_0 0xA5
+#define COMMANDS_SYNC_1 0x5A
+#define COMMANDS_MAX_PAYLOAD 4
+
+/**
+ * @brief Valor absoluto máximo de un comando (texto o binario)
+ * Los valores no finitos o mayores se rechazan antes de llegar al handler: muchos los
+ * convierten a int
+ *
+ */
+#define COMMANDS_VALUE_MAX 1000000.0f
+
+/**
+ * @brief Identificadores de los comandos en formato binario
+ *
+ */
+enum COMMAND_IDS {
+  CMD_START = 0x01,           // s
+  CMD_STOP = 0x02,            // x
+  CMD_SENSORS_RAW = 0x03,     // r
+  CMD_SENSORS_CAL = 0x04,     // c
+  CMD_SPEED = 0x05,           // v[num]
+  CMD_ACCEL = 0x06,           // a[num]
+  CMD_FAN = 0x07,             // f[num]
+  CMD_CALIBRATE = 0x08,       // cal
+  CMD_POSITION_MODE = 0x09,   // m[0/1]
+  CMD_TELEMETRY = 0x0A,       // t[0/1]
+  CMD_TELEMETRY_STATUS = 0x0B,// ts
+  CMD_BENCHMARK = 0x0C,       // bench
+  CMD_SAVE = 0x0D,            // save
+  CMD_LOAD = 0x0E,            // load
+  CMD_ERASE = 0x0F,           // erase
+  CMD_PROFILER = 0x10,        // prof
+  CMD_PROFILER_RESET = 0x11,  // profr
+  CMD_MAP = 0x12,             // map
+  CMD_MAP_LEARN = 0x13,       // learn
+  CMD_MAP_REPLAY = 0x14,      // replay[0/1]
+  CMD_MAP_STRAIGHT = 0x15,    // vr[num]
+  CMD_MAP_CURVE = 0x16,       // vc[num]
+  CMD_PID = 0x17,             // pid
+  CMD_PID_POINT = 0x18,       // pt[num]
+  CMD_PID_KP = 0x19,          // kp[num]
+  CMD_PID_KI = 0x1A,          // ki[num]
+  CMD_PID_KD = 0x1B,          // kd[num]
+  CMD_CONTROL_PERIOD = 0x1C,  // loop[num]
+  CMD_PID_D_FILTER = 0x1D,    // fd[num]
+  CMD_BRAKE = 0x1E,           // bk[num]
+  CMD_DECAY_MODE = 0x1F,      // dm[0/1]
+  CMD_PWM_FREQUENCY = 0x20,   // pwmf[num]
+  CMD_PWM_RESOLUTION = 0x21,  // pwmr[num]
+  CMD_FAN_STATUS = 0x22,      // fan
+  CMD_SUCTION = 0x23,         // suc
+  CMD_SUCTION_ENABLE = 0x24,  // sch[0/1]
+  CMD_SUCTION_POINT = 0x25,   // spt[num]
+  CMD_SUCTION_FAN = 0x26,     // sfan[num]
+  CMD_SUCTION_CURVE = 0x27,   // scv[num]
+  CMD_SUCTION_BRAKE = 0x28,   // sbk[num]
+  CMD_SUCTION_RAMP = 0x29,    // sramp[num]
+  CMD_RECOVERY = 0x2A,        // rec
+  CMD_SMOOTHING = 0x2B,       // sfl[num]
+  CMD_SENSORS_BENCH = 0x2C,   // benchs
+  CMD_AUTO_CALIBRATE = 0x2D,  // acal
+  CMD_MARKERS = 0x2E,         // mk
+  CMD_LAPS = 0x2F,            // laps
+  CMD_LAPS_TARGET = 0x30,     // lapn[num]
+  CMD_LAPS_SOURCE = 0x31,     // lps[0/1]
+  CMD_LAPS_CLEAR = 0x32,      // lapc
+  CMD_BLACKBOX = 0x33,        // bb
+  CMD_BLACKBOX_DUMP = 0x34,   // bbd[ms]
+  CMD_AUTOTUNE = 0x35,        // at
+  CMD_AUTOTUNE_RELAY = 0x36,  // atr
+  CMD_AUTOTUNE_TWIDDLE = 0x37, // att[0/1]
+  CMD_AUTOTUNE_APPLY = 0x38,  // ata[num]
+  CMD_ESTIMATOR = 0x39,       // kf[0/1]
+  CMD_ESTIMATOR_NOISE = 0x3A  // kfq[num]
+};
+
+void process_commands();
+void print_commands_help();
+
+#endif // COMMANDS_H
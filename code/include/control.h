@@ -5,25 +5,114 @@
 #include <sensors.h>
 #include <motors.h>
 #include <utils.h>
+#include <telemetry.h>
 
 /**
- * @brief Constantes del controlador PID
+ * @brief Constantes del controlador PID (valores iniciales de todos los puntos de la tabla)
+ * Ki por cada CONTROL_REFERENCE_US y Kd sobre la variación de la posición en CONTROL_REFERENCE_US
  *
  */
 #define PID_KP 0.2
+#define PID_KI 0.0
 #define PID_KD 0.80
 
 /**
- * @brief Tiempo de espera entre ejecuciones del bucle de control en microsegundos
+ * @brief Tabla de ganancias por velocidad (gain scheduling)
+ * Entre dos puntos las ganancias se interpolan linealmente; fuera de la tabla se usan las del extremo
+ * Se ajustan en marcha por serial (pt, kp, ki, kd) y se guardan con save
+ *
+ */
+#define PID_SCHEDULE_POINTS 3
+#define PID_SCHEDULE_SPEEDS {30, 60, 90}
+#define PID_SCHEDULE_GAINS {{PID_KP, PID_KI, PID_KD}, {PID_KP, PID_KI, PID_KD}, {PID_KP, PID_KI, PID_KD}}
+
+/**
+ * @brief Anti-windup del término integral
+ * El integral se limita a ±PID_INTEGRAL_LIMIT (% de corrección) y deja de acumular
+ * mientras la salida está saturada (±PID_OUTPUT_LIMIT) en el sentido del error
+ *
+ */
+#define PID_INTEGRAL_LIMIT 20
+#define PID_OUTPUT_LIMIT 100
+
+/**
+ * @brief Selección de la ruta de control en punto fijo (compilación)
+ * 0: PID y velocidades en float (por defecto)
+ * 1: PID en formato Q16, posición sin divisiones y velocidad→PWM por tabla
+ * Se activa con el entorno esp32-s3-zero-fixed de platformio.ini
+ *
+ */
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT 0
+#endif
+#define CONTROL_Q 16
+#define CONTROL_Q_ONE (1L << CONTROL_Q)
+
+/**
+ * @brief Iteraciones por defecto del benchmark del bucle de control
+ *
+ */
+#define CONTROL_BENCHMARK_ITERATIONS 1000
+
+/**
+ * @brief Periodo del bucle de control en microsegundos (valor inicial)
+ * Lo marca un temporizador hardware que despierta la tarea de control
+ * Se ajusta en marcha entre CONTROL_LOOP_MIN_US y CONTROL_LOOP_MAX_US; Ki y Kd están
+ * normalizadas a CONTROL_REFERENCE_US, así que cambiar el periodo no exige reajustarlas
  *
  */
 #define CONTROL_LOOP_US 1000
+#define CONTROL_LOOP_MIN_US 250
+#define CONTROL_LOOP_MAX_US 2000
+#define CONTROL_REFERENCE_US 1000
+
+/**
+ * @brief Filtro paso bajo de primer orden del término derivativo
+ * Frecuencia de corte en Hz (0 = sin filtro)
+ *
+ */
+#define PID_D_FILTER_HZ 150
+#define PID_D_FILTER_MAX_HZ 1000
+
+/**
+ * @brief Frenado activo al bajar la velocidad objetivo (entrada a curvas del mapa de pista)
+ * Un modelo de primer orden estima la velocidad real de las ruedas; si supera a la objetivo en más
+ * de CONTROL_BRAKE_MARGIN (%), ambos motores frenan con CONTROL_BRAKE_GAIN % de par por cada %
+ * de exceso, hasta el par máximo (0 = sin frenado activo, se decelera por rozamiento)
+ *
+ */
+#define CONTROL_BRAKE_MAX 60
+#define CONTROL_BRAKE_MARGIN 3
+#define CONTROL_BRAKE_GAIN 4
+#define CONTROL_SPEED_TAU_US 40000
+
+/**
+ * @brief Giro en el sitio de la calibración automática
+ * Alterna el sentido cada CALIBRATION_SWING_MS (el primer medio giro dura la mitad) para que la
+ * línea barra la regleta de un extremo al otro; al terminar completa el vaivén y para centrado
+ *
+ */
+#define CALIBRATION_SPIN_SPEED 10
+#define CALIBRATION_SWING_MS 300
+
+/**
+ * @brief Configuración de la tarea de control
+ * Núcleo 1 con prioridad alta; la interfaz (botón, serial, LED) queda en el núcleo 0
+ * Timer hardware 0 a 1 MHz (APB 80 MHz / 80)
+ *
+ */
+#define CONTROL_TASK_CORE 1
+#define CONTROL_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define CONTROL_TASK_STACK 4096
+#define CONTROL_TIMER_NUM 0
+#define CONTROL_TIMER_DIVIDER 80
 
 /**
- * @brief Tiempo máximo sin detectar línea antes de detener el robot (ms)
+ * @brief Velocidades por defecto (0-100%) hasta cargar la configuración de NVS o cambiarlas por comando
  *
  */
-#define LINE_LOST_TIMEOUT_MS 250
+#define BASE_SPEED 30
+#define BASE_ACCEL_SPEED 60
 
 /**
  * @brief Velocidad de la turbina durante la carrera (0-100%)
@@ -34,14 +123,33 @@
 void set_base_speed(int speed);
 void set_base_accel_speed(int accel_speed);
 void set_base_fan_speed(int speed);
+int get_base_speed();
+int get_base_accel_speed();
 int get_base_fan_speed();
 void set_race_started(bool started);
 void set_race_starting(bool starting);
 bool is_race_started();
 bool is_race_starting();
 long get_race_started_ms();
+unsigned long get_race_elapsed_ms();
 long get_race_stopped_ms();
 void initial_control_loop();
 void control_loop();
+bool set_calibration_spin(bool spinning);
+bool is_calibration_spinning();
+bool start_autotune_relay();
+bool is_autotune_relay_running();
+void init_control_task(unsigned long period_us);
+void benchmark_control(int iterations);
+void set_pid_gains(int point, float kp, float ki, float kd);
+void get_pid_gains(int point, float *kp, float *ki, float *kd);
+int get_pid_schedule_speed(int point);
+void print_pid_gains();
+void set_control_period_us(unsigned long period_us);
+unsigned long get_control_period_us();
+void set_pid_d_filter_hz(int cutoff_hz);
+int get_pid_d_filter_hz();
+void set_brake_max(int brake);
+int get_brake_max();
 
 #endif // CONTROL_H
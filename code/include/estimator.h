@@ -0,0 +1,61 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <Arduino.h>
+#include <sensors.h>
+
+/**
+ * @brief Estimador de la línea (filtro de Kalman de velocidad constante)
+ * Estado: posición de la línea (-255 a 255) y su variación por CONTROL_REFERENCE_US, la misma
+ * unidad que el derivativo del PID. Cada trama de sensores con línea corrige el estado con la
+ * varianza de la posición calculada a partir del ruido medido en la calibración
+ * (get_sensor_position_noise); entre tramas el estado se mantiene
+ * Ruido de proceso: aceleración blanca de densidad ESTIMATOR_PROCESS_NOISE (posición² por ms³);
+ * más alto sigue antes los cambios de curva, más bajo filtra más
+ *
+ */
+#define ESTIMATOR_PROCESS_NOISE 0.25f
+#define ESTIMATOR_PROCESS_NOISE_MAX 100.0f
+#define ESTIMATOR_RATE_VARIANCE 100.0f
+#define ESTIMATOR_MEASUREMENT_SIGMA_MIN 0.5f
+
+/**
+ * @brief Compensación de la latencia
+ * El controlador recibe la posición extrapolada desde la muestra hasta que la corrección llega
+ * a los motores: edad de la trama + media trama de adquisición (ESTIMATOR_ACQUISITION_US) +
+ * medio periodo de control + medio periodo del PWM. Sin línea la extrapolación desde la última
+ * muestra se limita a ESTIMATOR_MAX_HORIZON_US
+ *
+ */
+#define ESTIMATOR_ACQUISITION_US (SENSORS_MUX_STATES * SENSORS_MUX_SLOT_US / 2)
+#define ESTIMATOR_MAX_HORIZON_US 5000
+
+/**
+ * @brief Estado del filtro: posición y variación con su covarianza, instante de la última
+ * trama incorporada y varianza de la medida
+ *
+ */
+struct estimator_state_t {
+  bool ready;
+  unsigned long us;
+  float measurement_variance;
+  float position;
+  float rate;
+  float covariance_pp;
+  float covariance_pr;
+  float covariance_rr;
+};
+
+void estimator_start(float measurement_sigma);
+void estimator_update(int position, unsigned long frame_us);
+float estimator_predict(unsigned long now_us, unsigned long latency_us, float *rate);
+void get_estimator_state(estimator_state_t *saved);
+void set_estimator_state(const estimator_state_t *saved);
+unsigned long get_estimator_latency_us();
+void set_estimator_enabled(bool enabled);
+bool is_estimator_enabled();
+void set_estimator_process_noise(float noise);
+float get_estimator_process_noise();
+void print_estimator();
+
+#endif // ESTIMATOR_H
@@ -0,0 +1,56 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#include <pinout.h>
+
+/**
+ * @brief Capa de abstracción del hardware
+ * Todo el acceso a periféricos de sensores, control, motores y utilidades pasa por aquí
+ * Implementaciones:
+ * - src/hal_esp32.cpp: robot (ADC con DMA, LEDC, RMT, temporizador hardware, FreeRTOS)
+ * - sim/hal_native.cpp: simulador en el PC (entorno native de platformio.ini)
+ *
+ */
+
+// Tiempo
+unsigned long hal_millis();
+unsigned long hal_micros();
+void hal_delay_ms(unsigned long ms);
+uint32_t hal_cycles();
+uint32_t hal_cycles_per_us();
+
+// Entradas/salidas digitales
+void hal_gpio_output(int pin);
+void hal_gpio_input(int pin, bool pullup);
+void hal_gpio_write(int pin, bool level);
+bool hal_gpio_read(int pin);
+
+// Adquisición de los sensores en segundo plano
+bool hal_sensors_start();
+bool hal_sensors_read_frame(uint16_t *raw, unsigned long *count, unsigned long *us);
+unsigned long hal_sensors_missed_slots();
+
+// Salidas PWM
+void hal_pwm_setup(int channel, int frequency_hz, int resolution_bits, int pin);
+void hal_pwm_write(int channel, uint32_t duty);
+void hal_pwm_sync_channels(const int *channels, int count);
+void hal_pwm_write_sync(const int *channels, const uint32_t *duties, int count);
+
+// Turbina por DShot (RMT): trama de 16 bits y respuesta con el eRPM en modo bidireccional
+bool hal_dshot_start(int pin, int bitrate_kbps, bool bidirectional);
+void hal_dshot_write(uint16_t frame);
+bool hal_dshot_read_response(uint32_t *levels);
+
+// Memoria externa (PSRAM, NULL si no hay) y partición "blackbox" de la flash (ver partitions.csv)
+void *hal_psram_alloc(size_t size);
+size_t hal_blackbox_partition_size();
+bool hal_blackbox_partition_erase(size_t size);
+bool hal_blackbox_partition_write(size_t offset, const void *data, size_t size);
+bool hal_blackbox_partition_read(size_t offset, void *data, size_t size);
+
+// Ejecución periódica del bucle de control
+void hal_control_timer_start(unsigned long period_us, void (*tick)(uint32_t ticks));
+void hal_control_timer_set_period(unsigned long period_us);
+
+#endif // HAL_H
@@ -0,0 +1,89 @@
+#ifndef LAPS_H
+#define LAPS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Origen de las vueltas
+ *
+ */
+enum LAPS_SOURCES {
+  LAPS_SOURCE_MARKER,  // Marca lateral derecha de salida/meta (la primera abre la vuelta 1)
+  LAPS_SOURCE_SIGNAL   // Flanco de subida de la señal de START (la salida abre la vuelta 1)
+};
+
+/**
+ * @brief Fin de la carrera
+ * Se detiene al completar LAPS_TARGET vueltas (0 = sin límite) o si pasan LAPS_TIMEOUT_MS
+ * sin cruzar la línea de meta; las marcas a menos de LAPS_MIN_LAP_MS de la anterior se ignoran
+ *
+ */
+#define LAPS_TARGET 3
+#define LAPS_TIMEOUT_MS 30000
+#define LAPS_MIN_LAP_MS 1000
+
+/**
+ * @brief Vueltas guardadas por carrera y carreras guardadas en el historial (RAM y NVS)
+ *
+ */
+#define LAPS_MAX 16
+#define LAPS_HISTORY 8
+
+/**
+ * @brief Estadísticas de una vuelta
+ * Error: |posición| (0-255), la media en décimas; saturado: tiempo con alguna rueda al 100%
+ *
+ */
+struct lap_stats_t {
+  uint32_t time_ms;
+  uint16_t mean_error;
+  uint8_t max_error;
+  uint8_t line_losses;
+  uint32_t saturated_ms;
+};
+
+/**
+ * @brief Resumen de una carrera (solo vueltas completas)
+ *
+ */
+struct laps_run_t {
+  uint16_t run;
+  uint8_t laps;
+  uint8_t base_speed;
+  uint32_t best_ms;
+  uint32_t total_ms;
+  uint16_t mean_error;
+  uint8_t max_error;
+  uint8_t line_losses;
+  uint32_t saturated_ms;
+};
+
+/**
+ * @brief Historial de carreras: las LAPS_HISTORY últimas, de la más antigua a la más reciente
+ *
+ */
+struct laps_history_t {
+  uint16_t next_run;
+  uint8_t count;
+  laps_run_t runs[LAPS_HISTORY];
+};
+
+void laps_start(int base_speed);
+bool laps_update(int position, bool line_lost, bool saturated, unsigned long period_us);
+bool laps_crossed_line();
+void laps_signal_mark();
+void laps_stop();
+bool laps_take_summary();
+void set_laps_source(LAPS_SOURCES source);
+LAPS_SOURCES get_laps_source();
+void set_laps_target(int laps);
+int get_laps_target();
+int get_laps_count();
+const lap_stats_t *get_lap_stats(int lap);
+void get_laps_history(laps_history_t *history);
+void set_laps_history(const laps_history_t *history);
+void clear_laps_history();
+void print_laps_run();
+void print_laps_history();
+
+#endif // LAPS_H
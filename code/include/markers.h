@@ -0,0 +1,89 @@
+#ifndef MARKERS_H
+#define MARKERS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Patrones de una trama de sensores binarizada
+ *
+ */
+enum MARKER_TYPES {
+  MARKER_NONE,      // Solo la línea (o ningún sensor)
+  MARKER_LEFT,      // Marca lateral a la izquierda de la línea (curvas)
+  MARKER_RIGHT,     // Marca lateral a la derecha de la línea (salida/meta)
+  MARKER_CROSSING,  // Cruce: casi todos los sensores, o marcas a ambos lados
+  MARKER_WIDE       // Línea más ancha de lo normal sin marcas separadas
+};
+#define MARKER_TYPES_COUNT (MARKER_WIDE + 1)
+
+/**
+ * @brief Clasificación de la trama
+ * Un grupo es una racha de sensores contiguos sobre el umbral; el de la línea es el más cercano
+ * a la última posición y los demás son marcas. La línea ocupa como mucho MARKERS_LINE_MAX_SENSORS;
+ * con MARKERS_CROSSING_SENSORS o más sensores la trama es un cruce
+ *
+ */
+#define MARKERS_LINE_MAX_SENSORS 4
+#define MARKERS_CROSSING_SENSORS 10
+
+/**
+ * @brief Histéresis de los eventos (tramas)
+ * Un patrón se publica tras MARKERS_CONFIRM_FRAMES tramas seguidas y termina tras
+ * MARKERS_RELEASE_FRAMES sin él; la posición se protege desde la primera trama
+ *
+ */
+#define MARKERS_CONFIRM_FRAMES 2
+#define MARKERS_RELEASE_FRAMES 4
+
+/**
+ * @brief Tiempo máximo manteniendo la posición en un cruce o línea ancha (ms)
+ * Pasado este tiempo la trama deja de tratarse como cruce (robot sobre una zona negra)
+ *
+ */
+#define MARKERS_HOLD_MAX_MS 60
+
+/**
+ * @brief Capacidad de la cola de eventos (potencia de 2)
+ *
+ */
+#define MARKERS_QUEUE_SIZE 16
+
+/**
+ * @brief Evento de marca: tipo e instante de la primera trama con el patrón
+ *
+ */
+struct marker_event_t {
+  MARKER_TYPES type;
+  unsigned long us;
+};
+
+/**
+ * @brief Estado de la clasificación, la histéresis y los eventos publicados
+ * La cola solo se guarda por su cabeza: restaurarla descarta los eventos publicados después
+ *
+ */
+struct markers_state_t {
+  unsigned long last_frame_us;
+  MARKER_TYPES last_type;
+  uint16_t last_line;
+  unsigned long hold_start_us;
+  bool holding;
+  MARKER_TYPES candidate_type;
+  int candidate_frames;
+  unsigned long candidate_us;
+  MARKER_TYPES active_type;
+  int release_frames;
+  uint32_t queue_head;
+  unsigned long counts[MARKER_TYPES_COUNT];
+};
+
+MARKER_TYPES markers_classify(uint16_t detected, int last_position, unsigned long frame_us, uint16_t *line);
+void markers_reset();
+bool markers_pop_event(marker_event_t *event);
+MARKER_TYPES get_marker_active();
+unsigned long get_marker_count(MARKER_TYPES type);
+void get_markers_state(markers_state_t *saved);
+void set_markers_state(const markers_state_t *saved);
+void print_markers();
+
+#endif // MARKERS_H
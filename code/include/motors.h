@@ -7,8 +7,8 @@
 /**
  * @brief Configuración de los motores de tracción
  * Canales: 0 a 3
- * Frecuencia: 5 kHz
- * Resolución: 10 bits
+ * Frecuencia: 5 kHz (valor inicial, ajustable en marcha)
+ * Resolución: 10 bits (valor inicial, ajustable en marcha)
  * Rango: 0 a 1023
  *
  */
@@ -21,6 +21,30 @@
 #define PWM_MOTORS_MAX 1023
 #define PWM_MOTORS_MIN 0
 
+/**
+ * @brief Límites de la configuración del PWM de los motores en marcha
+ * El LEDC cuenta con el reloj APB (80 MHz): frecuencia * 2^resolución no puede superarlo
+ *
+ */
+#define PWM_MOTORS_MIN_HZ 1000
+#define PWM_MOTORS_MAX_HZ 40000
+#define PWM_MOTORS_MIN_RESOLUTION 8
+#define PWM_MOTORS_MAX_RESOLUTION 12
+#define PWM_MOTORS_CLOCK_HZ 80000000UL
+
+/**
+ * @brief Modos de decaimiento de la corriente durante la parte apagada del PWM (driver RZ7886)
+ * - MOTORS_DECAY_SLOW: alterna marcha y freno (A=HIGH, B=HIGH); velocidad casi lineal con el ciclo
+ *   de trabajo y el motor retiene al soltar el acelerador
+ * - MOTORS_DECAY_FAST: alterna marcha y rueda libre (A=LOW, B=LOW); la corriente cae rápido y
+ *   el motor no frena por sí solo
+ *
+ */
+enum MOTORS_DECAY_MODES {
+  MOTORS_DECAY_SLOW,
+  MOTORS_DECAY_FAST,
+};
+
 /**
  * @brief Configuración del ESC de la turbina/succión
  * Canal: 4
@@ -35,9 +59,78 @@
 #define PWM_FAN_MAX 204      // 2000μs (máxima velocidad)
 #define PWM_FAN_MIN 102      // 1000μs (apagado/mínimo)
 
+/**
+ * @brief Protocolo del ESC de la turbina (compilación)
+ * 0: PWM de servo a 50 Hz (por defecto, ~100 pasos útiles)
+ * 300 / 600: DShot300 / DShot600 por RMT (2000 pasos, una trama por ciclo de control)
+ * Se activa con el entorno esp32-s3-zero-dshot de platformio.ini
+ *
+ */
+#ifndef FAN_PROTOCOL
+#define FAN_PROTOCOL 0
+#endif
+
+/**
+ * @brief DShot bidireccional: el ESC responde a cada trama con su eRPM (requiere firmware
+ * del ESC con soporte, p. ej. BLHeli_32 o Bluejay); polos del motor para pasar eRPM a RPM
+ *
+ */
+#ifndef FAN_DSHOT_BIDIRECTIONAL
+#define FAN_DSHOT_BIDIRECTIONAL 1
+#endif
+#define FAN_MOTOR_POLES 14
+
+/**
+ * @brief Resolución del mando de la turbina (pasos de 0 a FAN_THROTTLE_MAX)
+ * En DShot el valor se envía tal cual (48-2047); en PWM se reduce al rango 102-204
+ *
+ */
+#define FAN_THROTTLE_MAX 2000
+#define DSHOT_THROTTLE_MIN 48
+
+/**
+ * @brief Tiempo de armado del ESC en ms
+ * El ESC necesita ver la señal mínima durante un tiempo (2-3 segundos en PWM, unos cientos de
+ * ms de tramas a cero en DShot); mientras tanto el resto del arranque continúa y
+ * set_fan_speed mantiene la señal mínima
+ *
+ */
+#if FAN_PROTOCOL
+#define FAN_ARMING_MS 500
+#else
+#define FAN_ARMING_MS 2000
+#endif
+
+/**
+ * @brief Tiempo que los motores siguen habilitados tras detener la carrera (ms)
+ *
+ */
+#define MOTORS_STOP_GRACE_MS 1000
+
 void init_motors();
+void set_motors_enabled(bool enabled);
+bool are_motors_enabled();
 void set_motors_speed(float velI, float velD);
+void set_motors_speed_pct(int velI, int velD);
+void get_motors_speed_duties(float velI, float velD, uint32_t *duties);
+void get_motors_speed_pct_duties(int velI, int velD, uint32_t *duties);
+void set_motors_torque(int torqueI, int torqueD);
+void brake_motors(int strength);
+void set_motors_decay_mode(enum MOTORS_DECAY_MODES mode);
+enum MOTORS_DECAY_MODES get_motors_decay_mode();
+bool set_motors_pwm(int frequency_hz, int resolution_bits);
+int get_motors_pwm_hz();
+int get_motors_pwm_resolution();
 void set_fan_speed(int vel);
+void set_fan_throttle(int throttle);
+void update_fan();
+long get_fan_rpm();
+void print_fan_status();
+bool is_fan_armed();
 void stop_motors();
+#if FAN_PROTOCOL
+uint16_t dshot_frame(uint16_t value);
+bool dshot_decode_erpm(uint32_t levels, uint32_t *erpm);
+#endif
 
 #endif // MOTORS_H
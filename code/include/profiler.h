@@ -0,0 +1,64 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include <hal.h>
+
+/**
+ * @brief Activación del perfilador del bucle de control (compilación)
+ * 0: las macros PROFILE_* no generan código
+ *
+ */
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+/**
+ * @brief Histograma logarítmico de cada etapa para estimar el p99
+ * 32 octavas x 8 subdivisiones: error máximo del 12.5% en el percentil
+ *
+ */
+#define PROFILER_SUB_BITS 3
+#define PROFILER_BUCKETS (32 << PROFILER_SUB_BITS)
+
+/**
+ * @brief Histograma de jitter del periodo del bucle: 1 μs por barra, de -32 a +31 μs
+ * Los valores fuera de rango se acumulan en las barras de los extremos
+ *
+ */
+#define PROFILER_JITTER_BINS 64
+
+/**
+ * @brief Etapas medidas del bucle de control
+ *
+ */
+enum PROFILER_STAGES {
+  STAGE_ACQUISITION,  // update_sensors: copia y procesado de la última trama (en cada ciclo)
+  STAGE_POSITION,     // get_sensor_position sobre la trama ya procesada
+  STAGE_PID,          // calc_correction
+  STAGE_MOTORS,       // Salida a motores
+  STAGE_TELEMETRY,    // Trama de telemetría
+  STAGE_LOOP,         // Ciclo completo de la tarea de control
+  STAGE_COUNT
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_BEGIN(name) uint32_t name##_profile_cycles = hal_cycles()
+#define PROFILE_END(stage, name) profiler_record(stage, hal_cycles() - name##_profile_cycles)
+#define PROFILE_LOOP_START(period_us, ticks) profiler_loop_start(period_us, ticks)
+#define PROFILE_LOOP_END() profiler_loop_end()
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END(stage, name) ((void)0)
+#define PROFILE_LOOP_START(period_us, ticks) ((void)0)
+#define PROFILE_LOOP_END() ((void)0)
+#endif
+
+void profiler_record(PROFILER_STAGES stage, uint32_t cycles);
+void profiler_loop_start(unsigned long period_us, uint32_t ticks);
+void profiler_loop_end();
+uint32_t get_profiler_percentile(PROFILER_STAGES stage, int percentile);
+void print_profiler_stats();
+void reset_profiler_stats();
+
+#endif // PROFILER_H
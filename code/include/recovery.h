@@ -0,0 +1,44 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Estados de la recuperación de línea
+ *
+ */
+enum RECOVERY_STATES {
+  RECOVERY_TRACKING,  // Línea detectada: manda el PID
+  RECOVERY_GAP,       // Hueco (línea discontinua): sigue recto con el último giro
+  RECOVERY_SEARCH,    // Búsqueda girando hacia el lado por el que se salió la línea
+  RECOVERY_REVERSE,   // Búsqueda en reversa, girando hacia el mismo lado
+  RECOVERY_ABORT      // Sin línea tras todas las búsquedas: se detiene la carrera
+};
+
+/**
+ * @brief Elección del estado al perder la línea
+ * La última posición se extrapola RECOVERY_TREND_MS con su variación; si queda a menos de
+ * RECOVERY_GAP_POSITION del centro se asume un hueco, si no la línea se salió por ese lado
+ *
+ */
+#define RECOVERY_TREND_MS 20
+#define RECOVERY_GAP_POSITION 100
+
+/**
+ * @brief Duración máxima de cada estado (ms) y mandos durante la búsqueda (%)
+ *
+ */
+#define RECOVERY_GAP_MS 80
+#define RECOVERY_SEARCH_MS 300
+#define RECOVERY_REVERSE_MS 400
+#define RECOVERY_SEARCH_SPEED 25
+#define RECOVERY_SEARCH_TURN 35
+#define RECOVERY_REVERSE_SPEED 20
+
+void recovery_start();
+RECOVERY_STATES recovery_update(bool line_detected, int position, long position_rate, int correction,
+                                int speed, unsigned long period_us, int *left_speed, int *right_speed);
+RECOVERY_STATES get_recovery_state();
+void print_recovery_stats();
+
+#endif // RECOVERY_H
@@ -24,19 +24,132 @@
  */
 #define SENSORS_POSITION_MAX 255
 
+/**
+ * @brief Modos de cálculo de la posición sobre la línea
+ *
+ */
+enum POSITION_MODES {
+  POSITION_BINARY,    // Sensores binarizados con el umbral de calibración
+  POSITION_ANALOG     // Sensores normalizados 0..1 con interpolación entre sensores
+};
+
+/**
+ * @brief Parámetros del modo de posición analógico
+ * Ventana: sensores a cada lado del pico que entran en el centroide
+ * Suelo: valor normalizado por debajo del cual un sensor no aporta (ruido del fondo)
+ * Detección: valor normalizado mínimo del pico para considerar que hay línea
+ *
+ */
+#define SENSORS_ANALOG_WINDOW 2
+#define SENSORS_ANALOG_FLOOR 0.15f
+#define SENSORS_ANALOG_DETECT 0.5f
+
+/**
+ * @brief Etapa de procesado de la trama (arrays int16 alineados, uno por magnitud)
+ * Normalizado Q12: 0 (fondo) a 4096 (línea) = (raw - min) * ganancia >> SENSORS_GAIN_SHIFT,
+ * con ganancia = 4096 << SENSORS_GAIN_SHIFT / rango; limitada a SENSORS_GAIN_MAX para que la
+ * diferencia del filtro quepa en 16 bits (rangos menores de 1024 saturan antes de llegar a 1)
+ * Suavizado IIR por canal: s += (n - s) * alfa >> 15, alfa = 1 - suavizado (0-90%)
+ *
+ */
+#define SENSORS_NORM_Q 12
+#define SENSORS_NORM_ONE (1L << SENSORS_NORM_Q)
+#define SENSORS_GAIN_SHIFT 8
+#define SENSORS_GAIN_MAX 1024
+#define SENSORS_SMOOTHING_MAX 90
+
+/**
+ * @brief Procesado vectorial de la trama con esp-dsp (instrucciones SIMD del ESP32-S3)
+ * 0: bucle escalar (PC y otros chips); el resultado es idéntico en ambos casos
+ *
+ */
+#ifndef SENSORS_SIMD
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define SENSORS_SIMD 1
+#else
+#define SENSORS_SIMD 0
+#endif
+#endif
+#define SENSORS_BENCHMARK_ITERATIONS 1000
+
 /**
  * @brief Tiempo de calibración de sensores en ms
+ * Manual: siempre SENSORS_CALIBRATION_MS; automática: hasta que todos los sensores tengan
+ * contraste, como mínimo SENSORS_AUTO_CALIBRATION_MIN_MS y como máximo SENSORS_AUTO_CALIBRATION_MS
  *
  */
 #define SENSORS_CALIBRATION_MS 3000
+#define SENSORS_AUTO_CALIBRATION_MIN_MS 300
+#define SENSORS_AUTO_CALIBRATION_MS 4000
+
+/**
+ * @brief Estadística de la calibración
+ * Cada sensor acumula un histograma de SENSORS_HISTOGRAM_BINS intervalos (32 cuentas cada uno);
+ * mínimo y máximo son los percentiles bajo y alto, de forma que los picos de ruido aislados
+ * no ensanchan el rango. Un sensor tiene contraste si máximo - mínimo >= SENSORS_CALIBRATION_CONTRAST
+ *
+ */
+#define SENSORS_HISTOGRAM_BINS 128
+#define SENSORS_HISTOGRAM_SHIFT 5
+#define SENSORS_CALIBRATION_LOW_PCT 2
+#define SENSORS_CALIBRATION_HIGH_PCT 98
+#define SENSORS_CALIBRATION_CONTRAST 1000
+
+/**
+ * @brief Ruido de los sensores medido en la calibración (desviación típica en cuentas del ADC)
+ * Con las muestras del fondo (bajo el umbral) de cada sensor: σ = (mediana - percentil bajo) / 2.054,
+ * interpolando dentro de los intervalos del histograma, y media de los sensores con al menos
+ * SENSORS_NOISE_MIN_SAMPLES muestras de fondo. Hasta la primera calibración, SENSORS_NOISE_DEFAULT
+ *
+ */
+#define SENSORS_NOISE_DEFAULT 20
+#define SENSORS_NOISE_MIN_SAMPLES 100
+
+/**
+ * @brief Configuración de la adquisición continua por DMA
+ * El ADC1 convierte de forma continua SENSOR_1_8 (GPIO8 = ADC1_CH7) y SENSOR_9_16 (GPIO7 = ADC1_CH6)
+ * Un temporizador avanza los multiplexores cada SENSORS_MUX_SLOT_US y se queda con la última
+ * conversión de cada canal de la ranura. Al cambiar de estado, el DMA aún guarda conversiones
+ * del anterior (menos de una interrupción, más la que está en curso), así que las
+ * SENSORS_MUX_SETTLE_CONV primeras de cada canal en cada ranura se descartan; a 80 kHz quedan
+ * 2 de 4 por canal
+ * Trama completa de 16 sensores: 8 ranuras x 100 µs = 800 µs (1.25 kHz)
+ *
+ */
+#define SENSORS_ADC_CHANNEL_1_8 7
+#define SENSORS_ADC_CHANNEL_9_16 6
+#define SENSORS_ADC_SAMPLE_HZ 80000       // Conversiones por segundo (ambos canales)
+#define SENSORS_ADC_CONV_PER_INTR 4       // Conversiones por interrupción del DMA (50 µs)
+#define SENSORS_MUX_SLOT_US 100           // Duración de cada estado del multiplexor
+#define SENSORS_MUX_STATES 8
+#define SENSORS_MUX_SETTLE_CONV (SENSORS_ADC_CONV_PER_INTR / 2)  // Por canal y ranura
 
 void init_sensors();
+void update_sensors();
 void calibrate_sensors();
+bool calibrate_sensors_auto();
+void get_sensors_calibration(int *min, int *max, int *threshold);
+void set_sensors_calibration(const int *min, const int *max, const int *threshold);
+int get_sensors_noise();
+void set_sensors_noise(int noise);
+float get_sensor_position_noise();
 int get_sensor_raw(int sensor);
+void get_sensors_raw_frame(uint16_t *values);
 int get_sensor_calibrated(int sensor);
+float get_sensor_normalized(int sensor);
 int get_sensor_position(int last_position);
+void set_sensor_position_mode(POSITION_MODES mode);
+POSITION_MODES get_sensor_position_mode();
 long get_last_line_detected_ms();
+bool is_line_detected();
+void set_line_detected(bool detected, long detected_ms);
+unsigned long get_sensors_frame_count();
+unsigned long get_sensors_frame_us();
+unsigned long get_sensors_missed_slots();
 void print_sensors_raw();
 void print_sensors_calibrated();
+void set_sensors_smoothing(int smoothing);
+int get_sensors_smoothing();
+void benchmark_sensors(int iterations);
 
 #endif // SENSORS_H
@@ -0,0 +1,81 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+#include <sensors.h>
+#include <control.h>
+#include <suction.h>
+#include <laps.h>
+
+/**
+ * @brief Espacio de nombres y clave de la configuración en NVS
+ *
+ */
+#define STORAGE_NAMESPACE "ehecatl"
+#define STORAGE_KEY_CONFIG "config"
+#define STORAGE_KEY_LAPS "laps"
+
+/**
+ * @brief Versión del formato de la configuración guardada
+ * Incrementar al cambiar storage_config_t: las configuraciones de otra versión se ignoran
+ *
+ */
+#define STORAGE_VERSION 9
+
+/**
+ * @brief Configuración persistente: calibración de sensores y parámetros de ajuste
+ * crc: CRC32 de todos los campos anteriores
+ *
+ */
+struct storage_config_t {
+  uint16_t version;
+  uint16_t size;
+  int16_t sensors_min[SENSORS_COUNT];
+  int16_t sensors_max[SENSORS_COUNT];
+  int16_t sensors_threshold[SENSORS_COUNT];
+  uint8_t base_speed;
+  uint8_t base_accel_speed;
+  uint8_t base_fan_speed;
+  uint8_t position_mode;
+  uint8_t map_speed_straight;
+  uint8_t map_speed_curve;
+  float pid_gains[PID_SCHEDULE_POINTS][3];
+  uint16_t control_period_us;
+  uint16_t pid_d_filter_hz;
+  uint8_t brake_max;
+  uint8_t motors_decay_mode;
+  uint8_t motors_pwm_resolution;
+  uint16_t motors_pwm_hz;
+  uint8_t suction_enabled;
+  uint8_t suction_fan[SUCTION_SCHEDULE_POINTS];
+  uint8_t suction_curve_gain;
+  uint8_t suction_brake_boost;
+  uint16_t suction_ramp;
+  uint8_t sensors_smoothing;
+  uint8_t laps_target;
+  uint8_t laps_source;
+  uint16_t sensors_noise;
+  uint8_t estimator_enabled;
+  float estimator_process_noise;
+  uint32_t crc;
+};
+
+/**
+ * @brief Historial de carreras guardado aparte de la configuración (se reescribe tras cada carrera)
+ * crc: CRC32 de todos los campos anteriores
+ *
+ */
+struct storage_laps_t {
+  uint16_t version;
+  uint16_t size;
+  laps_history_t history;
+  uint32_t crc;
+};
+
+bool save_config();
+bool load_config();
+void erase_config();
+bool save_laps_history();
+bool load_laps_history();
+
+#endif // STORAGE_H
@@ -0,0 +1,50 @@
+#ifndef SUCTION_H
+#define SUCTION_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Tabla de succión en recta por velocidad (0-100%)
+ * Entre dos puntos se interpola linealmente; fuera de la tabla se usa el del extremo
+ * Se ajusta en marcha por serial (spt, sfan) y se guarda con save
+ *
+ */
+#define SUCTION_SCHEDULE_POINTS 3
+#define SUCTION_SCHEDULE_SPEEDS {0, 40, 80}
+#define SUCTION_SCHEDULE_FAN {70, 55, 70}
+
+/**
+ * @brief Succión extra en curvas y al frenar (% de turbina)
+ * CURVE_GAIN se suma entero con la línea en el extremo de la regleta (|posición| 255) o
+ * cuando la posición varía a SUCTION_RATE_FULL unidades por segundo; se toma el mayor de los dos
+ *
+ */
+#define SUCTION_CURVE_GAIN 25
+#define SUCTION_RATE_FULL 2000
+#define SUCTION_BRAKE_BOOST 15
+
+/**
+ * @brief Variación máxima del mando de la turbina (%/s)
+ *
+ */
+#define SUCTION_RAMP_PCT_PER_S 200
+#define SUCTION_RAMP_MAX_PCT_PER_S 2000
+
+void suction_update(int speed, int position, long position_rate, bool braking, int fan_max,
+                    unsigned long period_us);
+void suction_reset();
+int get_suction_fan_speed();
+void set_suction_enabled(bool enabled);
+bool is_suction_enabled();
+void set_suction_fan(int point, int fan);
+int get_suction_fan(int point);
+int get_suction_speed(int point);
+void set_suction_curve_gain(int gain);
+int get_suction_curve_gain();
+void set_suction_brake_boost(int boost);
+int get_suction_brake_boost();
+void set_suction_ramp(int pct_per_s);
+int get_suction_ramp();
+void print_suction();
+
+#endif // SUCTION_H
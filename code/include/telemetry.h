@@ -0,0 +1,92 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <sensors.h>
+
+/**
+ * @brief Capacidad del buffer circular de telemetría (tramas, potencia de 2)
+ * 4096 tramas x 48 bytes = 192 KB en PSRAM (~1 s a 4 kHz)
+ * Sin PSRAM se reserva TELEMETRY_FALLBACK_CAPACITY en RAM interna
+ *
+ */
+#define TELEMETRY_CAPACITY 4096
+#define TELEMETRY_FALLBACK_CAPACITY 256
+
+/**
+ * @brief Configuración de la tarea de envío (núcleo 0, prioridad baja)
+ * Periodo de la trama de estado con las tramas descartadas: 100 ms
+ *
+ */
+#define TELEMETRY_TASK_CORE 0
+#define TELEMETRY_TASK_PRIORITY 2
+#define TELEMETRY_TASK_STACK 4096
+#define TELEMETRY_STATUS_MS 100
+
+/**
+ * @brief Puerto de envío: USB CDC nativo del ESP32-S3
+ *
+ */
+#if ARDUINO_USB_CDC_ON_BOOT
+#define TELEMETRY_SERIAL Serial
+#else
+#define TELEMETRY_SERIAL USBSerial
+#endif
+
+/**
+ * @brief Formato de los paquetes en el stream binario
+ * [0xA5 0x5A] [tipo] [longitud] [datos...] [CRC16 LE de tipo, longitud y datos]
+ *
+ */
+#define TELEMETRY_SYNC_0 0xA5
+#define TELEMETRY_SYNC_1 0x5A
+#define TELEMETRY_PACKET_FRAME 0x01
+#define TELEMETRY_PACKET_STATUS 0x02
+
+/**
+ * @brief Trama de telemetría de un ciclo de control
+ * seq crece en cada intento de escritura, así que los huecos en el receptor son tramas descartadas
+ *
+ */
+struct __attribute__((packed, aligned(4))) telemetry_frame_t {
+  uint32_t seq;
+  uint32_t us;
+  uint16_t sensors[SENSORS_COUNT];
+  int16_t position;
+  int16_t correction;
+  int8_t left_speed;
+  int8_t right_speed;
+  uint8_t fan_speed;
+  uint8_t flags;
+};
+
+/**
+ * @brief Paquete de estado enviado cada TELEMETRY_STATUS_MS
+ *
+ */
+struct __attribute__((packed)) telemetry_status_t {
+  uint32_t pushed;
+  uint32_t dropped;
+  uint16_t capacity;
+  uint16_t used;
+};
+
+/**
+ * @brief Bits del campo flags de la trama
+ *
+ */
+#define TELEMETRY_FLAG_RACE_STARTED 0x01
+#define TELEMETRY_FLAG_RACE_STARTING 0x02
+#define TELEMETRY_FLAG_LINE_LOST 0x04
+#define TELEMETRY_FLAG_BRAKING 0x08
+#define TELEMETRY_FLAG_MARKER 0x10
+#define TELEMETRY_FLAG_CROSSING 0x20
+
+void init_telemetry();
+bool telemetry_push(telemetry_frame_t *frame);
+void set_telemetry_streaming(bool streaming);
+bool is_telemetry_streaming();
+unsigned long get_telemetry_dropped();
+void print_telemetry_status();
+
+#endif // TELEMETRY_H
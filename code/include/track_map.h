@@ -0,0 +1,65 @@
+#ifndef TRACK_MAP_H
+#define TRACK_MAP_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Modos del mapa de pista
+ *
+ */
+enum TRACK_MAP_MODES {
+  TRACK_MAP_OFF,      // Velocidad base fija en toda la pista
+  TRACK_MAP_LEARN,    // Vuelta de aprendizaje a velocidad base: se graba el mapa
+  TRACK_MAP_REPLAY    // Se reproduce el perfil de velocidad calculado del mapa
+};
+
+/**
+ * @brief Tramos del mapa (bins) y su longitud
+ * La distancia se estima integrando la velocidad de los motores: 1 unidad = 1% durante 1 ms
+ * (sin encoders; la respuesta de los motores se aproxima con un filtro de primer orden)
+ *
+ */
+#define TRACK_MAP_BINS 1024
+#define TRACK_MAP_BIN_UNITS 2000
+#define TRACK_MAP_MIN_BINS 8
+#define TRACK_MAP_MOTOR_SHIFT 5
+
+/**
+ * @brief Curvatura estimada por tramo: (izq - der) / (izq + der) en Q7
+ * Por debajo de STRAIGHT el tramo es recta; a partir de CURVE se aplica la velocidad de curva
+ *
+ */
+#define TRACK_MAP_STRAIGHT_K 6
+#define TRACK_MAP_CURVE_K 40
+
+/**
+ * @brief Perfil de velocidad (0-100%)
+ * Velocidades por defecto de recta y curva, variación máxima por tramo al frenar y al acelerar,
+ * y tramos de anticipación para compensar la respuesta de los motores
+ *
+ */
+#define TRACK_MAP_SPEED_STRAIGHT 70
+#define TRACK_MAP_SPEED_CURVE 40
+#define TRACK_MAP_BRAKE_PER_BIN 6
+#define TRACK_MAP_ACCEL_PER_BIN 3
+#define TRACK_MAP_LOOKAHEAD_BINS 3
+
+/**
+ * @brief Segmentos (rectas y curvas) que se imprimen del mapa
+ *
+ */
+#define TRACK_MAP_MAX_SEGMENTS 64
+
+void set_track_map_mode(TRACK_MAP_MODES mode);
+TRACK_MAP_MODES get_track_map_mode();
+void set_track_map_speeds(int straight_speed, int curve_speed);
+int get_track_map_straight_speed();
+int get_track_map_curve_speed();
+void track_map_start();
+void track_map_lap(int laps);
+void track_map_update(int left_speed, int right_speed);
+void track_map_stop();
+int get_track_map_speed(int base_speed);
+void print_track_map();
+
+#endif // TRACK_MAP_H
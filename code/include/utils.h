@@ -28,7 +28,7 @@ BTN_STATES get_btn_state();
 long get_btn_pressing_ms();
 bool get_start_signal();
 void set_led(bool state);
-void blink_led(int interval_ms);
+void blink_led(unsigned long interval_ms);
 void set_fan(int speed);
 
 #endif // UTILS_H
@@ -0,0 +1,83 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+/**
+ * @brief Sustituto mínimo de Arduino.h para compilar el código del robot en el PC
+ * Solo cubre lo que usan los módulos compilados en el entorno native; el acceso
+ * al hardware va por hal.h (sim/hal_native.cpp)
+ *
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define PI 3.1415926535897932384626433832795
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::max;
+using std::min;
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/**
+ * @brief Salida serie del simulador (stdout)
+ * Se puede silenciar para las simulaciones largas o capturar en las pruebas unitarias
+ *
+ */
+class SimSerial {
+public:
+  bool quiet = false;
+  std::string *capture = nullptr;
+
+  void print(const char *value) { write("%s", value); }
+  void print(char value) { write("%c", value); }
+  void print(int value) { write("%d", value); }
+  void print(unsigned int value) { write("%u", value); }
+  void print(long value) { write("%ld", value); }
+  void print(unsigned long value) { write("%lu", value); }
+  void print(long long value) { write("%lld", value); }
+  void print(unsigned long long value) { write("%llu", value); }
+  void print(double value, int digits = 2) { write("%.*f", digits, value); }
+
+  void println() { write("\n"); }
+  template <typename T> void println(T value) {
+    print(value);
+    println();
+  }
+  void println(double value, int digits) {
+    print(value, digits);
+    println();
+  }
+
+private:
+  template <typename... Args> void write(const char *format, Args... args) {
+    if (capture != nullptr) {
+      int length = snprintf(nullptr, 0, format, args...);
+      size_t start = capture->size();
+      capture->resize(start + length + 1);
+      snprintf(&(*capture)[start], length + 1, format, args...);
+      capture->resize(start + length);
+    } else if (!quiet) {
+      printf(format, args...);
+    }
+  }
+};
+
+extern SimSerial Serial;
+
+// Salida analógica heredada de utils.cpp; sin efecto en el simulador
+inline void analogWrite(int pin, int value) {}
+
+#endif // ARDUINO_SHIM_H
@@ -0,0 +1,24 @@
+#ifndef ESP_ROM_CRC_SHIM_H
+#define ESP_ROM_CRC_SHIM_H
+
+/**
+ * @brief Sustituto de esp_rom_crc.h para compilar en el PC
+ * Mismo resultado que la función de la ROM del ESP32: con semilla 0 es el CRC-16/X-25
+ * (polinomio 0x1021 reflejado, valor inicial y XOR final 0xFFFF)
+ *
+ */
+
+#include <stdint.h>
+
+inline uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+#endif // ESP_ROM_CRC_SHIM_H
@@ -0,0 +1,334 @@
+#include <hal.h>
+#include <motors.h>
+#include <sensors.h>
+#include <simulator.h>
+#include <chrono>
+
+SimSerial Serial;
+
+static uint64_t sim_time_us = 0;
+
+static bool gpio_levels[64];
+static uint32_t pwm_duties[16];
+static uint32_t pwm_max[16];
+
+static uint16_t frame_raw[SENSORS_COUNT];
+static unsigned long frame_count = 0;
+static unsigned long frame_us = 0;
+static bool frame_fresh = false;
+static uint64_t frame_last_us = 0;
+
+static void (*control_tick)(uint32_t ticks) = NULL;
+static unsigned long control_period_us = 0;
+static uint64_t control_next_us = 0;
+
+// Reproducción de un registro: sin física, tramas y reloj del registro (sim/replay.cpp)
+static bool replay_mode = false;
+static unsigned long replay_ms = 0;
+
+/**
+ * @brief Tiempo: el reloj lo avanza el simulador, no el reloj del PC
+ * Al reproducir un registro los ms también vienen del registro
+ *
+ */
+unsigned long hal_millis() {
+  return replay_mode ? replay_ms : sim_time_us / 1000;
+}
+
+unsigned long hal_micros() {
+  return sim_time_us;
+}
+
+void hal_delay_ms(unsigned long ms) {
+  hal_native_run_us((uint64_t)ms * 1000);
+}
+
+/**
+ * @brief Ciclos: nanosegundos reales del PC, para medir el coste del código en el benchmark
+ *
+ */
+uint32_t hal_cycles() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t hal_cycles_per_us() {
+  return 1000;
+}
+
+/**
+ * @brief Entradas/salidas digitales: solo se guarda el nivel (botón sin pulsar por el pull-up)
+ *
+ */
+void hal_gpio_output(int pin) {
+  gpio_levels[pin] = LOW;
+}
+
+void hal_gpio_input(int pin, bool pullup) {
+  gpio_levels[pin] = pullup;
+}
+
+void hal_gpio_write(int pin, bool level) {
+  gpio_levels[pin] = level;
+}
+
+bool hal_gpio_read(int pin) {
+  return gpio_levels[pin];
+}
+
+/**
+ * @brief Salidas PWM: se guarda el ciclo de trabajo para el modelo de los motores
+ *
+ */
+void hal_pwm_setup(int channel, int frequency_hz, int resolution_bits, int pin) {
+  pwm_duties[channel] = 0;
+  pwm_max[channel] = (1UL << resolution_bits) - 1;
+}
+
+void hal_pwm_write(int channel, uint32_t duty) {
+  pwm_duties[channel] = duty;
+}
+
+void hal_pwm_sync_channels(const int *channels, int count) {}
+
+void hal_pwm_write_sync(const int *channels, const uint32_t *duties, int count) {
+  for (int i = 0; i < count; i++) {
+    pwm_duties[channels[i]] = duties[i];
+  }
+}
+
+/**
+ * @brief Turbina por DShot: un ESC simulado que responde con el eRPM del mando recibido
+ * La respuesta se codifica como el ESC real (GCR y cambios de nivel) para ejercitar el decodificador
+ *
+ */
+#define SIM_FAN_ERPM_PER_STEP 100
+
+static bool dshot_bidirectional = false;
+static bool dshot_response_ready = false;
+static uint32_t dshot_response = 0;
+
+bool hal_dshot_start(int pin, int bitrate_kbps, bool bidirectional) {
+  dshot_bidirectional = bidirectional;
+  dshot_response_ready = false;
+  return true;
+}
+
+void hal_dshot_write(uint16_t frame) {
+  static const uint8_t nibble_gcr[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F,
+  };
+  if (!dshot_bidirectional) {
+    return;
+  }
+
+  // eRPM → periodo eléctrico en μs → mantisa de 9 bits y exponente de 3
+  uint16_t throttle = frame >> 5;
+  uint32_t erpm = throttle >= 48 ? (throttle - 47) * SIM_FAN_ERPM_PER_STEP : 0;
+  uint16_t value = 0x0FFF;
+  if (erpm > 0) {
+    uint32_t period_us = 60000000UL / erpm;
+    int exponent = 0;
+    while (period_us > 0x01FF) {
+      period_us >>= 1;
+      exponent++;
+    }
+    // Periodos que no caben en 3 bits de exponente: el ESC lo da por parado
+    value = exponent <= 7 ? (exponent << 9) | period_us : 0x0FFF;
+  }
+  uint16_t crc = ~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F;
+  uint16_t packet = (value << 4) | crc;
+
+  uint32_t gcr = 0;
+  for (int nibble = 3; nibble >= 0; nibble--) {
+    gcr = (gcr << 5) | nibble_gcr[(packet >> (nibble * 4)) & 0x0F];
+  }
+  // Bit de inicio en bajo y un cambio de nivel por cada 1 del código GCR
+  uint32_t levels = 0;
+  uint32_t level = 0;
+  for (int bit = 19; bit >= 0; bit--) {
+    level ^= (gcr >> bit) & 1;
+    levels |= level << bit;
+  }
+  dshot_response = levels;
+  dshot_response_ready = true;
+}
+
+bool hal_dshot_read_response(uint32_t *levels) {
+  if (!dshot_response_ready) {
+    return false;
+  }
+  dshot_response_ready = false;
+  *levels = dshot_response;
+  return true;
+}
+
+/**
+ * @brief Sensores: el simulador genera una trama cada SENSORS_MUX_STATES ranuras, como el DMA
+ *
+ */
+bool hal_sensors_start() {
+  frame_fresh = false;
+  frame_last_us = sim_time_us;
+  return true;
+}
+
+bool hal_sensors_read_frame(uint16_t *raw, unsigned long *count, unsigned long *us) {
+  if (!frame_fresh) {
+    return false;
+  }
+  frame_fresh = false;
+  memcpy(raw, frame_raw, sizeof(frame_raw));
+  *count = frame_count;
+  *us = frame_us;
+  return true;
+}
+
+unsigned long hal_sensors_missed_slots() {
+  return 0;
+}
+
+/**
+ * @brief Memoria: la del PC hace de PSRAM, y la partición de la caja negra es un array en RAM
+ * del mismo tamaño que en partitions.csv (borrada a 0xFF como la flash)
+ *
+ */
+#define SIM_BLACKBOX_PARTITION_SIZE 0x80000
+static uint8_t blackbox_partition[SIM_BLACKBOX_PARTITION_SIZE];
+static bool blackbox_partition_ready = false;
+
+void *hal_psram_alloc(size_t size) {
+  return malloc(size);
+}
+
+size_t hal_blackbox_partition_size() {
+  return SIM_BLACKBOX_PARTITION_SIZE;
+}
+
+bool hal_blackbox_partition_erase(size_t size) {
+  memset(blackbox_partition, 0xFF, min(size, sizeof(blackbox_partition)));
+  blackbox_partition_ready = true;
+  return size <= sizeof(blackbox_partition);
+}
+
+bool hal_blackbox_partition_write(size_t offset, const void *data, size_t size) {
+  if (offset + size > sizeof(blackbox_partition)) {
+    return false;
+  }
+  memcpy(&blackbox_partition[offset], data, size);
+  return true;
+}
+
+bool hal_blackbox_partition_read(size_t offset, void *data, size_t size) {
+  if (offset + size > sizeof(blackbox_partition)) {
+    return false;
+  }
+  if (!blackbox_partition_ready) {
+    memset(blackbox_partition, 0xFF, sizeof(blackbox_partition));
+    blackbox_partition_ready = true;
+  }
+  memcpy(data, &blackbox_partition[offset], size);
+  return true;
+}
+
+void hal_control_timer_start(unsigned long period_us, void (*tick)(uint32_t ticks)) {
+  control_tick = tick;
+  control_period_us = period_us;
+  control_next_us = sim_time_us + period_us;
+}
+
+void hal_control_timer_set_period(unsigned long period_us) {
+  control_period_us = period_us;
+}
+
+/**
+ * @brief Estado de un motor a partir de sus dos canales PWM (lógica del driver RZ7886)
+ * Los canales comparten timer y fase, así que ambos empiezan el periodo en alto:
+ * ambos en alto frena, solo A avanza, solo B retrocede y ambos en bajo es rueda libre
+ *
+ * @return sim_motor_t Fracciones del periodo en marcha y en circuito
+ */
+static sim_motor_t motor_state(int channel_a, int channel_b) {
+  double a = (double)pwm_duties[channel_a] / pwm_max[channel_a];
+  double b = (double)pwm_duties[channel_b] / pwm_max[channel_b];
+  sim_motor_t motor;
+  motor.drive = a - b;
+  motor.load = a > b ? a : b;
+  return motor;
+}
+
+uint64_t hal_native_time_us() {
+  return sim_time_us;
+}
+
+/**
+ * @brief Avanza el reloj simulado integrando la física, generando tramas y ejecutando el control
+ * Todo ocurre en el mismo hilo: el control ve el mismo orden de eventos que en el robot
+ *
+ * @param duration_us Tiempo a simular (μs)
+ */
+void hal_native_run_us(uint64_t duration_us) {
+  if (replay_mode) {
+    sim_time_us += duration_us;
+    replay_ms += duration_us / 1000;
+    return;
+  }
+
+  uint64_t end_us = sim_time_us + duration_us;
+  while (sim_time_us < end_us) {
+    sim_time_us += SIM_PHYSICS_US;
+    sim_step(SIM_PHYSICS_US / 1e6, motor_state(PWM_MOTOR_LEFT_A, PWM_MOTOR_LEFT_B),
+             motor_state(PWM_MOTOR_RIGHT_A, PWM_MOTOR_RIGHT_B));
+
+    if (sim_time_us - frame_last_us >= SENSORS_MUX_SLOT_US * SENSORS_MUX_STATES) {
+      frame_last_us = sim_time_us;
+      sim_read_sensors(frame_raw);
+      frame_count++;
+      frame_us = sim_time_us;
+      frame_fresh = true;
+    }
+
+    if (control_tick != NULL && sim_time_us >= control_next_us) {
+      control_next_us += control_period_us;
+      control_tick(1);
+    }
+  }
+}
+
+/**
+ * @brief Pasa a reproducir un registro: el reloj solo avanza con hal_native_replay_clock y el
+ * control solo se ejecuta con hal_native_replay_tick
+ *
+ */
+void hal_native_replay_start() {
+  replay_mode = true;
+  replay_ms = sim_time_us / 1000;
+  frame_fresh = false;
+}
+
+/**
+ * @brief Entrega al control una trama de sensores del registro
+ *
+ * @param raw Lecturas RAW de los 16 sensores
+ * @param us Instante de la trama
+ */
+void hal_native_replay_frame(const uint16_t *raw, unsigned long us) {
+  memcpy(frame_raw, raw, sizeof(frame_raw));
+  frame_count++;
+  frame_us = us;
+  frame_fresh = true;
+}
+
+/**
+ * @brief Fija el reloj: μs y ms por separado, porque en el robot se leen en instantes distintos
+ *
+ */
+void hal_native_replay_clock(uint64_t us, unsigned long ms) {
+  sim_time_us = us;
+  replay_ms = ms;
+}
+
+void hal_native_replay_tick() {
+  if (control_tick != NULL) {
+    control_tick(1);
+  }
+}
@@ -0,0 +1,429 @@
+#include <control.h>
+#include <sensors.h>
+#include <motors.h>
+#include <utils.h>
+#include <telemetry.h>
+#include <simulator.h>
+#include <track_map.h>
+#include <markers.h>
+#include <laps.h>
+#include <blackbox.h>
+#include <autotune.h>
+#include <estimator.h>
+#include <chrono>
+
+/**
+ * @brief Simulador en el PC: ejecuta sensors/control/motors reales en lazo cerrado
+ * con un modelo cinemático del robot sobre la pista, más rápido que el tiempo real
+ *
+ * Uso: program [--track fichero] [--laps N] [--time s] [--speed %] [--accel %]
+ *              [--fan %] [--analog] [--trace fichero.csv] [--verbose]
+ *              [--learn] [--straight %] [--curve %] [--kp k] [--ki k] [--kd k]
+ *              [--period us] [--dfilter Hz] [--brake %] [--fast-decay] [--autocal]
+ *              [--replay registro.csv] [--autotune] [--apply n] [--twiddle]
+ *              [--kalman] [--kq q]
+ *
+ * Con --learn se da primero una vuelta de aprendizaje a velocidad base y las vueltas
+ * cronometradas reproducen el perfil de velocidad del mapa grabado
+ *
+ * Con --replay no hay pista: las tramas RAW de un registro (caja negra o --trace) pasan por el
+ * control con la configuración grabada en el registro y la salida se compara con la grabada;
+ * devuelve 3 si alguna trama es distinta
+ *
+ * Con --autotune se hace el ensayo de relé antes de la carrera y --apply n aplica la propuesta n
+ * a todos los puntos de la tabla; con --twiddle cada vuelta por marca de meta evalúa un candidato
+ * de Kp/Kd en el punto más cercano a la velocidad base
+ *
+ * Con --kalman el PID recibe la posición y la variación del estimador (--kq: ruido de proceso)
+ *
+ */
+
+#define SIM_DEFAULT_LAPS 3
+#define SIM_DEFAULT_TIME_S 60
+#define SIM_MAX_LAPS 32
+#define SIM_LEARNING_LAPS 2
+
+/**
+ * @brief Vuelta de aprendizaje del mapa de pista; deja el robot parado en la salida
+ * Como en el robot, la carrera de aprendizaje dura más de una vuelta (SIM_LEARNING_LAPS) y es
+ * el firmware quien cierra el mapa al pasar por meta
+ *
+ * @param time_limit_s Tiempo máximo de la vuelta (s)
+ * @return double Tiempo de la primera vuelta (s) o -1 si no se completó
+ */
+static double run_learning_lap(double time_limit_s) {
+  set_track_map_mode(TRACK_MAP_LEARN);
+  set_race_started(true);
+  uint64_t start_us = hal_native_time_us();
+  double lap_s = -1;
+  while (is_race_started() && sim_distance() < SIM_LEARNING_LAPS * sim_track_length() &&
+         hal_native_time_us() - start_us < (uint64_t)(time_limit_s * 1e6)) {
+    hal_native_run_us(1000);
+    if (lap_s < 0 && sim_distance() >= sim_track_length()) {
+      lap_s = (hal_native_time_us() - start_us) / 1e6;
+    }
+  }
+  bool completed = is_race_started() && sim_distance() >= SIM_LEARNING_LAPS * sim_track_length();
+  if (is_race_started()) {
+    set_race_started(false);
+  }
+
+  // Dejar que la tarea de control cierre el mapa y que el robot se detenga
+  hal_native_run_us(1000000);
+  sim_reset();
+  sim_telemetry_reset();
+  return completed ? lap_s : -1;
+}
+
+static void print_usage() {
+  printf("Uso: program [--track fichero] [--laps N] [--time s] [--speed %%] [--accel %%]\n");
+  printf("             [--fan %%] [--analog] [--trace fichero.csv] [--verbose]\n");
+  printf("             [--learn] [--straight %%] [--curve %%] [--kp k] [--ki k] [--kd k]\n");
+  printf("             [--period us] [--dfilter Hz] [--brake %%] [--fast-decay] [--autocal]\n");
+  printf("             [--replay registro.csv] [--autotune] [--apply n] [--twiddle]\n");
+  printf("             [--kalman] [--kq q]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *track_path = NULL;
+  const char *trace_path = NULL;
+  const char *replay_path = NULL;
+  int laps = SIM_DEFAULT_LAPS;
+  double time_limit_s = SIM_DEFAULT_TIME_S;
+  int speed = -1;
+  int accel = -1;
+  int fan = -1;
+  bool analog = false;
+  bool verbose = false;
+  bool learn = false;
+  int straight_speed = -1;
+  int curve_speed = -1;
+  float gains[3] = {-1, -1, -1};
+  int period_us = -1;
+  int d_filter_hz = -1;
+  int brake = -1;
+  bool fast_decay = false;
+  bool autocal = false;
+  bool autotune = false;
+  int apply_proposal = -1;
+  bool twiddle = false;
+  bool kalman = false;
+  float process_noise = -1;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--track") && has_value) {
+      track_path = argv[++i];
+    } else if (!strcmp(argv[i], "--trace") && has_value) {
+      trace_path = argv[++i];
+    } else if (!strcmp(argv[i], "--replay") && has_value) {
+      replay_path = argv[++i];
+    } else if (!strcmp(argv[i], "--laps") && has_value) {
+      laps = atoi(argv[++i]);
+      laps = constrain(laps, 1, SIM_MAX_LAPS);
+    } else if (!strcmp(argv[i], "--time") && has_value) {
+      time_limit_s = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--speed") && has_value) {
+      speed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--accel") && has_value) {
+      accel = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--fan") && has_value) {
+      fan = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--straight") && has_value) {
+      straight_speed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--curve") && has_value) {
+      curve_speed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--kp") && has_value) {
+      gains[0] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--ki") && has_value) {
+      gains[1] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--kd") && has_value) {
+      gains[2] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--period") && has_value) {
+      period_us = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--dfilter") && has_value) {
+      d_filter_hz = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--brake") && has_value) {
+      brake = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--fast-decay")) {
+      fast_decay = true;
+    } else if (!strcmp(argv[i], "--autocal")) {
+      autocal = true;
+    } else if (!strcmp(argv[i], "--autotune")) {
+      autotune = true;
+    } else if (!strcmp(argv[i], "--apply") && has_value) {
+      apply_proposal = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--twiddle")) {
+      twiddle = true;
+    } else if (!strcmp(argv[i], "--kalman")) {
+      kalman = true;
+    } else if (!strcmp(argv[i], "--kq") && has_value) {
+      process_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--learn")) {
+      learn = true;
+    } else if (!strcmp(argv[i], "--analog")) {
+      analog = true;
+    } else if (!strcmp(argv[i], "--verbose")) {
+      verbose = true;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  Serial.quiet = !verbose;
+
+  if (track_path != NULL) {
+    if (!sim_load_track(track_path)) {
+      printf("ERROR: no se pudo cargar la pista %s\n", track_path);
+      return 1;
+    }
+  } else {
+    sim_default_track();
+  }
+  sim_reset();
+
+  FILE *trace_file = NULL;
+  if (trace_path != NULL) {
+    trace_file = fopen(trace_path, "w");
+    if (trace_file == NULL) {
+      printf("ERROR: no se pudo crear la traza %s\n", trace_path);
+      return 1;
+    }
+  }
+
+  // Mismo orden de arranque que el robot
+  init_utils();
+  init_sensors();
+  init_motors();
+  init_telemetry();
+  init_blackbox();
+  sim_telemetry_trace(trace_file);
+
+  // Calibración ideal a partir del modelo de los sensores
+  int calibration_min[SENSORS_COUNT];
+  int calibration_max[SENSORS_COUNT];
+  int calibration_threshold[SENSORS_COUNT];
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    calibration_min[sensor] = SIM_RAW_BACKGROUND;
+    calibration_max[sensor] = SIM_RAW_LINE;
+    calibration_threshold[sensor] = SIM_RAW_BACKGROUND + (SIM_RAW_LINE - SIM_RAW_BACKGROUND) * 2 / 3;
+  }
+  set_sensors_calibration(calibration_min, calibration_max, calibration_threshold);
+  set_sensors_noise(SIM_RAW_NOISE / sqrt(12.0));  // Ruido uniforme de ±SIM_RAW_NOISE/2
+  set_sensor_position_mode(analog ? POSITION_ANALOG : POSITION_BINARY);
+  set_estimator_enabled(kalman);
+  if (process_noise >= 0) {
+    set_estimator_process_noise(process_noise);
+  }
+  if (speed >= 0) {
+    set_base_speed(speed);
+  }
+  if (accel >= 0) {
+    set_base_accel_speed(accel);
+  }
+  if (fan >= 0) {
+    set_base_fan_speed(fan);
+  }
+  if (period_us > 0) {
+    set_control_period_us(period_us);
+  }
+  if (d_filter_hz >= 0) {
+    set_pid_d_filter_hz(d_filter_hz);
+  }
+  if (brake >= 0) {
+    set_brake_max(brake);
+  }
+  set_motors_decay_mode(fast_decay ? MOTORS_DECAY_FAST : MOTORS_DECAY_SLOW);
+
+  // Las vueltas las cuenta el simulador por distancia; el cronometraje por marcas solo se compara
+  set_laps_target(0);
+
+  // Las ganancias de la línea de comandos se aplican a todos los puntos de la tabla
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    float point_gains[3];
+    get_pid_gains(point, &point_gains[0], &point_gains[1], &point_gains[2]);
+    for (int gain = 0; gain < 3; gain++) {
+      if (gains[gain] >= 0) {
+        point_gains[gain] = gains[gain];
+      }
+    }
+    set_pid_gains(point, point_gains[0], point_gains[1], point_gains[2]);
+  }
+  set_track_map_speeds(straight_speed >= 0 ? straight_speed : get_track_map_straight_speed(),
+                       curve_speed >= 0 ? curve_speed : get_track_map_curve_speed());
+
+  // Esperar el armado del ESC con el robot parado y arrancar la carrera
+  hal_native_run_us(FAN_ARMING_MS * 1000ULL);
+  init_control_task(get_control_period_us());
+
+  // Reproducción de un registro en lugar de la simulación
+  if (replay_path != NULL) {
+    sim_replay_stats_t replay;
+    if (sim_replay(replay_path, &replay) < 0) {
+      return 1;
+    }
+    printf("==============================================\n");
+    printf("REPRODUCCION (%s, %s)\n", replay_path,
+           get_sensor_position_mode() == POSITION_ANALOG ? "analogico" : "binario");
+    printf("==============================================\n");
+    printf("Tramas: %lu, distintas: %lu\n", replay.frames, replay.mismatches);
+    if (replay.first_mismatch_line >= 0) {
+      printf("Primera diferencia: linea %ld (%lu us)\n", replay.first_mismatch_line, replay.first_mismatch_us);
+      printf("Diferencia max: posicion %d, correccion %d, ruedas %d\n", replay.max_position_diff,
+             replay.max_correction_diff, replay.max_speed_diff);
+    }
+    if (replay.stopped_early) {
+      printf("La reproduccion detuvo la carrera antes que el registro\n");
+    }
+    if (trace_file != NULL) {
+      fclose(trace_file);
+    }
+    return replay.mismatches > 0 ? 3 : 0;
+  }
+
+  // Calibración automática girando sobre la línea en lugar de la ideal del modelo
+  if (autocal) {
+    uint64_t calibration_start_us = hal_native_time_us();
+    bool calibrated = calibrate_sensors_auto();
+    int calibration_min[SENSORS_COUNT];
+    int calibration_max[SENSORS_COUNT];
+    int calibration_threshold[SENSORS_COUNT];
+    get_sensors_calibration(calibration_min, calibration_max, calibration_threshold);
+    int range_min = SENSORS_MAX;
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      range_min = min(range_min, calibration_max[sensor] - calibration_min[sensor]);
+    }
+    printf("Calibracion automatica %s en %.3f s: rango minimo %d, error lateral %.1f mm\n",
+           calibrated ? "completa" : "INCOMPLETA", (hal_native_time_us() - calibration_start_us) / 1e6,
+           range_min, sim_lateral_error() * 1000);
+    hal_native_run_us(MOTORS_STOP_GRACE_MS * 1000ULL);
+  }
+
+  // Ensayo de relé en el sitio y, si se pide, una de sus propuestas en toda la tabla
+  if (autotune) {
+    bool measured = autotune_relay();
+    const autotune_relay_result_t *relay = get_autotune_relay_result();
+    printf("Ensayo de rele %s: Ku %.4f, Tu %.1f ms, amplitud %d\n", measured ? "completo" : "FALLIDO", relay->ku,
+           relay->tu_us / 1000.0, relay->amplitude);
+    for (int proposal = 0; proposal < AUTOTUNE_PROPOSAL_TWIDDLE; proposal++) {
+      float kp, ki, kd;
+      if (get_autotune_proposal(proposal, &kp, &ki, &kd)) {
+        printf("Propuesta %d: Kp %.4f, Ki %.4f, Kd %.4f\n", proposal, kp, ki, kd);
+      }
+    }
+    hal_native_run_us(MOTORS_STOP_GRACE_MS * 1000ULL);
+    sim_reset();
+  }
+  float proposal_gains[3];
+  if (apply_proposal >= 0) {
+    if (!get_autotune_proposal(apply_proposal, &proposal_gains[0], &proposal_gains[1], &proposal_gains[2])) {
+      printf("ERROR: propuesta %d no disponible\n", apply_proposal);
+      return 1;
+    }
+    for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+      set_pid_gains(point, proposal_gains[0], proposal_gains[1], proposal_gains[2]);
+    }
+  }
+  if (twiddle) {
+    int twiddle_point = 0;
+    for (int point = 1; point < PID_SCHEDULE_POINTS; point++) {
+      if (abs(get_pid_schedule_speed(point) - get_base_speed()) <
+          abs(get_pid_schedule_speed(twiddle_point) - get_base_speed())) {
+        twiddle_point = point;
+      }
+    }
+    set_autotune_twiddle(true, twiddle_point);
+  }
+
+  double learning_lap_s = 0;
+  if (learn) {
+    learning_lap_s = run_learning_lap(time_limit_s);
+    if (learning_lap_s < 0) {
+      printf("ERROR: no se completo la vuelta de aprendizaje\n");
+      return 2;
+    }
+  }
+  set_race_started(true);
+
+  auto wall_start = std::chrono::steady_clock::now();
+  uint64_t race_start_us = hal_native_time_us();
+  uint64_t lap_start_us = race_start_us;
+  double lap_times[SIM_MAX_LAPS];
+  int laps_done = 0;
+  double max_lateral_m = 0;
+  double max_speed_mps = 0;
+
+  while (laps_done < laps && is_race_started() &&
+         hal_native_time_us() - race_start_us < (uint64_t)(time_limit_s * 1e6)) {
+    hal_native_run_us(1000);
+    max_lateral_m = max(max_lateral_m, sim_lateral_error());
+    max_speed_mps = max(max_speed_mps, sim_speed());
+
+    if (sim_distance() >= (laps_done + 1) * sim_track_length()) {
+      lap_times[laps_done++] = (hal_native_time_us() - lap_start_us) / 1e6;
+      lap_start_us = hal_native_time_us();
+    }
+  }
+  bool line_lost = !is_race_started();
+  if (!line_lost) {
+    set_race_started(false);
+  }
+  hal_native_run_us(get_control_period_us());
+
+  double sim_s = (hal_native_time_us() - race_start_us) / 1e6;
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  const sim_run_stats_t *stats = sim_telemetry_stats();
+
+  // La caja negra se congela al perder la línea; se vuelca como en el robot
+  if (line_lost) {
+    hal_native_run_us(BLACKBOX_COMMIT_DELAY_MS * 1000ULL);
+    if (blackbox_commit_pending()) {
+      blackbox_commit();
+    }
+  }
+
+  printf("==============================================\n");
+  printf("SIMULACION (%s, %s, velocidad %d%%)\n", track_path != NULL ? track_path : "ovalo por defecto",
+         analog ? "analogico" : "binario", get_base_speed());
+  printf("==============================================\n");
+  printf("Pista: %.2f m\n", sim_track_length());
+  if (learn) {
+    printf("Vuelta de aprendizaje: %.3f s (perfil recta %d%% / curva %d%%)\n", learning_lap_s,
+           get_track_map_straight_speed(), get_track_map_curve_speed());
+  }
+  for (int lap = 0; lap < laps_done; lap++) {
+    printf("Vuelta %d: %.3f s\n", lap + 1, lap_times[lap]);
+  }
+  if (line_lost) {
+    printf("LINEA PERDIDA a los %.3f s (%.2f m recorridos)\n", sim_s, sim_distance());
+  } else if (laps_done < laps) {
+    printf("Tiempo agotado: %d/%d vueltas en %.1f s\n", laps_done, laps, sim_s);
+  }
+  printf("Posicion |media| %.1f, |max| %d (de %d)\n",
+         stats->frames > 0 ? stats->sum_abs_position / stats->frames : 0.0, stats->max_abs_position,
+         SENSORS_POSITION_MAX);
+  printf("Error lateral max: %.1f mm, velocidad max: %.2f m/s\n", max_lateral_m * 1000, max_speed_mps);
+  for (int lap = 0; lap < get_laps_count(); lap++) {
+    const lap_stats_t *stats = get_lap_stats(lap);
+    if (stats != NULL) {
+      printf("Vuelta por marca de meta %d: %.3f s, error medio %.1f, max %d, saturado %lu ms, perdidas %d\n", lap + 1,
+             stats->time_ms / 1000.0, stats->mean_error / 10.0, stats->max_error,
+             (unsigned long)stats->saturated_ms, stats->line_losses);
+    }
+  }
+  if (twiddle) {
+    float kp, ki, kd;
+    if (get_autotune_proposal(AUTOTUNE_PROPOSAL_TWIDDLE, &kp, &ki, &kd)) {
+      printf("Twiddle %s: Kp %.4f, Kd %.4f\n",
+             get_autotune_twiddle_state() == AUTOTUNE_TWIDDLE_DONE ? "convergido" : "en curso", kp, kd);
+    }
+  }
+  printf("Marcas: izquierda %lu, derecha %lu, cruces %lu, linea ancha %lu\n", get_marker_count(MARKER_LEFT),
+         get_marker_count(MARKER_RIGHT), get_marker_count(MARKER_CROSSING), get_marker_count(MARKER_WIDE));
+  printf("Simulado %.2f s en %.3f s reales (x%.0f)\n", sim_s, wall_s, wall_s > 0 ? sim_s / wall_s : 0.0);
+
+  if (trace_file != NULL) {
+    fclose(trace_file);
+  }
+  return line_lost || laps_done < laps ? 2 : 0;
+}
@@ -0,0 +1,411 @@
+#include <simulator.h>
+#include <control.h>
+#include <sensors.h>
+#include <estimator.h>
+#include <blackbox.h>
+#include <vector>
+
+/**
+ * @brief Reproducción de un registro: las tramas RAW grabadas pasan por sensors.cpp y control.cpp
+ * sin modificar, con el reloj del registro, y la salida se compara con la grabada
+ *
+ * Registros aceptados (columnas por nombre, en cualquier orden):
+ * - Volcado de la caja negra (bbd0)
+ * - Traza del simulador (--trace)
+ * Ambos llevan la configuración de la carrera en líneas "# clave valores" (format_blackbox_config:
+ * calibración, ruido, periodo, modo, suavizado, velocidades, PID, filtro, freno, motores y
+ * estimador), que sustituye a la de la línea de comandos
+ * Se necesitan us, frame_us, race_ms, flags y s1..s16 para reproducir y position, correction, left
+ * y right para comparar
+ *
+ */
+
+#define SIM_REPLAY_LINE_MAX 1024
+#define SIM_REPLAY_START_PERIODS 2
+
+/**
+ * @brief Claves de la configuración encontradas en el registro (bits)
+ *
+ */
+enum SIM_REPLAY_KEYS {
+  REPLAY_KEY_NOISE = 1 << 0,
+  REPLAY_KEY_PERIOD = 1 << 1,
+  REPLAY_KEY_MODE = 1 << 2,
+  REPLAY_KEY_SMOOTHING = 1 << 3,
+  REPLAY_KEY_SPEED = 1 << 4,
+  REPLAY_KEY_PID = 1 << 5,
+  REPLAY_KEY_DFILTER = 1 << 6,
+  REPLAY_KEY_BRAKE = 1 << 7,
+  REPLAY_KEY_MOTORS = 1 << 8,
+  REPLAY_KEY_KALMAN = 1 << 9
+};
+
+/**
+ * @brief Configuración leída del registro (la del bloque anterior a la primera carrera)
+ *
+ */
+struct sim_replay_config_t {
+  blackbox_config_t config;
+  unsigned long period_us;
+  int calibration_count;
+  int pid_count;
+  int keys;
+};
+
+enum SIM_REPLAY_COLUMNS {
+  REPLAY_US,
+  REPLAY_FRAME_US,
+  REPLAY_RACE_MS,
+  REPLAY_FLAGS,
+  REPLAY_POSITION,
+  REPLAY_CORRECTION,
+  REPLAY_LEFT,
+  REPLAY_RIGHT,
+  REPLAY_SENSOR_1
+};
+#define SIM_REPLAY_COLUMNS_COUNT (REPLAY_SENSOR_1 + SENSORS_COUNT)
+
+static const char *const replay_column_names[REPLAY_SENSOR_1] = {
+  "us", "frame_us", "race_ms", "flags", "position", "correction", "left", "right"
+};
+
+/**
+ * @brief Trama del registro con las columnas ya ordenadas
+ *
+ */
+struct sim_replay_row_t {
+  long line;
+  long values[SIM_REPLAY_COLUMNS_COUNT];
+};
+
+/**
+ * @brief Asigna a cada columna conocida su posición en la cabecera del CSV
+ *
+ * @param header Línea de cabecera (se modifica)
+ * @param indexes Posición de cada columna
+ * @return true Si están todas las columnas
+ */
+static bool parse_header(char *header, int *indexes) {
+  for (int column = 0; column < SIM_REPLAY_COLUMNS_COUNT; column++) {
+    indexes[column] = -1;
+  }
+
+  int position = 0;
+  for (char *name = strtok(header, ",\r\n"); name != NULL; name = strtok(NULL, ",\r\n"), position++) {
+    for (int column = 0; column < REPLAY_SENSOR_1; column++) {
+      if (!strcmp(name, replay_column_names[column])) {
+        indexes[column] = position;
+      }
+    }
+    int sensor = 0;
+    if (sscanf(name, "s%d", &sensor) == 1 && sensor >= 1 && sensor <= SENSORS_COUNT) {
+      indexes[REPLAY_SENSOR_1 + sensor - 1] = position;
+    }
+  }
+
+  for (int column = 0; column < SIM_REPLAY_COLUMNS_COUNT; column++) {
+    if (indexes[column] < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Interpreta una línea "# clave valores" de la configuración
+ *
+ * @param line Línea del registro
+ * @param replay_config Configuración leída hasta ahora
+ */
+static void parse_config_line(const char *line, sim_replay_config_t *replay_config) {
+  blackbox_config_t *config = &replay_config->config;
+  unsigned int values[3];
+  float gains[3];
+  int sensor, point;
+  if (sscanf(line, "# cal s%d %u %u %u", &sensor, &values[0], &values[1], &values[2]) == 4 && sensor >= 1 &&
+      sensor <= SENSORS_COUNT) {
+    config->sensors_min[sensor - 1] = values[0];
+    config->sensors_max[sensor - 1] = values[1];
+    config->sensors_threshold[sensor - 1] = values[2];
+    replay_config->calibration_count++;
+  } else if (sscanf(line, "# noise %u", &values[0]) == 1) {
+    config->sensors_noise = values[0];
+    replay_config->keys |= REPLAY_KEY_NOISE;
+  } else if (sscanf(line, "# period %lu", &replay_config->period_us) == 1) {
+    replay_config->keys |= REPLAY_KEY_PERIOD;
+  } else if (sscanf(line, "# mode %u", &values[0]) == 1) {
+    config->position_mode = values[0];
+    replay_config->keys |= REPLAY_KEY_MODE;
+  } else if (sscanf(line, "# smoothing %u", &values[0]) == 1) {
+    config->smoothing = values[0];
+    replay_config->keys |= REPLAY_KEY_SMOOTHING;
+  } else if (sscanf(line, "# speed %u %u", &values[0], &values[1]) == 2) {
+    config->base_speed = values[0];
+    config->base_accel_speed = values[1];
+    replay_config->keys |= REPLAY_KEY_SPEED;
+  } else if (sscanf(line, "# pid %d %f %f %f", &point, &gains[0], &gains[1], &gains[2]) == 4 && point >= 0 &&
+             point < PID_SCHEDULE_POINTS) {
+    for (int gain = 0; gain < 3; gain++) {
+      config->pid_gains[point][gain] = gains[gain];
+    }
+    replay_config->pid_count++;
+  } else if (sscanf(line, "# dfilter %u", &values[0]) == 1) {
+    config->d_filter_hz = values[0];
+    replay_config->keys |= REPLAY_KEY_DFILTER;
+  } else if (sscanf(line, "# brake %u", &values[0]) == 1) {
+    config->brake_max = values[0];
+    replay_config->keys |= REPLAY_KEY_BRAKE;
+  } else if (sscanf(line, "# motors %u %u %u", &values[0], &values[1], &values[2]) == 3) {
+    config->pwm_hz = values[0];
+    config->pwm_resolution = values[1];
+    config->decay_mode = values[2];
+    replay_config->keys |= REPLAY_KEY_MOTORS;
+  } else if (sscanf(line, "# kalman %u %f", &values[0], &config->estimator_process_noise) == 2) {
+    config->estimator_enabled = values[0];
+    replay_config->keys |= REPLAY_KEY_KALMAN;
+  }
+}
+
+/**
+ * @brief Aplica la configuración del registro; lo que no esté en el registro queda como en la
+ * línea de comandos
+ *
+ * @param replay_config Configuración leída
+ */
+static void apply_config(const sim_replay_config_t *replay_config) {
+  const blackbox_config_t *config = &replay_config->config;
+  if (replay_config->calibration_count >= SENSORS_COUNT) {
+    int sensors_min[SENSORS_COUNT];
+    int sensors_max[SENSORS_COUNT];
+    int sensors_threshold[SENSORS_COUNT];
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      sensors_min[sensor] = config->sensors_min[sensor];
+      sensors_max[sensor] = config->sensors_max[sensor];
+      sensors_threshold[sensor] = config->sensors_threshold[sensor];
+    }
+    set_sensors_calibration(sensors_min, sensors_max, sensors_threshold);
+  }
+  if (replay_config->keys & REPLAY_KEY_NOISE) {
+    set_sensors_noise(config->sensors_noise);
+  }
+  if (replay_config->keys & REPLAY_KEY_PERIOD) {
+    set_control_period_us(replay_config->period_us);
+  }
+  if (replay_config->keys & REPLAY_KEY_MODE) {
+    set_sensor_position_mode((POSITION_MODES)config->position_mode);
+  }
+  if (replay_config->keys & REPLAY_KEY_SMOOTHING) {
+    set_sensors_smoothing(config->smoothing);
+  }
+  if (replay_config->keys & REPLAY_KEY_SPEED) {
+    set_base_speed(config->base_speed);
+    set_base_accel_speed(config->base_accel_speed);
+  }
+  if (replay_config->pid_count >= PID_SCHEDULE_POINTS) {
+    for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+      set_pid_gains(point, config->pid_gains[point][0], config->pid_gains[point][1], config->pid_gains[point][2]);
+    }
+  }
+  if (replay_config->keys & REPLAY_KEY_DFILTER) {
+    set_pid_d_filter_hz(config->d_filter_hz);
+  }
+  if (replay_config->keys & REPLAY_KEY_BRAKE) {
+    set_brake_max(config->brake_max);
+  }
+  if (replay_config->keys & REPLAY_KEY_MOTORS) {
+    set_motors_pwm(config->pwm_hz, config->pwm_resolution);
+    set_motors_decay_mode((MOTORS_DECAY_MODES)config->decay_mode);
+  }
+  if (replay_config->keys & REPLAY_KEY_KALMAN) {
+    set_estimator_enabled(config->estimator_enabled);
+    set_estimator_process_noise(config->estimator_process_noise);
+  }
+}
+
+/**
+ * @brief Lee el registro completo: configuración de los comentarios, cabecera y tramas
+ * Las líneas anteriores a la cabecera se ignoran (la salida de la consola serie que rodea a bbd);
+ * de la configuración vale el último bloque anterior a la primera trama de carrera
+ *
+ * @param path Fichero CSV
+ * @param rows Tramas leídas
+ * @param replay_config Configuración leída
+ * @return true Si el registro se pudo leer
+ */
+static bool load_log(const char *path, std::vector<sim_replay_row_t> *rows, sim_replay_config_t *replay_config) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    printf("ERROR: no se pudo abrir %s\n", path);
+    return false;
+  }
+
+  *replay_config = {};
+  int indexes[SIM_REPLAY_COLUMNS_COUNT];
+  bool header_found = false;
+  bool race_found = false;
+  char line[SIM_REPLAY_LINE_MAX];
+  long line_number = 0;
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    if (line[0] == '#') {
+      if (!race_found) {
+        // Un bloque nuevo (otra carrera de la traza) sustituye al anterior
+        if (!strncmp(line, "# cal s1 ", 9)) {
+          *replay_config = {};
+        }
+        parse_config_line(line, replay_config);
+      }
+      continue;
+    }
+    if (!header_found) {
+      header_found = parse_header(line, indexes);
+      continue;
+    }
+
+    // Tramas: los campos se leen todos y luego se toman los de las columnas conocidas
+    long fields[64];
+    int count = 0;
+    char *cursor = line;
+    while (count < 64) {
+      char *end = NULL;
+      fields[count++] = strtol(cursor, &end, 10);
+      if (*end != ',') {
+        break;
+      }
+      cursor = end + 1;
+    }
+
+    sim_replay_row_t row;
+    row.line = line_number;
+    bool complete = true;
+    for (int column = 0; column < SIM_REPLAY_COLUMNS_COUNT; column++) {
+      complete = complete && indexes[column] < count;
+      row.values[column] = indexes[column] < count ? fields[indexes[column]] : 0;
+    }
+    if (complete) {
+      rows->push_back(row);
+      race_found = race_found || (row.values[REPLAY_FLAGS] & TELEMETRY_FLAG_RACE_STARTED);
+    }
+  }
+  fclose(file);
+
+  if (!header_found) {
+    printf("ERROR: %s no tiene cabecera CSV con us, frame_us, race_ms, flags, position, correction,\n", path);
+    printf("       left, right y s1..s%d\n", SENSORS_COUNT);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reproduce la carrera de un registro y la compara trama a trama
+ * Solo se reproduce la primera carrera del registro (tramas con TELEMETRY_FLAG_RACE_STARTED), con
+ * la configuración grabada. El estado del control (integral, derivativo, estimador, rampa,
+ * recuperación) arranca de cero como en la salida, así que se rechazan los registros que empiezan
+ * a mitad de carrera (una caja negra que dio la vuelta al buffer): su primera trama tiene un
+ * race_ms mayor que SIM_REPLAY_START_PERIODS periodos
+ *
+ * @param path Fichero CSV
+ * @param stats Diferencias encontradas
+ * @return int 0 si se reprodujo, -1 si no se pudo leer o no empieza en la salida
+ */
+int sim_replay(const char *path, sim_replay_stats_t *stats) {
+  *stats = {};
+  stats->first_mismatch_line = -1;
+
+  std::vector<sim_replay_row_t> rows;
+  sim_replay_config_t replay_config;
+  if (!load_log(path, &rows, &replay_config)) {
+    return -1;
+  }
+  apply_config(&replay_config);
+
+  std::vector<const sim_replay_row_t *> race;
+  for (const sim_replay_row_t &row : rows) {
+    // La carrera termina en la primera trama sin carrera o cuando race_ms vuelve a empezar
+    // (en la traza del simulador dos carreras seguidas no tienen tramas entre ellas)
+    bool in_race = row.values[REPLAY_FLAGS] & TELEMETRY_FLAG_RACE_STARTED;
+    if (!race.empty() && (!in_race || row.values[REPLAY_RACE_MS] < race.back()->values[REPLAY_RACE_MS])) {
+      break;
+    }
+    if (in_race) {
+      race.push_back(&row);
+    }
+  }
+  if (race.empty()) {
+    printf("ERROR: el registro no tiene tramas de carrera\n");
+    return -1;
+  }
+  if (!(replay_config.keys & REPLAY_KEY_PERIOD) && race.size() > 1) {
+    unsigned long period_us = race[1]->values[REPLAY_US] - race[0]->values[REPLAY_US];
+    if (period_us != get_control_period_us()) {
+      set_control_period_us(period_us);
+    }
+  }
+  unsigned long start_limit_ms = SIM_REPLAY_START_PERIODS * get_control_period_us() / 1000 + 1;
+  if ((unsigned long)race[0]->values[REPLAY_RACE_MS] > start_limit_ms) {
+    printf("ERROR: el registro empieza a mitad de carrera (race_ms %ld en la linea %ld): el estado\n",
+           race[0]->values[REPLAY_RACE_MS], race[0]->line);
+    printf("       del control en ese punto no esta grabado y la reproduccion no seria exacta\n");
+    return -1;
+  }
+
+  // El control lee el tiempo de carrera con hal_millis: el reloj de ms se alinea con race_ms
+  hal_native_replay_start();
+  const sim_replay_row_t *first = race[0];
+  unsigned long start_ms = first->values[REPLAY_US] / 1000 - first->values[REPLAY_RACE_MS];
+  hal_native_replay_clock(first->values[REPLAY_US], start_ms);
+  set_race_started(true);
+
+  unsigned long last_frame_us = 0;
+  unsigned long last_frames = sim_telemetry_stats()->frames;
+  for (size_t index = 0; index < race.size(); index++) {
+    const long *values = race[index]->values;
+    if (index == 0 || (unsigned long)values[REPLAY_FRAME_US] != last_frame_us) {
+      uint16_t raw[SENSORS_COUNT];
+      for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+        raw[sensor] = values[REPLAY_SENSOR_1 + sensor];
+      }
+      last_frame_us = values[REPLAY_FRAME_US];
+      hal_native_replay_frame(raw, last_frame_us);
+    }
+    hal_native_replay_clock(values[REPLAY_US], start_ms + values[REPLAY_RACE_MS]);
+    hal_native_replay_tick();
+    stats->frames++;
+
+    // Sin trama nueva la reproducción detuvo la carrera antes que el registro
+    const telemetry_frame_t *replayed = sim_telemetry_last();
+    if (sim_telemetry_stats()->frames == last_frames) {
+      stats->stopped_early = true;
+      stats->mismatches += race.size() - index;
+      if (stats->first_mismatch_line < 0) {
+        stats->first_mismatch_line = race[index]->line;
+        stats->first_mismatch_us = values[REPLAY_US];
+      }
+      break;
+    }
+    last_frames = sim_telemetry_stats()->frames;
+
+    int position_diff = abs(replayed->position - values[REPLAY_POSITION]);
+    int correction_diff = abs(replayed->correction - values[REPLAY_CORRECTION]);
+    int speed_diff = max(abs(replayed->left_speed - values[REPLAY_LEFT]),
+                         abs(replayed->right_speed - values[REPLAY_RIGHT]));
+    if (position_diff != 0 || correction_diff != 0 || speed_diff != 0) {
+      stats->mismatches++;
+      if (stats->first_mismatch_line < 0) {
+        stats->first_mismatch_line = race[index]->line;
+        stats->first_mismatch_us = values[REPLAY_US];
+      }
+      stats->max_position_diff = max(stats->max_position_diff, position_diff);
+      stats->max_correction_diff = max(stats->max_correction_diff, correction_diff);
+      stats->max_speed_diff = max(stats->max_speed_diff, speed_diff);
+    }
+  }
+
+  if (is_race_started()) {
+    set_race_started(false);
+    hal_native_replay_tick();
+  }
+  return 0;
+}
@@ -0,0 +1,310 @@
+#include <simulator.h>
+#include <sensors.h>
+#include <vector>
+
+/**
+ * @brief Punto de la pista remuestreada cada SIM_TRACK_STEP_M
+ *
+ */
+struct track_point_t {
+  double x;
+  double y;
+};
+
+static std::vector<track_point_t> track;
+static double track_length = 0;
+
+/**
+ * @brief Marca de la pista: distancia desde el inicio (m) y lado (-1 izquierda, 1 derecha, 0 cruce)
+ *
+ */
+struct track_marker_t {
+  double s;
+  int side;
+};
+
+static std::vector<track_marker_t> markers;
+
+/**
+ * @brief Estado cinemático del robot (tracción diferencial)
+ *
+ */
+static double robot_x = 0;
+static double robot_y = 0;
+static double robot_heading = 0;
+static double wheel_left = 0;
+static double wheel_right = 0;
+static size_t robot_index = 0;
+static double robot_distance = 0;
+static unsigned int noise_seed = 1;
+
+/**
+ * @brief Remuestrea una polilínea cerrada a pasos constantes de SIM_TRACK_STEP_M
+ *
+ * @param points Vértices de la pista (el último se une con el primero)
+ */
+static void set_track(const std::vector<track_point_t> &points) {
+  track.clear();
+  track_length = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    const track_point_t &a = points[i];
+    const track_point_t &b = points[(i + 1) % points.size()];
+    double length = hypot(b.x - a.x, b.y - a.y);
+    int steps = max(1, (int)(length / SIM_TRACK_STEP_M));
+    for (int step = 0; step < steps; step++) {
+      double t = (double)step / steps;
+      track.push_back({a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t});
+    }
+    track_length += length;
+  }
+}
+
+/**
+ * @brief Carga una pista desde un fichero de texto con un vértice "x y" (metros) por línea
+ * La pista se considera cerrada; el robot arranca en el primer vértice mirando al segundo
+ * Las líneas "m s lado" añaden una marca a s metros del inicio (lado -1 izquierda, 1 derecha, 0 cruce)
+ *
+ * @param path Ruta del fichero
+ * @return true Si se leyeron al menos 3 vértices
+ */
+bool sim_load_track(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+  std::vector<track_point_t> points;
+  markers.clear();
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    track_point_t point;
+    track_marker_t marker;
+    if (line[0] == 'm' && sscanf(line + 1, "%lf %d", &marker.s, &marker.side) == 2) {
+      markers.push_back(marker);
+    } else if (line[0] != '#' && sscanf(line, "%lf %lf", &point.x, &point.y) == 2) {
+      points.push_back(point);
+    }
+  }
+  fclose(file);
+  if (points.size() < 3) {
+    return false;
+  }
+  set_track(points);
+  return true;
+}
+
+/**
+ * @brief Pista por defecto: óvalo con rectas de 2 m y curvas de 0.5 m de radio
+ * Marca derecha de salida/meta poco después del inicio y marcas izquierdas antes y después de
+ * cada curva
+ *
+ */
+void sim_default_track() {
+  const double straight = 2.0;
+  const double radius = 0.5;
+  std::vector<track_point_t> points;
+  for (int side = 0; side < 2; side++) {
+    // Recta y curva de 180° en sentido antihorario
+    double center_x = side == 0 ? straight : 0;
+    double start_angle = side == 0 ? -M_PI / 2 : M_PI / 2;
+    points.push_back({side == 0 ? 0 : straight, side == 0 ? 0 : 2 * radius});
+    for (int i = 0; i < 64; i++) {
+      double angle = start_angle + M_PI * i / 64;
+      points.push_back({center_x + radius * cos(angle), radius + radius * sin(angle)});
+    }
+  }
+  set_track(points);
+
+  double curve = M_PI * radius;
+  markers = {{0.10, 1},
+             {straight - 0.05, -1}, {straight + curve + 0.05, -1},
+             {2 * straight + curve - 0.05, -1}, {2 * straight + 2 * curve + 0.05 - track_length, -1}};
+  if (markers.back().s < 0) {
+    markers.back().s += track_length;
+  }
+}
+
+/**
+ * @brief Coloca el robot parado en el inicio de la pista, centrado y alineado con ella
+ *
+ */
+void sim_reset() {
+  const track_point_t &a = track[0];
+  const track_point_t &b = track[1];
+  robot_x = a.x;
+  robot_y = a.y;
+  robot_heading = atan2(b.y - a.y, b.x - a.x);
+  wheel_left = 0;
+  wheel_right = 0;
+  robot_index = 0;
+  robot_distance = 0;
+  noise_seed = 1;
+}
+
+/**
+ * @brief Busca el punto de la pista más cercano alrededor de un índice de referencia
+ *
+ * @param x Coordenada x (m)
+ * @param y Coordenada y (m)
+ * @param hint Índice de referencia
+ * @param window Puntos a revisar a cada lado de la referencia
+ * @param distance Distancia al punto más cercano (m)
+ * @return size_t Índice del punto más cercano
+ */
+static size_t nearest_track_point(double x, double y, size_t hint, int window, double *distance) {
+  size_t best = hint;
+  double best_d2 = 1e9;
+  for (int offset = -window; offset <= window; offset++) {
+    size_t index = (hint + track.size() + offset) % track.size();
+    double dx = track[index].x - x;
+    double dy = track[index].y - y;
+    double d2 = dx * dx + dy * dy;
+    if (d2 < best_d2) {
+      best_d2 = d2;
+      best = index;
+    }
+  }
+  *distance = sqrt(best_d2);
+  return best;
+}
+
+/**
+ * @brief Aceleración de una rueda (modelo de motor DC promediado en el periodo del PWM)
+ * En marcha el motor empuja hacia la velocidad de su tensión, en marcha y en freno la fuerza
+ * contraelectromotriz lo retiene y en rueda libre solo queda el rozamiento
+ *
+ * @param motor Estado del motor
+ * @param wheel Velocidad actual de la rueda (m/s)
+ * @return double Aceleración (m/s²)
+ */
+static double wheel_acceleration(sim_motor_t motor, double wheel) {
+  return (motor.drive * SIM_MAX_SPEED_MPS - motor.load * wheel) / SIM_MOTOR_TAU_S - wheel / SIM_COAST_TAU_S;
+}
+
+/**
+ * @brief Integra un paso de la física: respuesta de las ruedas y cinemática diferencial
+ *
+ * @param dt_s Paso de integración (s)
+ * @param left Estado del motor izquierdo
+ * @param right Estado del motor derecho
+ */
+void sim_step(double dt_s, sim_motor_t left, sim_motor_t right) {
+  wheel_left += wheel_acceleration(left, wheel_left) * dt_s;
+  wheel_right += wheel_acceleration(right, wheel_right) * dt_s;
+
+  double v = (wheel_left + wheel_right) / 2;
+  double w = (wheel_right - wheel_left) / SIM_WHEEL_BASE_M;
+  robot_heading += w * dt_s;
+  robot_x += v * cos(robot_heading) * dt_s;
+  robot_y += v * sin(robot_heading) * dt_s;
+
+  // Avance a lo largo de la pista (con signo, para contar vueltas)
+  double distance;
+  size_t index = nearest_track_point(robot_x, robot_y, robot_index, 40, &distance);
+  long delta = (long)index - (long)robot_index;
+  if (delta > (long)track.size() / 2) {
+    delta -= track.size();
+  } else if (delta < -(long)track.size() / 2) {
+    delta += track.size();
+  }
+  robot_distance += delta * (track_length / track.size());
+  robot_index = index;
+}
+
+/**
+ * @brief Fracción de un sensor que cae sobre una banda (0 a 1), suavizada con el tamaño del punto
+ *
+ * @param offset Distancia del sensor al centro de la banda (m)
+ * @param half_width Media anchura de la banda (m)
+ */
+static double band_coverage(double offset, double half_width) {
+  double coverage = (half_width + SIM_SENSOR_SPOT_M - fabs(offset)) / (2 * SIM_SENSOR_SPOT_M);
+  return constrain(coverage, 0.0, 1.0);
+}
+
+/**
+ * @brief Fracción de un sensor que cae sobre alguna marca
+ *
+ * @param x Coordenada x del sensor (m)
+ * @param y Coordenada y del sensor (m)
+ * @param index Punto de la pista más cercano al sensor
+ */
+static double markers_coverage(double x, double y, size_t index) {
+  if (markers.empty()) {
+    return 0;
+  }
+  // Posición del sensor en coordenadas de la pista: distancia desde el inicio y lateral (+ izquierda)
+  const track_point_t &a = track[index];
+  const track_point_t &b = track[(index + 1) % track.size()];
+  double length = hypot(b.x - a.x, b.y - a.y);
+  double lateral = ((b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x)) / length;
+  double s = index * (track_length / track.size());
+
+  double coverage = 0;
+  for (const track_marker_t &marker : markers) {
+    double along = remainder(s - marker.s, track_length);
+    if (marker.side == 0) {
+      coverage = max(coverage, min(band_coverage(along, SIM_LINE_WIDTH_M / 2), band_coverage(lateral, SIM_CROSSING_HALF_M)));
+    } else {
+      double along_coverage = band_coverage(along - SIM_MARKER_LENGTH_M / 2, SIM_MARKER_LENGTH_M / 2);
+      double lateral_coverage = band_coverage(lateral + marker.side * SIM_MARKER_OFFSET_M, SIM_MARKER_WIDTH_M / 2);
+      coverage = max(coverage, min(along_coverage, lateral_coverage));
+    }
+  }
+  return coverage;
+}
+
+/**
+ * @brief Genera una trama de lecturas del ADC según la fracción de cada sensor que cae sobre la línea
+ * o sobre una marca
+ *
+ * @param raw Array de SENSORS_COUNT elementos
+ */
+void sim_read_sensors(uint16_t *raw) {
+  double cos_h = cos(robot_heading);
+  double sin_h = sin(robot_heading);
+  size_t hint = (robot_index + (size_t)(SIM_SENSOR_AHEAD_M / SIM_TRACK_STEP_M)) % track.size();
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    // Sensor 1 a la izquierda del robot, sensor 16 a la derecha
+    double lateral = (7.5 - sensor) * SIM_SENSOR_PITCH_M;
+    double x = robot_x + SIM_SENSOR_AHEAD_M * cos_h - lateral * sin_h;
+    double y = robot_y + SIM_SENSOR_AHEAD_M * sin_h + lateral * cos_h;
+    double distance;
+    size_t index = nearest_track_point(x, y, hint, 60, &distance);
+
+    double coverage = max(band_coverage(distance, SIM_LINE_WIDTH_M / 2), markers_coverage(x, y, index));
+    noise_seed = noise_seed * 1103515245 + 12345;
+    int noise = (int)((noise_seed >> 16) % (SIM_RAW_NOISE + 1)) - SIM_RAW_NOISE / 2;
+    int value = SIM_RAW_BACKGROUND + (int)((SIM_RAW_LINE - SIM_RAW_BACKGROUND) * coverage) + noise;
+    raw[sensor] = constrain(value, SENSORS_MIN, SENSORS_MAX);
+  }
+}
+
+double sim_track_length() {
+  return track_length;
+}
+
+/**
+ * @brief Distancia recorrida a lo largo de la pista desde el inicio (m)
+ *
+ */
+double sim_distance() {
+  return robot_distance;
+}
+
+/**
+ * @brief Distancia del centro del robot a la línea (m)
+ *
+ */
+double sim_lateral_error() {
+  double distance;
+  nearest_track_point(robot_x, robot_y, robot_index, 2, &distance);
+  return distance;
+}
+
+/**
+ * @brief Velocidad lineal actual del robot (m/s)
+ *
+ */
+double sim_speed() {
+  return (wheel_left + wheel_right) / 2;
+}
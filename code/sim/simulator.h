@@ -0,0 +1,117 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <Arduino.h>
+#include <telemetry.h>
+
+/**
+ * @brief Paso de integración de la física del simulador (μs)
+ *
+ */
+#define SIM_PHYSICS_US 100
+
+/**
+ * @brief Geometría del robot y de la pista (metros)
+ * Regleta de 16 sensores delante del eje de las ruedas; sensor 1 a la izquierda
+ *
+ */
+#define SIM_LINE_WIDTH_M 0.019
+#define SIM_SENSOR_PITCH_M 0.008
+#define SIM_SENSOR_SPOT_M 0.003
+#define SIM_SENSOR_AHEAD_M 0.080
+#define SIM_WHEEL_BASE_M 0.120
+#define SIM_TRACK_STEP_M 0.005
+
+/**
+ * @brief Marcas de la pista: laterales (a SIM_MARKER_OFFSET_M del centro de la línea) y cruces
+ * (línea perpendicular de SIM_CROSSING_HALF_M a cada lado), situadas por distancia a lo largo
+ * de la pista
+ *
+ */
+#define SIM_MARKER_LENGTH_M 0.020
+#define SIM_MARKER_WIDTH_M 0.019
+#define SIM_MARKER_OFFSET_M 0.045
+#define SIM_CROSSING_HALF_M 0.150
+
+/**
+ * @brief Modelo de los motores: velocidad de la rueda al 100%, constante de tiempo con el motor
+ * en circuito (marcha o freno) y constante de tiempo del rozamiento en rueda libre
+ *
+ */
+#define SIM_MAX_SPEED_MPS 3.0
+#define SIM_MOTOR_TAU_S 0.040
+#define SIM_COAST_TAU_S 1.0
+
+/**
+ * @brief Estado de un motor promediado en un periodo del PWM
+ * drive: fracción del periodo en marcha adelante menos la fracción en reversa (-1 a 1)
+ * load: fracción del periodo con el motor en circuito, en marcha o en freno (0 a 1)
+ *
+ */
+struct sim_motor_t {
+  double drive;
+  double load;
+};
+
+/**
+ * @brief Lecturas simuladas del ADC: fondo, línea y ruido (pico a pico)
+ *
+ */
+#define SIM_RAW_BACKGROUND 300
+#define SIM_RAW_LINE 3600
+#define SIM_RAW_NOISE 80
+
+bool sim_load_track(const char *path);
+void sim_default_track();
+void sim_reset();
+void sim_step(double dt_s, sim_motor_t left, sim_motor_t right);
+void sim_read_sensors(uint16_t *raw);
+double sim_track_length();
+double sim_distance();
+double sim_lateral_error();
+double sim_speed();
+
+/**
+ * @brief Estadísticas de las tramas de telemetría de una simulación
+ *
+ */
+struct sim_run_stats_t {
+  unsigned long frames;
+  double sum_abs_position;
+  int max_abs_position;
+};
+
+// Telemetría del simulador (sim/telemetry_native.cpp)
+void sim_telemetry_trace(FILE *file);
+void sim_telemetry_reset();
+const sim_run_stats_t *sim_telemetry_stats();
+const telemetry_frame_t *sim_telemetry_last();
+
+// Reloj simulado y reproducción de registros (sim/hal_native.cpp)
+uint64_t hal_native_time_us();
+void hal_native_run_us(uint64_t duration_us);
+void hal_native_replay_start();
+void hal_native_replay_frame(const uint16_t *raw, unsigned long us);
+void hal_native_replay_clock(uint64_t us, unsigned long ms);
+void hal_native_replay_tick();
+
+/**
+ * @brief Diferencias entre el registro y su reproducción (sim/replay.cpp)
+ * Se comparan posición, corrección y velocidades de las ruedas; first_* es la primera trama
+ * distinta y stopped_early indica que la reproducción detuvo la carrera antes que el registro
+ *
+ */
+struct sim_replay_stats_t {
+  unsigned long frames;
+  unsigned long mismatches;
+  long first_mismatch_line;
+  unsigned long first_mismatch_us;
+  int max_position_diff;
+  int max_correction_diff;
+  int max_speed_diff;
+  bool stopped_early;
+};
+
+int sim_replay(const char *path, sim_replay_stats_t *stats);
+
+#endif // SIMULATOR_H
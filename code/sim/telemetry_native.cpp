@@ -0,0 +1,96 @@
+#include <telemetry.h>
+#include <simulator.h>
+#include <control.h>
+#include <blackbox.h>
+
+static FILE *trace_file = NULL;
+static bool trace_race = false;
+static sim_run_stats_t run_stats;
+static unsigned long telemetry_pushed = 0;
+static telemetry_frame_t last_frame;
+
+/**
+ * @brief Telemetría del simulador: en lugar del buffer y el serie, estadísticas y traza CSV
+ *
+ */
+void init_telemetry() {
+  sim_telemetry_reset();
+}
+
+bool telemetry_push(telemetry_frame_t *frame) {
+  frame->seq = telemetry_pushed++;
+  last_frame = *frame;
+  run_stats.frames++;
+  run_stats.sum_abs_position += abs(frame->position);
+  run_stats.max_abs_position = max(run_stats.max_abs_position, abs((int)frame->position));
+
+  // Al arrancar cada carrera, su configuración en el mismo formato que el volcado de la caja negra
+  bool race = frame->flags & TELEMETRY_FLAG_RACE_STARTED;
+  if (trace_file != NULL && race && !trace_race) {
+    blackbox_config_t config;
+    static char config_text[BLACKBOX_CONFIG_TEXT_MAX];
+    get_blackbox_config(&config);
+    format_blackbox_config(&config, get_control_period_us(), config_text, sizeof(config_text));
+    fputs(config_text, trace_file);
+  }
+  trace_race = race;
+
+  if (trace_file != NULL) {
+    fprintf(trace_file, "%lu,%lu,%lu,%lu,%d,%d,%d,%d,%u,%u", (unsigned long)frame->seq, (unsigned long)frame->us,
+            get_sensors_frame_us(), is_race_started() ? get_race_elapsed_ms() : 0UL, frame->position, frame->correction, frame->left_speed, frame->right_speed, frame->fan_speed, frame->flags);
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      fprintf(trace_file, ",%u", frame->sensors[sensor]);
+    }
+    fprintf(trace_file, "\n");
+  }
+  return true;
+}
+
+void set_telemetry_streaming(bool streaming) {}
+
+bool is_telemetry_streaming() {
+  // Siempre activa: las estadísticas de la simulación salen de las tramas
+  return true;
+}
+
+unsigned long get_telemetry_dropped() {
+  return 0;
+}
+
+void print_telemetry_status() {
+  Serial.print("Telemetria (simulador): ");
+  Serial.print(telemetry_pushed);
+  Serial.println(" tramas");
+}
+
+/**
+ * @brief Activa la traza CSV de cada trama de telemetría (NULL para desactivarla)
+ *
+ * @param file Fichero de salida abierto para escritura
+ */
+void sim_telemetry_trace(FILE *file) {
+  trace_file = file;
+  if (trace_file != NULL) {
+    fprintf(trace_file, "seq,us,frame_us,race_ms,position,correction,left,right,fan,flags");
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      fprintf(trace_file, ",s%d", sensor + 1);
+    }
+    fprintf(trace_file, "\n");
+  }
+}
+
+void sim_telemetry_reset() {
+  run_stats = {};
+}
+
+const sim_run_stats_t *sim_telemetry_stats() {
+  return &run_stats;
+}
+
+/**
+ * @brief Última trama de telemetría (la del último ciclo de control)
+ *
+ */
+const telemetry_frame_t *sim_telemetry_last() {
+  return &last_frame;
+}
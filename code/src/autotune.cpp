@@ -0,0 +1,488 @@
+#include <autotune.h>
+#include <control.h>
+#include <laps.h>
+#include <hal.h>
+
+// Ensayo de relé (solo lo toca la tarea de control mientras dura)
+static unsigned long relay_us = 0;
+static int relay_output = 0;
+static bool relay_cycle_started = false;
+static unsigned long relay_cycle_us = 0;
+static int relay_cycle_max = 0;
+static int relay_cycle_min = 0;
+static int relay_cycles_seen = 0;
+static unsigned long relay_period_sum_us = 0;
+static long relay_amplitude_sum = 0;
+static AUTOTUNE_RELAY_STATES relay_state = AUTOTUNE_RELAY_DONE;
+static autotune_relay_result_t relay_result = {};
+
+/**
+ * @brief Constantes de las reglas de Ziegler-Nichols sobre Ku y Tu
+ * Kp = kp·Ku, Ti = ti·Tu (0 = sin integral), Td = td·Tu
+ *
+ */
+struct autotune_rule_t {
+  const char *name;
+  float kp;
+  float ti;
+  float td;
+};
+
+static const autotune_rule_t autotune_rules[AUTOTUNE_PROPOSAL_TWIDDLE] = {
+  {"PD Ziegler-Nichols", 0.8f, 0.0f, 0.125f},
+  {"PID Ziegler-Nichols", 0.6f, 0.5f, 0.125f},
+  {"PID sin sobreoscilacion", 0.2f, 0.5f, 0.333f},
+};
+
+static const char *const relay_state_names[] = {
+  "en curso", "completado", "linea perdida", "sin oscilacion estable"
+};
+
+/**
+ * @brief Fases de la evaluación de una coordenada (algoritmo Twiddle)
+ *
+ */
+enum TWIDDLE_PHASES {
+  TWIDDLE_PHASE_BASE,   // Puntuación de las ganancias de partida
+  TWIDDLE_PHASE_PLUS,   // Probando p[i] + dp[i]
+  TWIDDLE_PHASE_MINUS   // Probando p[i] - dp[i]
+};
+
+// Twiddle: estado entre carreras (la tarea de interfaz solo lo cambia con el robot detenido)
+static volatile AUTOTUNE_TWIDDLE_STATES twiddle_state = AUTOTUNE_TWIDDLE_OFF;
+static int twiddle_point = 0;
+static TWIDDLE_PHASES twiddle_phase = TWIDDLE_PHASE_BASE;
+static int twiddle_index = 0;
+static float twiddle_p[2] = {0, 0};  // Candidato en evaluación: Kp y Kd
+static float twiddle_dp[2] = {0, 0};
+static float twiddle_best_p[2] = {0, 0};
+static float twiddle_ki = 0;
+static uint32_t twiddle_best_score = 0;
+static int twiddle_evaluations = 0;
+static const float twiddle_min_step[2] = {AUTOTUNE_TWIDDLE_MIN_KP, AUTOTUNE_TWIDDLE_MIN_KD};
+
+// Twiddle: carrera en curso (solo lo toca la tarea de control)
+static bool twiddle_run_active = false;
+static float twiddle_user_gains[3] = {0, 0, 0};
+static int twiddle_laps = 0;
+static bool twiddle_window_open = false;
+static uint32_t twiddle_error_sum = 0;
+static uint32_t twiddle_error_ticks = 0;
+static uint32_t twiddle_losses = 0;
+static bool twiddle_was_lost = false;
+
+/**
+ * @brief Reinicia el ensayo de relé (desde la tarea de control, antes del primer ciclo del ensayo)
+ *
+ */
+void autotune_relay_start() {
+  relay_us = 0;
+  relay_output = 0;
+  relay_cycle_started = false;
+  relay_cycles_seen = 0;
+  relay_period_sum_us = 0;
+  relay_amplitude_sum = 0;
+  relay_state = AUTOTUNE_RELAY_RUNNING;
+  relay_result = {};
+}
+
+/**
+ * @brief Calcula Ku y Tu con las oscilaciones medidas
+ * Relé ideal con histéresis: Ku = 4·d / (π·√(a² − ε²))
+ *
+ */
+static void finish_relay() {
+  relay_result.cycles = AUTOTUNE_RELAY_CYCLES;
+  relay_result.tu_us = relay_period_sum_us / AUTOTUNE_RELAY_CYCLES;
+  relay_result.amplitude = relay_amplitude_sum / AUTOTUNE_RELAY_CYCLES;
+  float amplitude = relay_result.amplitude;
+  float hysteresis = AUTOTUNE_RELAY_HYSTERESIS;
+  if (amplitude <= hysteresis || relay_result.tu_us == 0) {
+    relay_state = AUTOTUNE_RELAY_TIMEOUT;
+    return;
+  }
+  relay_result.ku = 4.0f * AUTOTUNE_RELAY_OUTPUT / (PI * sqrtf(amplitude * amplitude - hysteresis * hysteresis));
+  relay_result.valid = true;
+  relay_state = AUTOTUNE_RELAY_DONE;
+}
+
+/**
+ * @brief Avanza un periodo de control el ensayo de relé (desde la tarea de control)
+ * Mientras centra deja la corrección del PID; después la sustituye por la salida del relé.
+ * Un ciclo de oscilación va de un cambio del relé hacia +d al siguiente
+ *
+ * @param position Posición de la línea (-255 a 255)
+ * @param line_detected true si algún sensor ve la línea
+ * @param period_us Periodo del bucle de control (μs)
+ * @param correction Corrección del PID; se sustituye por la salida del relé
+ * @return AUTOTUNE_RELAY_STATES Estado del ensayo (fuera de AUTOTUNE_RELAY_RUNNING ha terminado)
+ */
+AUTOTUNE_RELAY_STATES autotune_relay_update(int position, bool line_detected, unsigned long period_us,
+                                            int *correction) {
+  if (relay_state != AUTOTUNE_RELAY_RUNNING) {
+    return relay_state;
+  }
+  relay_us += period_us;
+  if (!line_detected) {
+    relay_state = AUTOTUNE_RELAY_LOST;
+    return relay_state;
+  }
+  if (relay_us >= AUTOTUNE_RELAY_TIMEOUT_MS * 1000UL) {
+    relay_state = AUTOTUNE_RELAY_TIMEOUT;
+    return relay_state;
+  }
+  if (relay_us < AUTOTUNE_RELAY_CENTER_MS * 1000UL) {
+    return relay_state;
+  }
+
+  // Corrección positiva = girar hacia la derecha, hacia una línea en posición positiva
+  if (relay_output == 0) {
+    relay_output = position >= 0 ? AUTOTUNE_RELAY_OUTPUT : -AUTOTUNE_RELAY_OUTPUT;
+  }
+  relay_cycle_max = max(relay_cycle_max, position);
+  relay_cycle_min = min(relay_cycle_min, position);
+
+  if (relay_output < 0 && position > AUTOTUNE_RELAY_HYSTERESIS) {
+    relay_output = AUTOTUNE_RELAY_OUTPUT;
+    if (relay_cycle_started && relay_cycles_seen++ >= AUTOTUNE_RELAY_SETTLE_CYCLES) {
+      relay_period_sum_us += relay_us - relay_cycle_us;
+      relay_amplitude_sum += (relay_cycle_max - relay_cycle_min) / 2;
+      if (relay_cycles_seen - AUTOTUNE_RELAY_SETTLE_CYCLES >= AUTOTUNE_RELAY_CYCLES) {
+        finish_relay();
+      }
+    }
+    relay_cycle_started = true;
+    relay_cycle_us = relay_us;
+    relay_cycle_max = position;
+    relay_cycle_min = position;
+  } else if (relay_output > 0 && position < -AUTOTUNE_RELAY_HYSTERESIS) {
+    relay_output = -AUTOTUNE_RELAY_OUTPUT;
+  }
+
+  *correction = relay_output;
+  return relay_state;
+}
+
+/**
+ * @brief Ensayo de relé completo (desde la tarea de interfaz, con el robot sobre la línea)
+ * Bloquea hasta que termina y deja el robot frenando como al detener la carrera
+ *
+ * @return true Si se midieron Ku y Tu
+ */
+bool autotune_relay() {
+  Serial.println("==============================================");
+  Serial.println("AUTOAJUSTE: ENSAYO DE RELE");
+  Serial.println("==============================================");
+  Serial.println("Robot sobre la linea: oscilando en el sitio...");
+
+  if (!start_autotune_relay()) {
+    Serial.println("ERROR: no se puede ensayar durante la carrera");
+    return false;
+  }
+  while (is_autotune_relay_running()) {
+    hal_delay_ms(1);
+  }
+
+  print_autotune();
+  return relay_result.valid;
+}
+
+const autotune_relay_result_t *get_autotune_relay_result() {
+  return &relay_result;
+}
+
+/**
+ * @brief Activa o desactiva el Twiddle (desde la tarea de interfaz, fuera de carrera)
+ * Al activarlo parte de las ganancias actuales del punto y descarta la búsqueda anterior
+ *
+ * @param enabled true para activarlo
+ * @param point Punto de la tabla de ganancias a ajustar
+ * @return true Petición aceptada
+ * @return false En carrera o pre-inicio
+ */
+bool set_autotune_twiddle(bool enabled, int point) {
+  if (is_race_started() || is_race_starting()) {
+    return false;
+  }
+  if (!enabled) {
+    twiddle_state = AUTOTUNE_TWIDDLE_OFF;
+    return true;
+  }
+
+  twiddle_point = constrain(point, 0, PID_SCHEDULE_POINTS - 1);
+  float kp, kd;
+  get_pid_gains(twiddle_point, &kp, &twiddle_ki, &kd);
+  twiddle_p[0] = kp;
+  twiddle_p[1] = kd;
+  for (int index = 0; index < 2; index++) {
+    twiddle_dp[index] = twiddle_p[index] > 0 ? twiddle_p[index] * AUTOTUNE_TWIDDLE_STEP : twiddle_min_step[index];
+    twiddle_best_p[index] = twiddle_p[index];
+  }
+  twiddle_phase = TWIDDLE_PHASE_BASE;
+  twiddle_index = 0;
+  twiddle_best_score = 0;
+  twiddle_evaluations = 0;
+  twiddle_state = AUTOTUNE_TWIDDLE_RUNNING;
+  return true;
+}
+
+AUTOTUNE_TWIDDLE_STATES get_autotune_twiddle_state() {
+  return twiddle_state;
+}
+
+/**
+ * @brief Aplica al punto del Twiddle el candidato en evaluación (o el mejor, si ha convergido)
+ *
+ */
+static void apply_twiddle_gains() {
+  const float *gains = twiddle_state == AUTOTUNE_TWIDDLE_DONE ? twiddle_best_p : twiddle_p;
+  set_pid_gains(twiddle_point, gains[0], twiddle_user_gains[1], gains[1]);
+}
+
+/**
+ * @brief Pasa a la siguiente coordenada y prueba su paso positivo, o termina si ha convergido
+ *
+ */
+static void next_twiddle_coordinate() {
+  bool converged = true;
+  for (int index = 0; index < 2; index++) {
+    converged = converged &&
+                twiddle_dp[index] < AUTOTUNE_TWIDDLE_TOLERANCE * max(twiddle_best_p[index], twiddle_min_step[index]);
+  }
+  if (converged || twiddle_evaluations >= AUTOTUNE_TWIDDLE_MAX_EVALUATIONS) {
+    twiddle_p[0] = twiddle_best_p[0];
+    twiddle_p[1] = twiddle_best_p[1];
+    twiddle_state = AUTOTUNE_TWIDDLE_DONE;
+    return;
+  }
+  twiddle_index = (twiddle_index + 1) % 2;
+  twiddle_p[twiddle_index] += twiddle_dp[twiddle_index];
+  twiddle_phase = TWIDDLE_PHASE_PLUS;
+}
+
+/**
+ * @brief Puntúa el candidato en evaluación y elige el siguiente (descenso por coordenadas)
+ *
+ * @param score Puntuación de la vuelta (menor es mejor)
+ */
+static void twiddle_evaluate(uint32_t score) {
+  twiddle_evaluations++;
+  bool improved = score < twiddle_best_score;
+  if (twiddle_phase == TWIDDLE_PHASE_BASE || improved) {
+    twiddle_best_score = score;
+    twiddle_best_p[0] = twiddle_p[0];
+    twiddle_best_p[1] = twiddle_p[1];
+  }
+
+  float &p = twiddle_p[twiddle_index];
+  float &dp = twiddle_dp[twiddle_index];
+  switch (twiddle_phase) {
+    case TWIDDLE_PHASE_BASE:
+      twiddle_index = 1;  // next_twiddle_coordinate empieza por Kp
+      next_twiddle_coordinate();
+      break;
+    case TWIDDLE_PHASE_PLUS:
+      if (improved) {
+        dp *= AUTOTUNE_TWIDDLE_GROW;
+        next_twiddle_coordinate();
+      } else {
+        p = max(p - 2 * dp, 0.0f);
+        twiddle_phase = TWIDDLE_PHASE_MINUS;
+      }
+      break;
+    case TWIDDLE_PHASE_MINUS:
+      if (improved) {
+        dp *= AUTOTUNE_TWIDDLE_GROW;
+      } else {
+        p = twiddle_best_p[twiddle_index];
+        dp *= AUTOTUNE_TWIDDLE_SHRINK;
+      }
+      next_twiddle_coordinate();
+      break;
+  }
+  apply_twiddle_gains();
+}
+
+/**
+ * @brief Empieza una carrera con el Twiddle activo (desde la tarea de control, tras laps_start)
+ * Guarda las ganancias del punto para restaurarlas al detener y aplica el candidato
+ *
+ */
+void autotune_twiddle_start() {
+  twiddle_run_active = twiddle_state == AUTOTUNE_TWIDDLE_RUNNING;
+  if (!twiddle_run_active) {
+    return;
+  }
+  get_pid_gains(twiddle_point, &twiddle_user_gains[0], &twiddle_user_gains[1], &twiddle_user_gains[2]);
+  twiddle_laps = get_laps_count();
+  twiddle_window_open = false;
+  apply_twiddle_gains();
+}
+
+/**
+ * @brief Acumula el error de la vuelta y la puntúa al cruzar la meta (una vez por ciclo de control)
+ * La primera vuelta de cada carrera no puntúa: solo se evalúan vueltas completas con el candidato
+ *
+ * @param position Posición de la línea (-255 a 255)
+ * @param line_lost true si la recuperación de línea está activa
+ */
+void autotune_twiddle_update(int position, bool line_lost) {
+  if (!twiddle_run_active) {
+    return;
+  }
+  int laps = get_laps_count();
+  if (laps != twiddle_laps) {
+    twiddle_laps = laps;
+    if (twiddle_window_open && twiddle_state == AUTOTUNE_TWIDDLE_RUNNING && twiddle_error_ticks > 0) {
+      twiddle_evaluate(twiddle_error_sum * 10 / twiddle_error_ticks + twiddle_losses * AUTOTUNE_TWIDDLE_LOSS_PENALTY);
+    }
+    twiddle_window_open = true;
+    twiddle_error_sum = 0;
+    twiddle_error_ticks = 0;
+    twiddle_losses = 0;
+  }
+
+  if (twiddle_window_open) {
+    twiddle_error_sum += min(abs(position), 255);
+    twiddle_error_ticks++;
+    if (line_lost && !twiddle_was_lost) {
+      twiddle_losses++;
+    }
+  }
+  twiddle_was_lost = line_lost;
+}
+
+/**
+ * @brief La recuperación no encontró la línea: el candidato puntúa AUTOTUNE_TWIDDLE_FAIL_SCORE
+ * (desde la tarea de control, antes de detener la carrera)
+ *
+ */
+void autotune_twiddle_fail() {
+  if (twiddle_run_active && twiddle_state == AUTOTUNE_TWIDDLE_RUNNING) {
+    twiddle_evaluate(AUTOTUNE_TWIDDLE_FAIL_SCORE);
+  }
+}
+
+/**
+ * @brief Termina la carrera: la vuelta en curso no puntúa y el punto recupera sus ganancias
+ * (desde la tarea de control, al detener)
+ *
+ */
+void autotune_twiddle_stop() {
+  if (!twiddle_run_active) {
+    return;
+  }
+  twiddle_run_active = false;
+  set_pid_gains(twiddle_point, twiddle_user_gains[0], twiddle_user_gains[1], twiddle_user_gains[2]);
+}
+
+/**
+ * @brief Obtiene unas ganancias propuestas, en las unidades de la tabla
+ * Ki por CONTROL_REFERENCE_US y Kd sobre la variación en CONTROL_REFERENCE_US:
+ * ki = Kp·ref/Ti, kd = Kp·Td/ref
+ *
+ * @param proposal AUTOTUNE_PROPOSALS
+ * @param kp Ganancia proporcional
+ * @param ki Ganancia integral
+ * @param kd Ganancia derivativa
+ * @return true Si la propuesta está disponible
+ */
+bool get_autotune_proposal(int proposal, float *kp, float *ki, float *kd) {
+  if (proposal == AUTOTUNE_PROPOSAL_TWIDDLE) {
+    if (twiddle_state == AUTOTUNE_TWIDDLE_OFF || twiddle_evaluations == 0) {
+      return false;
+    }
+    *kp = twiddle_best_p[0];
+    *ki = twiddle_ki;
+    *kd = twiddle_best_p[1];
+    return true;
+  }
+  if (proposal < 0 || proposal >= AUTOTUNE_PROPOSAL_TWIDDLE || !relay_result.valid) {
+    return false;
+  }
+
+  const autotune_rule_t &rule = autotune_rules[proposal];
+  float tu_us = relay_result.tu_us;
+  *kp = rule.kp * relay_result.ku;
+  *ki = rule.ti > 0 ? *kp * CONTROL_REFERENCE_US / (rule.ti * tu_us) : 0;
+  *kd = *kp * rule.td * tu_us / CONTROL_REFERENCE_US;
+  return true;
+}
+
+/**
+ * @brief Imprime el estado del Twiddle
+ *
+ */
+void print_autotune_twiddle() {
+  static const char *const twiddle_state_names[] = {"desactivado", "en curso", "convergido"};
+  Serial.print("Twiddle: ");
+  Serial.print(twiddle_state_names[twiddle_state]);
+  if (twiddle_state == AUTOTUNE_TWIDDLE_OFF) {
+    Serial.println();
+    return;
+  }
+  Serial.print(" | Punto: ");
+  Serial.print(twiddle_point);
+  Serial.print(" | Vueltas evaluadas: ");
+  Serial.print(twiddle_evaluations);
+  Serial.print("/");
+  Serial.println(AUTOTUNE_TWIDDLE_MAX_EVALUATIONS);
+  Serial.print("  Candidato Kp ");
+  Serial.print(twiddle_p[0], 4);
+  Serial.print(" (paso ");
+  Serial.print(twiddle_dp[0], 4);
+  Serial.print(") Kd ");
+  Serial.print(twiddle_p[1], 4);
+  Serial.print(" (paso ");
+  Serial.print(twiddle_dp[1], 4);
+  Serial.println(")");
+  if (twiddle_evaluations > 0) {
+    Serial.print("  Mejor Kp ");
+    Serial.print(twiddle_best_p[0], 4);
+    Serial.print(" Kd ");
+    Serial.print(twiddle_best_p[1], 4);
+    Serial.print(" | Puntuacion: ");
+    Serial.print(twiddle_best_score / 10.0f, 1);
+    Serial.println();
+  }
+}
+
+/**
+ * @brief Imprime el resultado del ensayo de relé, el Twiddle y las ganancias propuestas
+ *
+ */
+void print_autotune() {
+  Serial.print("Rele: ");
+  if (relay_state == AUTOTUNE_RELAY_RUNNING || relay_result.valid) {
+    Serial.print(relay_state_names[relay_state]);
+  } else if (relay_us == 0) {
+    Serial.print("sin ensayo (atr)");
+  } else {
+    Serial.print("ERROR ");
+    Serial.print(relay_state_names[relay_state]);
+  }
+  if (relay_result.valid) {
+    Serial.print(" | Ku: ");
+    Serial.print(relay_result.ku, 4);
+    Serial.print(" | Tu: ");
+    Serial.print(relay_result.tu_us / 1000.0f, 1);
+    Serial.print(" ms | Amplitud: ");
+    Serial.print(relay_result.amplitude);
+    Serial.print(" | Ciclos: ");
+    Serial.print(relay_result.cycles);
+  }
+  Serial.println();
+  print_autotune_twiddle();
+
+  Serial.println("N | Propuesta               | Kp     | Ki     | Kd");
+  for (int proposal = 0; proposal < AUTOTUNE_PROPOSALS_COUNT; proposal++) {
+    float kp, ki, kd;
+    if (!get_autotune_proposal(proposal, &kp, &ki, &kd)) {
+      continue;
+    }
+    char line[96];
+    snprintf(line, sizeof(line), "%d | %-23s | %.4f | %.4f | %.4f", proposal,
+             proposal == AUTOTUNE_PROPOSAL_TWIDDLE ? "Twiddle" : autotune_rules[proposal].name, kp, ki, kd);
+    Serial.println(line);
+  }
+}
@@ -0,0 +1,345 @@
+#include <blackbox.h>
+#include <estimator.h>
+#include <hal.h>
+
+/**
+ * @brief Buffer circular: solo lo escribe la tarea de control y se lee congelado
+ * Al congelarlo (línea perdida o parada manual) deja de grabarse hasta que se vuelca a la flash
+ * y empieza otra carrera
+ *
+ */
+static blackbox_frame_t *blackbox_buffer = NULL;
+static uint32_t blackbox_mask = 0;
+static uint32_t blackbox_head = 0;
+
+static volatile BLACKBOX_REASONS pending_reason = BLACKBOX_REASON_NONE;
+static volatile bool frozen = false;
+static volatile bool commit_requested = false;
+
+// Estado en el momento de congelar (lo escribe la tarea de control antes de commit_requested)
+static BLACKBOX_REASONS frozen_reason = BLACKBOX_REASON_NONE;
+static uint32_t frozen_head = 0;
+static uint32_t frozen_period_us = 0;
+static uint32_t frozen_us = 0;
+static unsigned long frozen_ms = 0;
+static blackbox_config_t frozen_config = {};
+
+static const char *const reason_names[BLACKBOX_REASONS_COUNT] = {
+  "ninguno", "linea perdida", "comando x", "boton"
+};
+
+/**
+ * @brief Reserva el buffer circular en PSRAM
+ *
+ */
+void init_blackbox() {
+  uint32_t capacity = BLACKBOX_CAPACITY;
+  blackbox_buffer = (blackbox_frame_t *)hal_psram_alloc(capacity * sizeof(blackbox_frame_t));
+  bool in_psram = blackbox_buffer != NULL;
+  if (blackbox_buffer == NULL) {
+    capacity = BLACKBOX_FALLBACK_CAPACITY;
+    blackbox_buffer = (blackbox_frame_t *)malloc(capacity * sizeof(blackbox_frame_t));
+  }
+  if (blackbox_buffer == NULL) {
+    Serial.println("Caja negra: ERROR sin memoria");
+    return;
+  }
+  blackbox_mask = capacity - 1;
+
+  Serial.print("Caja negra: ");
+  Serial.print(capacity);
+  Serial.println(in_psram ? " tramas en PSRAM" : " tramas en RAM interna");
+  if (hal_blackbox_partition_size() < sizeof(blackbox_header_t) + capacity * sizeof(blackbox_frame_t)) {
+    Serial.println("Caja negra: sin particion en la flash, no se guardara");
+  }
+}
+
+/**
+ * @brief Empieza a grabar una carrera (desde la tarea de control, al arrancar)
+ * Si el último congelado aún no se ha volcado a la flash se conserva y esta carrera no se graba
+ *
+ */
+void blackbox_start() {
+  pending_reason = BLACKBOX_REASON_NONE;
+  if (!commit_requested) {
+    blackbox_head = 0;
+    frozen = false;
+  }
+}
+
+/**
+ * @brief Añade la trama de un ciclo de control (solo desde la tarea de control)
+ * Nunca bloquea: con el buffer lleno sobrescribe la trama más antigua
+ *
+ * @param frame Trama del ciclo
+ */
+void blackbox_record(const blackbox_frame_t *frame) {
+  if (frozen || blackbox_buffer == NULL) {
+    return;
+  }
+  blackbox_buffer[blackbox_head & blackbox_mask] = *frame;
+  blackbox_head++;
+}
+
+/**
+ * @brief Pide congelar la caja negra al detener la carrera (desde cualquier tarea, antes de detenerla)
+ * Las carreras que terminan por el cronometraje no la congelan
+ *
+ * @param reason Motivo de la parada
+ */
+void blackbox_trigger(BLACKBOX_REASONS reason) {
+  if (pending_reason == BLACKBOX_REASON_NONE) {
+    pending_reason = reason;
+  }
+}
+
+/**
+ * @brief Copia la configuración que afecta al control (calibración, posición, PID, velocidades,
+ * freno, estimador y motores)
+ *
+ * @param config Configuración actual
+ */
+void get_blackbox_config(blackbox_config_t *config) {
+  int sensors_min[SENSORS_COUNT];
+  int sensors_max[SENSORS_COUNT];
+  int sensors_threshold[SENSORS_COUNT];
+  get_sensors_calibration(sensors_min, sensors_max, sensors_threshold);
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    config->sensors_min[sensor] = sensors_min[sensor];
+    config->sensors_max[sensor] = sensors_max[sensor];
+    config->sensors_threshold[sensor] = sensors_threshold[sensor];
+  }
+  config->sensors_noise = get_sensors_noise();
+  config->position_mode = get_sensor_position_mode();
+  config->smoothing = get_sensors_smoothing();
+  config->base_speed = get_base_speed();
+  config->base_accel_speed = get_base_accel_speed();
+  config->brake_max = get_brake_max();
+  config->decay_mode = get_motors_decay_mode();
+  config->d_filter_hz = get_pid_d_filter_hz();
+  config->pwm_hz = get_motors_pwm_hz();
+  config->pwm_resolution = get_motors_pwm_resolution();
+  config->estimator_enabled = is_estimator_enabled();
+  config->estimator_process_noise = get_estimator_process_noise();
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    get_pid_gains(point, &config->pid_gains[point][0], &config->pid_gains[point][1], &config->pid_gains[point][2]);
+  }
+}
+
+/**
+ * @brief Escribe la configuración en líneas "# clave valores" (las que lee sim/replay.cpp)
+ * Las ganancias y el ruido de proceso van con 9 cifras para reproducir el float exacto
+ *
+ * @param config Configuración
+ * @param period_us Periodo del bucle de control (μs)
+ * @param text Texto de salida, una línea por clave terminada en salto de línea
+ * @param size Tamaño de text (BLACKBOX_CONFIG_TEXT_MAX basta)
+ * @return int Longitud escrita
+ */
+int format_blackbox_config(const blackbox_config_t *config, unsigned long period_us, char *text, size_t size) {
+  int length = 0;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    length += snprintf(text + length, size - length, "# cal s%d %u %u %u\n", sensor + 1, config->sensors_min[sensor],
+                       config->sensors_max[sensor], config->sensors_threshold[sensor]);
+  }
+  length += snprintf(text + length, size - length, "# noise %u\n", config->sensors_noise);
+  length += snprintf(text + length, size - length, "# period %lu\n", period_us);
+  length += snprintf(text + length, size - length, "# mode %u\n", config->position_mode);
+  length += snprintf(text + length, size - length, "# smoothing %u\n", config->smoothing);
+  length += snprintf(text + length, size - length, "# speed %u %u\n", config->base_speed, config->base_accel_speed);
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    length += snprintf(text + length, size - length, "# pid %d %.9g %.9g %.9g\n", point, config->pid_gains[point][0],
+                       config->pid_gains[point][1], config->pid_gains[point][2]);
+  }
+  length += snprintf(text + length, size - length, "# dfilter %u\n", config->d_filter_hz);
+  length += snprintf(text + length, size - length, "# brake %u\n", config->brake_max);
+  length += snprintf(text + length, size - length, "# motors %u %u %u\n", config->pwm_hz, config->pwm_resolution,
+                     config->decay_mode);
+  length += snprintf(text + length, size - length, "# kalman %u %.9g\n", config->estimator_enabled,
+                     config->estimator_process_noise);
+  return length;
+}
+
+/**
+ * @brief Congela el buffer si la carrera se detuvo con un motivo (desde la tarea de control, al detener)
+ *
+ * @param period_us Periodo del bucle de control (μs)
+ */
+void blackbox_stop(unsigned long period_us) {
+  BLACKBOX_REASONS reason = pending_reason;
+  pending_reason = BLACKBOX_REASON_NONE;
+  if (reason == BLACKBOX_REASON_NONE || frozen || blackbox_buffer == NULL) {
+    return;
+  }
+  frozen_reason = reason;
+  frozen_head = blackbox_head;
+  frozen_period_us = period_us;
+  frozen_us = hal_micros();
+  frozen_ms = hal_millis();
+  get_blackbox_config(&frozen_config);
+  frozen = true;
+  commit_requested = true;
+}
+
+/**
+ * @brief Indica si hay un congelado esperando a volcarse y ya pasó BLACKBOX_COMMIT_DELAY_MS
+ *
+ * @return true Se puede llamar a blackbox_commit (con el robot detenido)
+ */
+bool blackbox_commit_pending() {
+  return commit_requested && hal_millis() - frozen_ms >= BLACKBOX_COMMIT_DELAY_MS;
+}
+
+/**
+ * @brief Vuelca el congelado a la partición de la flash, de la trama más antigua a la más reciente
+ * Solo desde la tarea de interfaz y con el robot detenido: mientras se escribe la flash se
+ * detienen las cachés y con ellas la tarea de control
+ *
+ * @return true Si se guardó correctamente
+ * @return false Sin partición o error de escritura
+ */
+bool blackbox_commit() {
+  if (!commit_requested) {
+    return false;
+  }
+
+  uint32_t frames = min(frozen_head, blackbox_mask + 1);
+  size_t size = sizeof(blackbox_header_t) + frames * sizeof(blackbox_frame_t);
+  bool saved = hal_blackbox_partition_size() >= size && hal_blackbox_partition_erase(size);
+
+  // Las tramas están en PSRAM: se copian por bloques a RAM interna antes de escribir
+  static uint8_t chunk[BLACKBOX_COMMIT_CHUNK];
+  size_t offset = sizeof(blackbox_header_t);
+  size_t used = 0;
+  for (uint32_t index = frozen_head - frames; saved && index != frozen_head; index++) {
+    memcpy(&chunk[used], &blackbox_buffer[index & blackbox_mask], sizeof(blackbox_frame_t));
+    used += sizeof(blackbox_frame_t);
+    if (used + sizeof(blackbox_frame_t) > sizeof(chunk) || index + 1 == frozen_head) {
+      saved = hal_blackbox_partition_write(offset, chunk, used);
+      offset += used;
+      used = 0;
+    }
+  }
+
+  if (saved) {
+    blackbox_header_t header = {};
+    header.magic = BLACKBOX_MAGIC;
+    header.version = BLACKBOX_VERSION;
+    header.frame_size = sizeof(blackbox_frame_t);
+    header.frames = frames;
+    header.period_us = frozen_period_us;
+    header.stop_us = frozen_us;
+    header.reason = frozen_reason;
+    header.config = frozen_config;
+    saved = hal_blackbox_partition_write(0, &header, sizeof(header));
+  }
+  commit_requested = false;
+
+  Serial.print("Caja negra (");
+  Serial.print(reason_names[frozen_reason]);
+  Serial.print("): ");
+  if (saved) {
+    Serial.print(frames);
+    Serial.println(" tramas guardadas en la flash (bbd para verlas)");
+  } else {
+    Serial.println("ERROR guardando en la flash");
+  }
+  return saved;
+}
+
+/**
+ * @brief Lee la cabecera del volcado guardado en la flash
+ *
+ * @param header Cabecera leída
+ * @return true Hay un volcado válido
+ */
+static bool read_header(blackbox_header_t *header) {
+  return hal_blackbox_partition_read(0, header, sizeof(*header)) && header->magic == BLACKBOX_MAGIC &&
+         header->version == BLACKBOX_VERSION && header->frame_size == sizeof(blackbox_frame_t) &&
+         header->reason < BLACKBOX_REASONS_COUNT &&
+         sizeof(blackbox_header_t) + header->frames * sizeof(blackbox_frame_t) <= hal_blackbox_partition_size();
+}
+
+/**
+ * @brief Imprime el estado de la grabación y del volcado guardado
+ *
+ */
+void print_blackbox_status() {
+  Serial.print("Caja negra: ");
+  Serial.print(frozen ? "congelada (" : "grabando");
+  if (frozen) {
+    Serial.print(reason_names[frozen_reason]);
+    Serial.print(commit_requested ? ", pendiente de guardar)" : ")");
+  }
+  Serial.print(" | Tramas: ");
+  Serial.print(min(frozen ? frozen_head : blackbox_head, blackbox_mask + 1));
+  Serial.print(" | Capacidad: ");
+  Serial.println(blackbox_buffer != NULL ? blackbox_mask + 1 : 0);
+
+  blackbox_header_t header;
+  if (!read_header(&header)) {
+    Serial.println("Flash: sin volcado guardado");
+    return;
+  }
+  Serial.print("Flash: ");
+  Serial.print(header.frames);
+  Serial.print(" tramas | Motivo: ");
+  Serial.print(reason_names[header.reason]);
+  Serial.print(" | Periodo: ");
+  Serial.print(header.period_us);
+  Serial.println(" us");
+}
+
+/**
+ * @brief Imprime en CSV las tramas del volcado guardado anteriores a la parada
+ *
+ * @param window_ms Tiempo antes de la parada (ms, 0 = todas las tramas)
+ * @return true Si había un volcado válido
+ */
+bool print_blackbox_dump(unsigned long window_ms) {
+  blackbox_header_t header;
+  if (!read_header(&header)) {
+    Serial.println("Caja negra: sin volcado guardado");
+    return false;
+  }
+
+  Serial.print("# Caja negra: ");
+  Serial.print(reason_names[header.reason]);
+  Serial.print(", parada en ");
+  Serial.print(header.stop_us);
+  Serial.print(" us, periodo ");
+  Serial.print(header.period_us);
+  Serial.println(" us");
+
+  // Configuración al congelar, para reproducir el volcado (sim/replay.cpp)
+  static char config_text[BLACKBOX_CONFIG_TEXT_MAX];
+  format_blackbox_config(&header.config, header.period_us, config_text, sizeof(config_text));
+  Serial.print(config_text);
+
+  char line[192];
+  int length = snprintf(line, sizeof(line),
+                        "us,frame_us,race_ms,position,rate,integral,correction,speed,left,right,fan,flags,recovery");
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    length += snprintf(line + length, sizeof(line) - length, ",s%d", sensor + 1);
+  }
+  Serial.println(line);
+
+  for (uint32_t index = 0; index < header.frames; index++) {
+    blackbox_frame_t frame;
+    if (!hal_blackbox_partition_read(sizeof(header) + index * sizeof(frame), &frame, sizeof(frame))) {
+      Serial.println("Caja negra: ERROR leyendo la flash");
+      return false;
+    }
+    if (window_ms > 0 && header.stop_us - frame.us > window_ms * 1000) {
+      continue;
+    }
+    length = snprintf(line, sizeof(line), "%lu,%lu,%lu,%d,%ld,%d,%d,%d,%d,%d,%u,%u,%u", (unsigned long)frame.us,
+                      (unsigned long)frame.frame_us, (unsigned long)frame.race_ms, frame.position, (long)frame.rate,
+                      frame.integral, frame.correction, frame.speed, frame.left_speed, frame.right_speed, frame.fan_speed, frame.flags, frame.recovery);
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      length += snprintf(line + length, sizeof(line) - length, ",%u", frame.sensors[sensor]);
+    }
+    Serial.println(line);
+  }
+  return true;
+}
@@ -0,0 +1,140 @@
+#include <command_parser.h>
+#include <esp_rom_crc.h>
+
+/**
+ * @brief Estados del analizador de comandos
+ *
+ */
+enum COMMAND_PARSER_STATES {
+  PARSER_TEXT,        // Acumulando una línea de texto
+  PARSER_DISCARD,     // Línea demasiado larga, esperando el fin de línea
+  PARSER_SYNC,        // Recibido COMMANDS_SYNC_0
+  PARSER_ID,          // Esperando el id del comando binario
+  PARSER_LENGTH,      // Esperando la longitud del valor
+  PARSER_PAYLOAD,     // Recibiendo el valor
+  PARSER_CRC_LOW,     // Esperando el byte bajo del CRC
+  PARSER_CRC_HIGH     // Esperando el byte alto del CRC
+};
+
+static char text_buffer[COMMANDS_BUFFER_SIZE];
+static uint8_t text_length = 0;
+
+static COMMAND_PARSER_STATES parser_state = PARSER_TEXT;
+static uint8_t binary_frame[2 + COMMANDS_MAX_PAYLOAD];
+static uint8_t binary_length = 0;
+static uint8_t binary_received = 0;
+static uint16_t binary_crc = 0;
+
+/**
+ * @brief Descarta el comando a medias y vuelve a esperar una línea de texto
+ *
+ */
+void command_parser_reset() {
+  parser_state = PARSER_TEXT;
+  text_length = 0;
+}
+
+/**
+ * @brief Termina la línea de texto actual: elimina los espacios de los extremos
+ *
+ * @return const char* Línea terminada en '\0' (dentro del buffer de texto)
+ */
+static const char *finish_text_line() {
+  uint8_t start = 0;
+  while (start < text_length && isspace((unsigned char)text_buffer[start])) {
+    start++;
+  }
+  while (text_length > start && isspace((unsigned char)text_buffer[text_length - 1])) {
+    text_length--;
+  }
+  text_buffer[text_length] = '\0';
+  text_length = 0;
+  return &text_buffer[start];
+}
+
+/**
+ * @brief Procesa un byte recibido por el puerto serie
+ * Una línea de texto termina en '\n' o '\r'; un comando binario empieza por
+ * COMMANDS_SYNC_0 COMMANDS_SYNC_1 al principio de una línea (ver commands.h)
+ *
+ * @param byte Byte recibido
+ * @param result Comando completo (solo con COMMAND_PARSER_TEXT y COMMAND_PARSER_BINARY)
+ * @return COMMAND_PARSER_EVENTS Qué ha completado el byte
+ */
+COMMAND_PARSER_EVENTS command_parser_feed(uint8_t byte, command_parser_result_t *result) {
+  switch (parser_state) {
+    case PARSER_TEXT:
+      if (byte == COMMANDS_SYNC_0 && text_length == 0) {
+        parser_state = PARSER_SYNC;
+      } else if (byte == '\n' || byte == '\r') {
+        result->text = finish_text_line();
+        return COMMAND_PARSER_TEXT;
+      } else if (text_length < COMMANDS_BUFFER_SIZE - 1) {
+        text_buffer[text_length++] = byte;
+      } else {
+        text_length = 0;
+        parser_state = PARSER_DISCARD;
+        return COMMAND_PARSER_TOO_LONG;
+      }
+      break;
+
+    case PARSER_DISCARD:
+      if (byte == '\n' || byte == '\r') {
+        parser_state = PARSER_TEXT;
+      }
+      break;
+
+    case PARSER_SYNC:
+      if (byte == COMMANDS_SYNC_1) {
+        parser_state = PARSER_ID;
+      } else {
+        // Falso sincronismo: el byte se vuelve a examinar como texto (puede ser otro COMMANDS_SYNC_0)
+        parser_state = PARSER_TEXT;
+        return command_parser_feed(byte, result);
+      }
+      break;
+
+    case PARSER_ID:
+      binary_frame[0] = byte;
+      parser_state = PARSER_LENGTH;
+      break;
+
+    case PARSER_LENGTH:
+      binary_frame[1] = byte;
+      binary_length = byte;
+      binary_received = 0;
+      if (binary_length > COMMANDS_MAX_PAYLOAD) {
+        parser_state = PARSER_TEXT;
+      } else {
+        parser_state = binary_length > 0 ? PARSER_PAYLOAD : PARSER_CRC_LOW;
+      }
+      break;
+
+    case PARSER_PAYLOAD:
+      binary_frame[2 + binary_received++] = byte;
+      if (binary_received >= binary_length) {
+        parser_state = PARSER_CRC_LOW;
+      }
+      break;
+
+    case PARSER_CRC_LOW:
+      binary_crc = byte;
+      parser_state = PARSER_CRC_HIGH;
+      break;
+
+    case PARSER_CRC_HIGH:
+      binary_crc |= byte << 8;
+      parser_state = PARSER_TEXT;
+      if (binary_crc != esp_rom_crc16_le(0, binary_frame, 2 + binary_length)) {
+        return COMMAND_PARSER_BAD_CRC;
+      }
+      result->id = binary_frame[0];
+      result->length = binary_length;
+      result->value = 0;
+      if (binary_length == sizeof(float)) {
+        memcpy(&result->value, &binary_frame[2], sizeof(float));
+      }
+      return COMMAND_PARSER_BINARY;
+  }
+  return COMMAND_PARSER_NONE;
+}
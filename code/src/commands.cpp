@@ -0,0 +1,553 @@
+#include <commands.h>
+#include <command_parser.h>
+#include <sensors.h>
+#include <control.h>
+#include <telemetry.h>
+#include <storage.h>
+#include <profiler.h>
+#include <track_map.h>
+#include <suction.h>
+#include <recovery.h>
+#include <markers.h>
+#include <laps.h>
+#include <blackbox.h>
+#include <autotune.h>
+#include <estimator.h>
+
+/**
+ * @brief Entrada de la tabla de comandos
+ * name: texto del comando; si has_value, el texto va seguido de un número (ej: v40)
+ * in_race: el comando también se acepta durante la carrera
+ *
+ */
+struct command_t {
+  const char *name;
+  uint8_t id;
+  bool has_value;
+  bool in_race;
+  void (*handler)(float value);
+  const char *help;
+};
+
+/**
+ * @brief Inicia la carrera tras una cuenta regresiva de 3 segundos
+ *
+ */
+static void command_start(float value) {
+  Serial.println();
+  Serial.println("Iniciando en 3 segundos...");
+  for (int i = 3; i > 0; i--) {
+    Serial.print(i);
+    Serial.println("...");
+    delay(1000);
+  }
+  set_race_started(true);
+}
+
+static void command_stop(float value) {
+  if (is_race_started()) {
+    Serial.println();
+    Serial.println("Detencion manual solicitada");
+    blackbox_trigger(BLACKBOX_REASON_MANUAL);
+    set_race_started(false);
+  } else {
+    Serial.println("El robot no esta en carrera");
+  }
+}
+
+static void command_sensors_raw(float value) {
+  print_sensors_raw();
+}
+
+static void command_sensors_calibrated(float value) {
+  print_sensors_calibrated();
+}
+
+static void command_speed(float value) {
+  set_base_speed(value);
+}
+
+static void command_accel(float value) {
+  set_base_accel_speed(value);
+}
+
+static void command_fan(float value) {
+  set_base_fan_speed(value);
+}
+
+static void command_calibrate(float value) {
+  Serial.println("Re-calibrando sensores...");
+  calibrate_sensors();
+}
+
+static void command_auto_calibrate(float value) {
+  calibrate_sensors_auto();
+}
+
+static void command_position_mode(float value) {
+  set_sensor_position_mode(value == 1 ? POSITION_ANALOG : POSITION_BINARY);
+}
+
+static void command_telemetry(float value) {
+  set_telemetry_streaming(value != 0);
+}
+
+static void command_telemetry_status(float value) {
+  print_telemetry_status();
+}
+
+static void command_benchmark(float value) {
+  benchmark_control(CONTROL_BENCHMARK_ITERATIONS);
+}
+
+static void command_save(float value) {
+  save_config();
+}
+
+static void command_load(float value) {
+  load_config();
+}
+
+static void command_erase(float value) {
+  erase_config();
+}
+
+static void command_profiler(float value) {
+  print_profiler_stats();
+}
+
+static void command_profiler_reset(float value) {
+  reset_profiler_stats();
+}
+
+static void command_map(float value) {
+  print_track_map();
+}
+
+static void command_map_learn(float value) {
+  set_track_map_mode(TRACK_MAP_LEARN);
+}
+
+static void command_map_replay(float value) {
+  set_track_map_mode(value == 1 ? TRACK_MAP_REPLAY : TRACK_MAP_OFF);
+}
+
+static void command_map_straight(float value) {
+  set_track_map_speeds(value, get_track_map_curve_speed());
+  Serial.print("Velocidad en rectas: ");
+  Serial.println(get_track_map_straight_speed());
+}
+
+static void command_map_curve(float value) {
+  set_track_map_speeds(get_track_map_straight_speed(), value);
+  Serial.print("Velocidad en curvas: ");
+  Serial.println(get_track_map_curve_speed());
+}
+
+/**
+ * @brief Punto de la tabla de ganancias que modifican kp, ki y kd
+ *
+ */
+static int pid_point = 0;
+
+static void command_pid(float value) {
+  print_pid_gains();
+}
+
+static void command_pid_point(float value) {
+  pid_point = constrain((int)value, 0, PID_SCHEDULE_POINTS - 1);
+  Serial.print("Punto de ganancias ");
+  Serial.print(pid_point);
+  Serial.print(" (velocidad ");
+  Serial.print(get_pid_schedule_speed(pid_point));
+  Serial.println("%)");
+}
+
+/**
+ * @brief Modifica una ganancia del punto seleccionado e imprime la tabla
+ *
+ * @param gain 0: Kp, 1: Ki, 2: Kd
+ * @param value Nueva ganancia
+ */
+static void set_pid_point_gain(int gain, float value) {
+  float gains[3];
+  get_pid_gains(pid_point, &gains[0], &gains[1], &gains[2]);
+  gains[gain] = value;
+  set_pid_gains(pid_point, gains[0], gains[1], gains[2]);
+  print_pid_gains();
+}
+
+static void command_pid_kp(float value) {
+  set_pid_point_gain(0, value);
+}
+
+static void command_pid_ki(float value) {
+  set_pid_point_gain(1, value);
+}
+
+static void command_pid_kd(float value) {
+  set_pid_point_gain(2, value);
+}
+
+static void command_control_period(float value) {
+  set_control_period_us(value);
+}
+
+static void command_pid_d_filter(float value) {
+  set_pid_d_filter_hz(value);
+}
+
+static void command_brake(float value) {
+  set_brake_max(value);
+}
+
+static void command_decay_mode(float value) {
+  set_motors_decay_mode(value != 0 ? MOTORS_DECAY_FAST : MOTORS_DECAY_SLOW);
+  Serial.print("Decaimiento de los motores: ");
+  Serial.println(get_motors_decay_mode() == MOTORS_DECAY_FAST ? "rapido (rueda libre)" : "lento (freno)");
+}
+
+/**
+ * @brief Aplica una nueva configuración del PWM de los motores e imprime la resultante
+ *
+ * @param frequency_hz Frecuencia en Hz
+ * @param resolution_bits Resolución en bits
+ */
+static void set_motors_pwm_config(int frequency_hz, int resolution_bits) {
+  if (!set_motors_pwm(frequency_hz, resolution_bits)) {
+    Serial.println("Configuracion PWM no valida (1000-40000 Hz, 8-12 bits, Hz * 2^bits <= 80 MHz) o motores en marcha");
+  }
+  Serial.print("PWM motores: ");
+  Serial.print(get_motors_pwm_hz());
+  Serial.print(" Hz, ");
+  Serial.print(get_motors_pwm_resolution());
+  Serial.println(" bits");
+}
+
+static void command_pwm_frequency(float value) {
+  set_motors_pwm_config(value, get_motors_pwm_resolution());
+}
+
+static void command_pwm_resolution(float value) {
+  set_motors_pwm_config(get_motors_pwm_hz(), value);
+}
+
+static void command_fan_status(float value) {
+  print_fan_status();
+}
+
+/**
+ * @brief Punto de la tabla de succión que modifica sfan
+ *
+ */
+static int suction_point = 0;
+
+static void command_suction(float value) {
+  print_suction();
+}
+
+static void command_suction_enable(float value) {
+  set_suction_enabled(value != 0);
+  print_suction();
+}
+
+static void command_suction_point(float value) {
+  suction_point = constrain((int)value, 0, SUCTION_SCHEDULE_POINTS - 1);
+  Serial.print("Punto de succion ");
+  Serial.print(suction_point);
+  Serial.print(" (velocidad ");
+  Serial.print(get_suction_speed(suction_point));
+  Serial.println("%)");
+}
+
+static void command_suction_fan(float value) {
+  set_suction_fan(suction_point, value);
+  print_suction();
+}
+
+static void command_suction_curve(float value) {
+  set_suction_curve_gain(value);
+  print_suction();
+}
+
+static void command_suction_brake(float value) {
+  set_suction_brake_boost(value);
+  print_suction();
+}
+
+static void command_suction_ramp(float value) {
+  set_suction_ramp(value);
+  print_suction();
+}
+
+static void command_recovery(float value) {
+  print_recovery_stats();
+}
+
+static void command_markers(float value) {
+  print_markers();
+}
+
+static void command_laps(float value) {
+  print_laps_run();
+  print_laps_history();
+}
+
+static void command_laps_target(float value) {
+  set_laps_target(value);
+  Serial.print("Vueltas por carrera: ");
+  Serial.println(get_laps_target());
+}
+
+static void command_laps_source(float value) {
+  set_laps_source(value == 1 ? LAPS_SOURCE_SIGNAL : LAPS_SOURCE_MARKER);
+  Serial.print("Vueltas por: ");
+  Serial.println(get_laps_source() == LAPS_SOURCE_SIGNAL ? "senal de START" : "marca de meta");
+}
+
+static void command_laps_clear(float value) {
+  clear_laps_history();
+  save_laps_history();
+  Serial.println("Historial de carreras borrado");
+}
+
+static void command_blackbox(float value) {
+  print_blackbox_status();
+}
+
+static void command_blackbox_dump(float value) {
+  print_blackbox_dump(max(value, 0.0f));
+}
+
+static void command_autotune(float value) {
+  print_autotune();
+}
+
+static void command_autotune_relay(float value) {
+  autotune_relay();
+}
+
+static void command_autotune_twiddle(float value) {
+  if (!set_autotune_twiddle(value == 1, pid_point)) {
+    Serial.println("Twiddle no disponible en carrera");
+    return;
+  }
+  print_autotune_twiddle();
+}
+
+/**
+ * @brief Aplica unas ganancias propuestas por el autoajuste al punto seleccionado (save las guarda)
+ *
+ * @param value Número de la propuesta (AUTOTUNE_PROPOSALS)
+ */
+static void command_autotune_apply(float value) {
+  float kp, ki, kd;
+  if (!get_autotune_proposal(value, &kp, &ki, &kd)) {
+    Serial.println("Propuesta no disponible (at para verlas)");
+    return;
+  }
+  set_pid_gains(pid_point, kp, ki, kd);
+  print_pid_gains();
+}
+
+static void command_estimator(float value) {
+  set_estimator_enabled(value == 1);
+  print_estimator();
+}
+
+static void command_estimator_noise(float value) {
+  set_estimator_process_noise(value);
+  print_estimator();
+}
+
+static void command_sensors_smoothing(float value) {
+  set_sensors_smoothing(value);
+  Serial.print("Suavizado de sensores: ");
+  Serial.print(get_sensors_smoothing());
+  Serial.println("%");
+}
+
+static void command_sensors_benchmark(float value) {
+  benchmark_sensors(SENSORS_BENCHMARK_ITERATIONS);
+}
+
+/**
+ * @brief Tabla de comandos disponibles (texto y binario)
+ *
+ */
+static const command_t commands[] = {
+  {"s", CMD_START, false, false, command_start, "Iniciar carrera (cuenta regresiva de 3 s)"},
+  {"x", CMD_STOP, false, true, command_stop, "Detener carrera"},
+  {"r", CMD_SENSORS_RAW, false, false, command_sensors_raw, "Mostrar sensores RAW"},
+  {"c", CMD_SENSORS_CAL, false, false, command_sensors_calibrated, "Mostrar sensores calibrados"},
+  {"v", CMD_SPEED, true, false, command_speed, "Cambiar velocidad base (ej: v40)"},
+  {"a", CMD_ACCEL, true, false, command_accel, "Cambiar aceleracion (ej: a70)"},
+  {"f", CMD_FAN, true, false, command_fan, "Cambiar velocidad turbina (ej: f90)"},
+  {"cal", CMD_CALIBRATE, false, false, command_calibrate, "Re-calibrar sensores"},
+  {"acal", CMD_AUTO_CALIBRATE, false, false, command_auto_calibrate, "Calibrar sensores girando en el sitio sobre la linea"},
+  {"m", CMD_POSITION_MODE, true, false, command_position_mode, "Modo de posicion binario/analogico (ej: m1)"},
+  {"t", CMD_TELEMETRY, true, false, command_telemetry, "Activar/desactivar telemetria binaria por USB (t1/t0)"},
+  {"ts", CMD_TELEMETRY_STATUS, false, true, command_telemetry_status, "Estado de la telemetria (tramas descartadas)"},
+  {"bench", CMD_BENCHMARK, false, false, command_benchmark, "Medir ciclos por iteracion del bucle de control"},
+  {"save", CMD_SAVE, false, false, command_save, "Guardar calibracion y ajustes en NVS"},
+  {"load", CMD_LOAD, false, false, command_load, "Cargar calibracion y ajustes de NVS"},
+  {"erase", CMD_ERASE, false, false, command_erase, "Borrar la configuracion guardada"},
+  {"prof", CMD_PROFILER, false, true, command_profiler, "Mostrar perfil del bucle de control (etapas, jitter)"},
+  {"profr", CMD_PROFILER_RESET, false, true, command_profiler_reset, "Reiniciar estadisticas del perfilador"},
+  {"map", CMD_MAP, false, false, command_map, "Mostrar mapa de pista (rectas, curvas, velocidades)"},
+  {"learn", CMD_MAP_LEARN, false, false, command_map_learn, "Grabar el mapa en la siguiente carrera (a velocidad base)"},
+  {"replay", CMD_MAP_REPLAY, true, false, command_map_replay, "Usar el perfil de velocidad del mapa (replay1/replay0)"},
+  {"vr", CMD_MAP_STRAIGHT, true, false, command_map_straight, "Velocidad del perfil en rectas (ej: vr70)"},
+  {"vc", CMD_MAP_CURVE, true, false, command_map_curve, "Velocidad del perfil en curvas (ej: vc40)"},
+  {"pid", CMD_PID, false, true, command_pid, "Mostrar tabla de ganancias PID por velocidad"},
+  {"pt", CMD_PID_POINT, true, true, command_pid_point, "Seleccionar punto de la tabla de ganancias (ej: pt1)"},
+  {"kp", CMD_PID_KP, true, true, command_pid_kp, "Kp del punto seleccionado (ej: kp0.25)"},
+  {"ki", CMD_PID_KI, true, true, command_pid_ki, "Ki del punto seleccionado (ej: ki0.0001)"},
+  {"kd", CMD_PID_KD, true, true, command_pid_kd, "Kd del punto seleccionado (ej: kd0.9)"},
+  {"loop", CMD_CONTROL_PERIOD, true, false, command_control_period, "Periodo del bucle de control en us, 250-2000 (ej: loop500)"},
+  {"fd", CMD_PID_D_FILTER, true, true, command_pid_d_filter, "Corte del filtro del derivativo en Hz, 0 sin filtro (ej: fd150)"},
+  {"bk", CMD_BRAKE, true, true, command_brake, "Par de freno maximo al entrar en curvas, 0 sin freno (ej: bk60)"},
+  {"dm", CMD_DECAY_MODE, true, false, command_decay_mode, "Decaimiento de los motores lento/rapido (dm0/dm1)"},
+  {"pwmf", CMD_PWM_FREQUENCY, true, false, command_pwm_frequency, "Frecuencia del PWM de los motores en Hz (ej: pwmf20000)"},
+  {"pwmr", CMD_PWM_RESOLUTION, true, false, command_pwm_resolution, "Resolucion del PWM de los motores en bits (ej: pwmr10)"},
+  {"fan", CMD_FAN_STATUS, false, true, command_fan_status, "Estado de la turbina (protocolo, mando, RPM)"},
+  {"suc", CMD_SUCTION, false, true, command_suction, "Mostrar tabla del planificador de succion"},
+  {"sch", CMD_SUCTION_ENABLE, true, true, command_suction_enable, "Planificador de succion activo/turbina constante (sch1/sch0)"},
+  {"spt", CMD_SUCTION_POINT, true, true, command_suction_point, "Seleccionar punto de la tabla de succion (ej: spt1)"},
+  {"sfan", CMD_SUCTION_FAN, true, true, command_suction_fan, "Succion en recta del punto seleccionado (ej: sfan60)"},
+  {"scv", CMD_SUCTION_CURVE, true, true, command_suction_curve, "Succion extra en curva (ej: scv25)"},
+  {"sbk", CMD_SUCTION_BRAKE, true, true, command_suction_brake, "Succion extra al frenar (ej: sbk15)"},
+  {"sramp", CMD_SUCTION_RAMP, true, true, command_suction_ramp, "Rampa de la turbina en %/s (ej: sramp200)"},
+  {"rec", CMD_RECOVERY, false, true, command_recovery, "Perdidas de linea y recuperaciones de la carrera"},
+  {"mk", CMD_MARKERS, false, true, command_markers, "Marcas laterales y cruces detectados en la carrera"},
+  {"laps", CMD_LAPS, false, true, command_laps, "Vueltas de la ultima carrera e historial de carreras"},
+  {"lapn", CMD_LAPS_TARGET, true, false, command_laps_target, "Vueltas por carrera, 0 sin limite (ej: lapn3)"},
+  {"lps", CMD_LAPS_SOURCE, true, false, command_laps_source, "Vueltas por marca de meta/senal de START (ej: lps0)"},
+  {"lapc", CMD_LAPS_CLEAR, false, false, command_laps_clear, "Borrar el historial de carreras"},
+  {"bb", CMD_BLACKBOX, false, true, command_blackbox, "Estado de la caja negra"},
+  {"bbd", CMD_BLACKBOX_DUMP, true, false, command_blackbox_dump, "Caja negra en CSV: ms antes de la parada, 0 todo (ej: bbd500)"},
+  {"at", CMD_AUTOTUNE, false, true, command_autotune, "Resultado del autoajuste y ganancias propuestas"},
+  {"atr", CMD_AUTOTUNE_RELAY, false, false, command_autotune_relay, "Ensayo de rele en el sitio sobre la linea (Ku y Tu)"},
+  {"att", CMD_AUTOTUNE_TWIDDLE, true, false, command_autotune_twiddle, "Twiddle de Kp/Kd del punto pt en cada vuelta (ej: att1)"},
+  {"ata", CMD_AUTOTUNE_APPLY, true, false, command_autotune_apply, "Aplicar una propuesta al punto pt (ej: ata0)"},
+  {"kf", CMD_ESTIMATOR, true, false, command_estimator, "Estimador de Kalman/derivativo filtrado (ej: kf1)"},
+  {"kfq", CMD_ESTIMATOR_NOISE, true, true, command_estimator_noise, "Ruido de proceso del estimador (ej: kfq0.25)"},
+  {"sfl", CMD_SMOOTHING, true, true, command_sensors_smoothing, "Suavizado IIR de los sensores en % (ej: sfl30, 0 = sin filtro)"},
+  {"benchs", CMD_SENSORS_BENCH, false, false, command_sensors_benchmark, "Comparar ciclos del procesado de sensores SIMD y escalar"},
+};
+
+#define COMMANDS_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+/**
+ * @brief Ejecuta un comando comprobando si está permitido en el estado actual y su valor
+ *
+ * @param command Comando a ejecutar
+ * @param value Valor del comando (0 si no tiene)
+ */
+static void dispatch_command(const command_t *command, float value) {
+  if (is_race_started() && !command->in_race) {
+    Serial.println("Comando no disponible en carrera");
+    return;
+  }
+  // inf/nan (texto o binario) envenenarían el PID y los handlers convierten a int
+  if (!isfinite(value) || fabsf(value) > COMMANDS_VALUE_MAX) {
+    Serial.println("Valor no valido");
+    return;
+  }
+  command->handler(value);
+}
+
+/**
+ * @brief Interpreta una línea de texto completa
+ * Primero busca coincidencia exacta y después nombre seguido de un número
+ *
+ * @param line Línea terminada en '\0' y sin espacios en los extremos
+ */
+static void dispatch_text(const char *line) {
+  if (line[0] == '\0') {
+    return;
+  }
+
+  for (size_t i = 0; i < COMMANDS_COUNT; i++) {
+    if (!commands[i].has_value && strcmp(line, commands[i].name) == 0) {
+      dispatch_command(&commands[i], 0);
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < COMMANDS_COUNT; i++) {
+    size_t name_length = strlen(commands[i].name);
+    if (commands[i].has_value && strncmp(line, commands[i].name, name_length) == 0) {
+      const char *value_text = line + name_length;
+      char *value_end = NULL;
+      float value = strtof(value_text, &value_end);
+      if (value_end != value_text && *value_end == '\0') {
+        dispatch_command(&commands[i], value);
+        return;
+      }
+    }
+  }
+
+  Serial.println("Comando no reconocido");
+}
+
+/**
+ * @brief Interpreta un comando binario con el CRC ya verificado
+ *
+ * @param id Identificador del comando
+ * @param value Valor del comando (0 si no tiene)
+ */
+static void dispatch_binary(uint8_t id, float value) {
+  for (size_t i = 0; i < COMMANDS_COUNT; i++) {
+    if (commands[i].id == id) {
+      dispatch_command(&commands[i], value);
+      return;
+    }
+  }
+  Serial.println("Comando binario no reconocido");
+}
+
+/**
+ * @brief Consume los bytes disponibles en el puerto serie y ejecuta los comandos completos
+ * Nunca espera por datos: una línea incompleta queda en el analizador hasta la siguiente llamada
+ *
+ */
+void process_commands() {
+  while (Serial.available() > 0) {
+    int byte = Serial.read();
+    if (byte < 0) {
+      break;
+    }
+    command_parser_result_t command;
+    switch (command_parser_feed(byte, &command)) {
+      case COMMAND_PARSER_TEXT:
+        dispatch_text(command.text);
+        break;
+      case COMMAND_PARSER_BINARY:
+        dispatch_binary(command.id, command.value);
+        break;
+      case COMMAND_PARSER_TOO_LONG:
+        Serial.println("Comando demasiado largo");
+        break;
+      case COMMAND_PARSER_BAD_CRC:
+        Serial.println("Comando binario con CRC incorrecto");
+        break;
+      case COMMAND_PARSER_NONE:
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Imprime la lista de comandos disponibles
+ *
+ */
+void print_commands_help() {
+  for (size_t i = 0; i < COMMANDS_COUNT; i++) {
+    Serial.print("  ");
+    Serial.print(commands[i].name);
+    Serial.print(commands[i].has_value ? "[num]" : "");
+    Serial.print(" - ");
+    Serial.println(commands[i].help);
+  }
+}
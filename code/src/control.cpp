@@ -1,30 +1,345 @@
 #include <control.h>
+#include <profiler.h>
+#include <hal.h>
+#include <track_map.h>
+#include <suction.h>
+#include <recovery.h>
+#include <markers.h>
+#include <laps.h>
+#include <blackbox.h>
+#include <autotune.h>
+#include <estimator.h>
 
-static long last_control_loop_us = 0;
 static int position = 0;
-static int last_error = 0;
+static int last_position = 0;
 
-static int base_speed = 30;
-static int base_accel_speed = 60;
+static int base_speed = BASE_SPEED;
+static int base_accel_speed = BASE_ACCEL_SPEED;
 static int base_fan_speed = FAN_SPEED;
 static int speed = 0;
 
-static bool race_started = false;
-static bool race_starting = false;
-static long race_started_ms = 0;
-static long race_stopped_ms = 0;
+static volatile bool race_started = false;
+static volatile bool race_starting = false;
+static volatile bool control_reset_pending = false;
+static volatile bool calibration_spin = false;
+static volatile bool calibration_spin_stop = false;
+static unsigned long calibration_spin_us = 0;
+static volatile bool autotune_relay_active = false;
+static volatile bool autotune_relay_pending = false;
+static volatile long race_started_ms = 0;
+static unsigned long race_elapsed_ms = 0;
+static volatile long race_stopped_ms = 0;
+static volatile unsigned long control_period_us = CONTROL_LOOP_US;
+static volatile int pid_d_filter_hz = PID_D_FILTER_HZ;
+static volatile int brake_max = CONTROL_BRAKE_MAX;
+
+/**
+ * @brief Velocidad estimada de las ruedas (% en Q8) y par de freno aplicado en el ciclo
+ *
+ */
+static int32_t speed_estimate = 0;
+static int brake_torque = 0;
+
+/**
+ * @brief Ganancias de un punto de la tabla de velocidades
+ *
+ */
+struct pid_gains_t {
+  float kp;
+  float ki;
+  float kd;
+};
+
+static const int pid_schedule_speeds[PID_SCHEDULE_POINTS] = PID_SCHEDULE_SPEEDS;
+static pid_gains_t pid_schedule[PID_SCHEDULE_POINTS] = PID_SCHEDULE_GAINS;
+static volatile bool pid_schedule_pending = true;
+
+/**
+ * @brief Ganancias ya interpoladas para cada velocidad (0-100%)
+ * El ciclo de control solo indexa la tabla; se reconstruye al cambiar alguna ganancia
+ *
+ */
+#if CONTROL_FIXED_POINT
+struct pid_gains_q_t {
+  int32_t kp;
+  int32_t ki;
+  int32_t kd;
+};
+static pid_gains_q_t pid_lut[101];
+static int32_t pid_integral = 0;
+static int32_t pid_derivative = 0;  // Variación de la posición por CONTROL_REFERENCE_US en Q8
+#else
+static pid_gains_t pid_lut[101];
+static float pid_integral = 0;
+static float pid_derivative = 0;    // Variación de la posición por CONTROL_REFERENCE_US
+#endif
+
+/**
+ * @brief Trama de sensores de la última posición usada por el derivativo
+ *
+ */
+static unsigned long derivative_frame = 0;
+static unsigned long derivative_frame_us = 0;
+static bool derivative_ready = false;
+
+/**
+ * @brief Reconstruye las ganancias por velocidad interpolando la tabla (desde la tarea de control)
+ * Ki se escala aquí al periodo de control actual; Kd no lo necesita porque el derivativo
+ * ya se normaliza con el tiempo medido entre tramas
+ *
+ */
+static void update_pid_lut() {
+  for (int vel = 0; vel <= 100; vel++) {
+    int point = 0;
+    while (point < PID_SCHEDULE_POINTS - 1 && vel > pid_schedule_speeds[point + 1]) {
+      point++;
+    }
+    pid_gains_t gains = pid_schedule[point];
+    if (point < PID_SCHEDULE_POINTS - 1 && vel > pid_schedule_speeds[point]) {
+      const pid_gains_t &next = pid_schedule[point + 1];
+      float t = (float)(vel - pid_schedule_speeds[point]) / (pid_schedule_speeds[point + 1] - pid_schedule_speeds[point]);
+      gains.kp += (next.kp - gains.kp) * t;
+      gains.ki += (next.ki - gains.ki) * t;
+      gains.kd += (next.kd - gains.kd) * t;
+    }
+    gains.ki = gains.ki * control_period_us / CONTROL_REFERENCE_US;
+#if CONTROL_FIXED_POINT
+    pid_lut[vel].kp = gains.kp * CONTROL_Q_ONE;
+    pid_lut[vel].ki = gains.ki * CONTROL_Q_ONE;
+    pid_lut[vel].kd = gains.kd * CONTROL_Q_ONE;
+#else
+    pid_lut[vel] = gains;
+#endif
+  }
+}
+
+/**
+ * @brief Actualiza el derivativo con cada trama nueva de sensores
+ * Se deriva la medida (posición), no el error, con el tiempo real entre tramas, y se filtra
+ * con un paso bajo de primer orden. Entre tramas el derivativo se mantiene.
+ *
+ * @param measurement Posición calculada con la trama actual
+ */
+static void update_derivative(int measurement) {
+  unsigned long frame = get_sensors_frame_count();
+  if (frame == derivative_frame) {
+    return;
+  }
+  unsigned long frame_us = get_sensors_frame_us();
+  unsigned long dt_us = frame_us - derivative_frame_us;
+  derivative_frame = frame;
+  derivative_frame_us = frame_us;
+
+  if (derivative_ready && dt_us > 0) {
+    int delta = measurement - last_position;
+    unsigned long tau_us = pid_d_filter_hz > 0 ? 1000000UL / (2 * PI * pid_d_filter_hz) : 0;
+#if CONTROL_FIXED_POINT
+    int32_t raw = ((int64_t)delta * CONTROL_REFERENCE_US * 256) / (int64_t)dt_us;
+    int32_t alpha_q16 = ((uint64_t)dt_us << 16) / (tau_us + dt_us);
+    pid_derivative += ((int64_t)(raw - pid_derivative) * alpha_q16) >> 16;
+#else
+    float raw = (float)delta * CONTROL_REFERENCE_US / dt_us;
+    float alpha = (float)dt_us / (tau_us + dt_us);
+    pid_derivative += (raw - pid_derivative) * alpha;
+#endif
+  }
+  derivative_ready = true;
+  last_position = measurement;
+}
+
+/**
+ * @brief Actualiza el estimador con cada trama nueva de sensores con línea
+ * Su variación estimada sustituye al derivativo filtrado y la posición se extrapola hasta que
+ * la corrección llega a los motores. La última medida se guarda igual que en update_derivative
+ * para que al desactivar el estimador en marcha el derivativo siga sin salto
+ *
+ * @param measurement Posición calculada con la trama actual
+ * @return int Posición estimada con la latencia compensada
+ */
+static int update_estimate(int measurement) {
+  unsigned long frame = get_sensors_frame_count();
+  if (frame != derivative_frame) {
+    derivative_frame = frame;
+    derivative_frame_us = get_sensors_frame_us();
+    if (is_line_detected()) {
+      estimator_update(measurement, derivative_frame_us);
+    }
+    derivative_ready = true;
+    last_position = measurement;
+  }
+  float rate;
+  float estimate = estimator_predict(hal_micros(), get_estimator_latency_us(), &rate);
+#if CONTROL_FIXED_POINT
+  pid_derivative = rate * 256;
+#else
+  pid_derivative = rate;
+#endif
+  return lroundf(estimate);
+}
+
+/**
+ * @brief Variación filtrada de la posición de la línea (la del término derivativo)
+ *
+ * @return long Unidades de posición por segundo
+ */
+static inline long position_rate_per_s() {
+#if CONTROL_FIXED_POINT
+  return ((int64_t)pid_derivative * (1000000 / CONTROL_REFERENCE_US)) >> 8;
+#else
+  return pid_derivative * (1000000 / CONTROL_REFERENCE_US);
+#endif
+}
 
 /**
  * @brief Realiza el cálculo de la corrección del controlador PID
+ * Ganancias según la velocidad actual; el integral solo acumula si la salida no está
+ * saturada en el sentido del error (anti-windup) y se limita a ±PID_INTEGRAL_LIMIT
+ * Con el estimador activo, el error y el derivativo son los del filtro de Kalman
  *
- * @param error Desplazamiento del robot respecto a la línea
- * @return float Corrección del controlador PID
+ * @param error Desplazamiento del robot respecto a la línea (consigna 0: error = posición)
+ * @return Corrección del controlador PID (int en punto fijo, float en otro caso)
  */
+#if CONTROL_FIXED_POINT
+static int calc_correction(int error) {
+  const pid_gains_q_t &gains = pid_lut[constrain(speed, 0, 100)];
+  if (is_estimator_enabled()) {
+    error = update_estimate(error);
+  } else {
+    update_derivative(error);
+  }
+  int32_t p = gains.kp * error;
+  int32_t d = ((int64_t)gains.kd * pid_derivative) >> 8;
+
+  if (gains.ki != 0) {
+    int32_t output = p + pid_integral + d;
+    bool saturated = abs(output) >= PID_OUTPUT_LIMIT * CONTROL_Q_ONE && (output > 0) == (error > 0);
+    if (!saturated) {
+      pid_integral += gains.ki * error;
+      pid_integral = constrain(pid_integral, -PID_INTEGRAL_LIMIT * CONTROL_Q_ONE, PID_INTEGRAL_LIMIT * CONTROL_Q_ONE);
+    }
+  }
+  return (p + pid_integral + d) / CONTROL_Q_ONE;
+}
+#else
 static float calc_correction(int error) {
-  float p = PID_KP * error;
-  float d = PID_KD * (error - last_error);
-  last_error = error;
-  return p + d;
+  const pid_gains_t &gains = pid_lut[constrain(speed, 0, 100)];
+  if (is_estimator_enabled()) {
+    error = update_estimate(error);
+  } else {
+    update_derivative(error);
+  }
+  float p = gains.kp * error;
+  float d = gains.kd * pid_derivative;
+
+  if (gains.ki != 0) {
+    float output = p + pid_integral + d;
+    bool saturated = fabsf(output) >= PID_OUTPUT_LIMIT && (output > 0) == (error > 0);
+    if (!saturated) {
+      pid_integral += gains.ki * error;
+      pid_integral = constrain(pid_integral, -PID_INTEGRAL_LIMIT, PID_INTEGRAL_LIMIT);
+    }
+  }
+  return p + pid_integral + d;
+}
+#endif
+
+/**
+ * @brief Aplica la velocidad a los motores con la ruta seleccionada en compilación
+ *
+ * @param left_speed Velocidad del motor izquierdo (-100 a 100%)
+ * @param right_speed Velocidad del motor derecho (-100 a 100%)
+ */
+static inline void apply_motors_speed(int left_speed, int right_speed) {
+#if CONTROL_FIXED_POINT
+  set_motors_speed_pct(left_speed, right_speed);
+#else
+  set_motors_speed(left_speed, right_speed);
+#endif
+}
+
+/**
+ * @brief Par de freno necesario para llevar la velocidad estimada a la objetivo
+ *
+ * @param target_speed Velocidad objetivo (0-100%)
+ * @return int Par de freno (0 = sin frenar, hasta brake_max)
+ */
+static int calc_brake_torque(int target_speed) {
+  int excess = (speed_estimate >> 8) - target_speed;
+  if (brake_max <= 0 || excess <= CONTROL_BRAKE_MARGIN) {
+    return 0;
+  }
+  int torque = excess * CONTROL_BRAKE_GAIN;
+  return torque > brake_max ? brake_max : torque;
+}
+
+/**
+ * @brief Avanza un periodo de control el modelo de primer orden de la velocidad de las ruedas
+ * En marcha tiende a la velocidad pedida; frenando cae hacia 0 en proporción al par de freno
+ *
+ * @param drive_speed Velocidad pedida en el ciclo (0-100%)
+ * @param brake Par de freno aplicado en el ciclo (0-100%)
+ */
+static void update_speed_estimate(int drive_speed, int brake) {
+  int64_t period = control_period_us;
+  int64_t den = CONTROL_SPEED_TAU_US + period;
+  if (brake > 0) {
+    speed_estimate -= (int32_t)((int64_t)speed_estimate * brake * period / (100 * den));
+  } else {
+    speed_estimate += (int32_t)(((int64_t)drive_speed * 256 - speed_estimate) * period / den);
+  }
+}
+
+/**
+ * @brief Graba el ciclo de control actual en la caja negra y, si el envío está activo, en la telemetría
+ *
+ * @param correction Corrección del PID
+ * @param left_speed Velocidad aplicada al motor izquierdo
+ * @param right_speed Velocidad aplicada al motor derecho
+ * @param fan_speed Velocidad aplicada a la turbina
+ */
+static void record_frame(int correction, int left_speed, int right_speed, int fan_speed) {
+  MARKER_TYPES marker = get_marker_active();
+  RECOVERY_STATES recovery = get_recovery_state();
+
+  blackbox_frame_t frame;
+  frame.us = hal_micros();
+  frame.frame_us = get_sensors_frame_us();
+  frame.race_ms = race_started ? race_elapsed_ms : 0;
+  get_sensors_raw_frame(frame.sensors);
+  frame.position = position;
+  frame.rate = position_rate_per_s();
+#if CONTROL_FIXED_POINT
+  frame.integral = pid_integral / CONTROL_Q_ONE;
+#else
+  frame.integral = pid_integral;
+#endif
+  frame.correction = correction;
+  frame.speed = speed;
+  frame.left_speed = constrain(left_speed, -100, 100);
+  frame.right_speed = constrain(right_speed, -100, 100);
+  frame.fan_speed = fan_speed;
+  frame.flags = (race_started ? TELEMETRY_FLAG_RACE_STARTED : 0) |
+                (race_starting ? TELEMETRY_FLAG_RACE_STARTING : 0) |
+                (recovery != RECOVERY_TRACKING ? TELEMETRY_FLAG_LINE_LOST : 0) |
+                (brake_torque > 0 ? TELEMETRY_FLAG_BRAKING : 0) |
+                (marker == MARKER_LEFT || marker == MARKER_RIGHT ? TELEMETRY_FLAG_MARKER : 0) |
+                (marker == MARKER_CROSSING ? TELEMETRY_FLAG_CROSSING : 0);
+  frame.recovery = recovery;
+  blackbox_record(&frame);
+
+  if (!is_telemetry_streaming()) {
+    return;
+  }
+  telemetry_frame_t telemetry;
+  telemetry.us = frame.us;
+  memcpy(telemetry.sensors, frame.sensors, sizeof(telemetry.sensors));
+  telemetry.position = frame.position;
+  telemetry.correction = frame.correction;
+  telemetry.left_speed = frame.left_speed;
+  telemetry.right_speed = frame.right_speed;
+  telemetry.fan_speed = frame.fan_speed;
+  telemetry.flags = frame.flags;
+  telemetry_push(&telemetry);
 }
 
 /**
@@ -33,17 +348,19 @@ static float calc_correction(int error) {
  * @param started Indica si la carrera ha comenzado
  */
 void set_race_started(bool started) {
-  race_started = started;
+  // La tarea de control corre en el otro núcleo: todo lo que lee al ver race_started se
+  // publica antes que el propio race_started
   if (started) {
-    race_started_ms = millis();
-    speed = 0;
-    position = 0;
-    last_error = 0;
+    race_started_ms = hal_millis();
+    control_reset_pending = true;  // La tarea de control reinicia su estado en el siguiente ciclo
+    set_motors_enabled(true);
+    race_started = true;
     race_starting = false;  // Ya no está en pre-inicio
     set_led(true);          // Encender LED
     Serial.println(">>> CARRERA INICIADA <<<");
   } else {
-    race_stopped_ms = millis();
+    race_stopped_ms = hal_millis();  // Antes de detener: el frenado de gracia cuenta desde aquí
+    race_started = false;
     stop_motors();          // Apaga motores y turbina
     set_led(false);         // Apagar LED
     Serial.println(">>> CARRERA DETENIDA <<<");
@@ -56,9 +373,62 @@ void set_race_started(bool started) {
  * @param starting Indica si está en pre-inicio
  */
 void set_race_starting(bool starting) {
+  if (starting) {
+    set_motors_enabled(true);
+  }
   race_starting = starting;
 }
 
+/**
+ * @brief Inicia o termina el giro de la calibración automática (desde la tarea de interfaz)
+ * El giro lo ejecuta la tarea de control; al terminarlo, is_calibration_spinning sigue a true
+ * hasta que el robot completa el vaivén en curso
+ *
+ * @param spinning true para empezar a girar, false para terminar
+ * @return true Petición aceptada
+ * @return false En carrera o pre-inicio: no se gira
+ */
+bool set_calibration_spin(bool spinning) {
+  if (!spinning) {
+    calibration_spin_stop = true;
+    return true;
+  }
+  if (race_started || race_starting) {
+    return false;
+  }
+  calibration_spin_us = 0;
+  calibration_spin_stop = false;
+  set_motors_enabled(true);
+  calibration_spin = true;
+  return true;
+}
+
+bool is_calibration_spinning() {
+  return calibration_spin;
+}
+
+/**
+ * @brief Inicia el ensayo de relé del autoajuste (desde la tarea de interfaz)
+ * Lo ejecuta la tarea de control, que reinicia el PID y el ensayo en su siguiente ciclo; el PID
+ * parte de cero con las ganancias de la velocidad mínima
+ *
+ * @return true Petición aceptada
+ * @return false En carrera, pre-inicio o calibrando: no se ensaya
+ */
+bool start_autotune_relay() {
+  if (race_started || race_starting || calibration_spin) {
+    return false;
+  }
+  autotune_relay_pending = true;
+  set_motors_enabled(true);
+  autotune_relay_active = true;
+  return true;
+}
+
+bool is_autotune_relay_running() {
+  return autotune_relay_active;
+}
+
 /**
  * @brief Comprueba si la carrera está en curso
  *
@@ -88,6 +458,15 @@ long get_race_started_ms() {
   return race_started_ms;
 }
 
+/**
+ * @brief Obtiene el tiempo de carrera que usó el último ciclo de control (rampa de aceleración)
+ *
+ * @return unsigned long ms desde el inicio de la carrera
+ */
+unsigned long get_race_elapsed_ms() {
+  return race_elapsed_ms;
+}
+
 /**
  * @brief Obtiene los ms de detención de la carrera
  *
@@ -130,6 +509,24 @@ void set_base_fan_speed(int speed) {
   Serial.println(base_fan_speed);
 }
 
+/**
+ * @brief Obtiene la velocidad base del robot
+ *
+ * @return int Velocidad base (0-100)
+ */
+int get_base_speed() {
+  return base_speed;
+}
+
+/**
+ * @brief Obtiene la aceleración inicial del robot
+ *
+ * @return int Aceleración inicial (0-100)
+ */
+int get_base_accel_speed() {
+  return base_accel_speed;
+}
+
 /**
  * @brief Obtiene la velocidad base de la turbina
  *
@@ -143,69 +540,503 @@ int get_base_fan_speed() {
  * @brief Bucle de control inicial (pre-inicio)
  * Se ejecuta durante el último segundo de cuenta regresiva
  * Mantiene el robot centrado en la línea sin avanzar
- * Activa la turbina al 85% para preparar la succión
+ * Arranca la turbina con el planificador de succión para tener agarre en la salida
  *
  */
 void initial_control_loop() {
-  if (micros() - last_control_loop_us > CONTROL_LOOP_US || micros() < last_control_loop_us) {
-
-    // Obtener posición de la línea
-    position = get_sensor_position(position);
+  // Obtener posición de la línea
+  PROFILE_BEGIN(position);
+  position = get_sensor_position(position);
+  PROFILE_END(STAGE_POSITION, position);
 
-    // Calcular corrección PID
-    int correction = calc_correction(position);
+  // Calcular corrección PID
+  PROFILE_BEGIN(pid);
+  int correction = calc_correction(position);
+  PROFILE_END(STAGE_PID, pid);
 
-    // Aplicar solo corrección sin avanzar (giro en el lugar)
-    set_motors_speed(correction, -correction);
+  // Aplicar solo corrección sin avanzar (giro en el lugar)
+  PROFILE_BEGIN(motors);
+  apply_motors_speed(correction, -correction);
+  suction_update(0, position, position_rate_per_s(), false, base_fan_speed, control_period_us);
+  PROFILE_END(STAGE_MOTORS, motors);
 
-    last_control_loop_us = micros();
-  }
+  PROFILE_BEGIN(telemetry);
+  record_frame(correction, correction, -correction, get_suction_fan_speed());
+  PROFILE_END(STAGE_TELEMETRY, telemetry);
 }
 
 /**
  * @brief Bucle de control principal
  * Realiza el cálculo de la corrección del controlador PID y establece la velocidad de los motores
- * Esta función debe llamarse lo más frecuentemente posible
+ * Lo ejecuta la tarea de control una vez por periodo del temporizador
  *
  */
 void control_loop() {
-  if (micros() - last_control_loop_us > CONTROL_LOOP_US || micros() < last_control_loop_us) {
+  // Obtener posición de la línea
+  PROFILE_BEGIN(position);
+  position = get_sensor_position(position);
+  PROFILE_END(STAGE_POSITION, position);
+
+  // Calcular corrección PID
+  PROFILE_BEGIN(pid);
+  int correction = calc_correction(position);
+  PROFILE_END(STAGE_PID, pid);
 
-    // Obtener posición de la línea
-    position = get_sensor_position(position);
+  // Velocidad objetivo: base, o la del perfil del mapa de pista en este punto
+  int target_speed = get_track_map_speed(base_speed);
+
+  // Aceleración gradual mejorada (velocidad mínima de 20%); el tiempo de carrera se lee una vez
+  // por ciclo y se graba en la trama para poder reproducirlo
+  race_elapsed_ms = hal_millis() - race_started_ms;
+  if (speed < target_speed) {
+#if CONTROL_FIXED_POINT
+    long time_elapsed_ms = race_elapsed_ms;
+    speed = 20 + (base_accel_speed * time_elapsed_ms) / 1000;
+#else
+    float time_elapsed = race_elapsed_ms / 1000.0f;
+    speed = 20 + (base_accel_speed * time_elapsed);
+#endif
+    if (speed > target_speed) {
+      speed = target_speed;
+    }
+  } else {
+    // Frenada: el perfil ya limita la deceleración
+    speed = target_speed;
+  }
 
-    // Calcular corrección PID
-    int correction = calc_correction(position);
+  // Velocidades con corrección PID; sin línea, la recuperación las sustituye
+  // (hueco, búsqueda o reversa) y solo si no encuentra la línea se detiene el robot
+  int left_speed = speed + correction;
+  int right_speed = speed - correction;
+  RECOVERY_STATES recovery = recovery_update(is_line_detected(), position, position_rate_per_s(), correction,
+                                             speed, control_period_us, &left_speed, &right_speed);
+  if (recovery == RECOVERY_ABORT) {
+    set_motors_speed(0, 0);
+    set_fan_speed(0);
+    record_frame(correction, 0, 0, 0);
+    blackbox_trigger(BLACKBOX_REASON_LINE_LOST);
+    autotune_twiddle_fail();
+    set_race_started(false);
+    Serial.println("LINEA PERDIDA - Robot detenido");
+    return;
+  }
 
-    // Verificar si se perdió la línea
-    if (millis() - get_last_line_detected_ms() > LINE_LOST_TIMEOUT_MS) {
-      set_motors_speed(0, 0);
-      set_fan_speed(0);
-      set_race_started(false);
-      Serial.println("LINEA PERDIDA - Robot detenido");
+  // Cronometraje y estadísticas de la vuelta; la carrera termina al completar las vueltas
+  bool saturated = max(abs(left_speed), abs(right_speed)) >= 100;
+  bool race_finished = laps_update(position, recovery != RECOVERY_TRACKING, saturated, control_period_us);
+  autotune_twiddle_update(position, recovery != RECOVERY_TRACKING);
+  if (laps_crossed_line()) {
+    track_map_lap(get_laps_count());
+  }
+  if (race_finished) {
+    set_race_started(false);
+    if (get_laps_target() > 0 && get_laps_count() >= get_laps_target()) {
+      Serial.println("Vueltas completadas - Robot detenido");
     } else {
+      Serial.println("Sin pasar por meta - Robot detenido");
+    }
+    return;
+  }
+
+  // Si las ruedas van bastante más rápido que la objetivo, frenar activamente; frenando, la
+  // corrección se suma al par de freno (negativo) y la rueda interior frena más que la exterior
+  if (recovery == RECOVERY_TRACKING) {
+    brake_torque = calc_brake_torque(speed);
+    update_speed_estimate(speed, brake_torque);
+  } else {
+    brake_torque = 0;
+    update_speed_estimate((left_speed + right_speed) / 2, 0);
+  }
+  // El mapa integra la distancia con la velocidad pedida, no con el par de freno
+  track_map_update(max(left_speed, 0), max(right_speed, 0));
+
+  if (brake_torque > 0) {
+    left_speed = correction - brake_torque;
+    right_speed = -correction - brake_torque;
+  }
+
+  PROFILE_BEGIN(motors);
+  if (brake_torque > 0) {
+    set_motors_torque(left_speed, right_speed);
+  } else {
+    apply_motors_speed(left_speed, right_speed);
+  }
+
+  // Succión según velocidad, curva y frenada (0 si la turbina está desactivada)
+  suction_update(speed, position, position_rate_per_s(), brake_torque > 0, base_fan_speed, control_period_us);
+  PROFILE_END(STAGE_MOTORS, motors);
+
+  PROFILE_BEGIN(telemetry);
+  record_frame(correction, left_speed, right_speed, get_suction_fan_speed());
+  PROFILE_END(STAGE_TELEMETRY, telemetry);
+}
+
+/**
+ * @brief Giro en el sitio de la calibración automática
+ * Vaivén de CALIBRATION_SWING_MS centrado en el rumbo inicial; al pedir el final sigue hasta
+ * completar el vaivén en curso para quedar de nuevo sobre la línea
+ *
+ */
+static void calibration_spin_loop() {
+  const unsigned long swing_us = CALIBRATION_SWING_MS * 1000UL;
+  if (calibration_spin_stop && calibration_spin_us % swing_us < control_period_us) {
+    calibration_spin = false;
+    race_stopped_ms = hal_millis();  // Frenado de gracia como al detener la carrera
+    return;
+  }
+  int side = ((calibration_spin_us + swing_us / 2) / swing_us) % 2 == 0 ? 1 : -1;
+  apply_motors_speed(side * CALIBRATION_SPIN_SPEED, -side * CALIBRATION_SPIN_SPEED);
+  calibration_spin_us += control_period_us;
+}
+
+/**
+ * @brief Ensayo de relé del autoajuste en el sitio
+ * Como el pre-inicio gira sin avanzar, pero tras centrarse el relé sustituye a la corrección
+ * del PID; al terminar el robot frena como al detener la carrera
+ *
+ */
+static void autotune_relay_loop() {
+  position = get_sensor_position(position);
+  int correction = calc_correction(position);
+  if (autotune_relay_update(position, is_line_detected(), control_period_us, &correction) != AUTOTUNE_RELAY_RUNNING) {
+    autotune_relay_active = false;
+    race_stopped_ms = hal_millis();  // Frenado de gracia como al detener la carrera
+    return;
+  }
+  apply_motors_speed(correction, -correction);
+  record_frame(correction, correction, -correction, 0);
+}
+
+/**
+ * @brief Un ciclo de control de periodo fijo
+ * La HAL lo llama en cada periodo y ejecuta el bucle que corresponda al estado de la carrera
+ *
+ * @param ticks Periodos transcurridos desde la llamada anterior (más de 1 si hubo retraso)
+ */
+static void control_tick(uint32_t ticks) {
+  static bool was_running = false;
+
+  PROFILE_LOOP_START(control_period_us, ticks);
+
+  // Una trama nueva por ciclo también con el robot parado: la calibración y los comandos leen la última
+  update_sensors();
+
+  if (pid_schedule_pending) {
+    pid_schedule_pending = false;
+    update_pid_lut();
+  }
+
+  if (control_reset_pending) {
+    control_reset_pending = false;
+    speed = 0;
+    race_elapsed_ms = 0;
+    position = 0;
+    last_position = 0;
+    pid_integral = 0;
+    pid_derivative = 0;
+    derivative_ready = false;
+    estimator_start(get_sensor_position_noise());
+    speed_estimate = 0;
+    brake_torque = 0;
+    recovery_start();
+    markers_reset();
+    laps_start(base_speed);
+    autotune_twiddle_start();
+    blackbox_start();
+    track_map_start();
+  }
+
+  if (autotune_relay_pending) {
+    autotune_relay_pending = false;
+    speed = 0;
+    pid_integral = 0;
+    pid_derivative = 0;
+    derivative_ready = false;
+    estimator_start(get_sensor_position_noise());
+    autotune_relay_start();
+  }
+
+  if (race_started) {
+    control_loop();
+  } else if (race_starting) {
+    initial_control_loop();
+  } else if (calibration_spin) {
+    calibration_spin_loop();
+  } else if (autotune_relay_active) {
+    autotune_relay_loop();
+  }
+
+  // Si la carrera se detuvo durante el ciclo, asegurar que los motores quedan parados
+  // y frenar activamente durante el tiempo de gracia
+  bool running = race_started || race_starting || calibration_spin || autotune_relay_active;
+  if (was_running && !running) {
+    stop_motors();
+    brake_motors(brake_max);
+    brake_torque = 0;
+    suction_reset();
+    track_map_stop();
+    laps_stop();
+    autotune_twiddle_stop();
+    blackbox_stop(control_period_us);
+  }
+  was_running = running;
 
-      // Aceleración gradual mejorada (velocidad mínima de 20%)
-      if (speed < base_speed) {
-        float time_elapsed = (millis() - race_started_ms) / 1000.0f;
-        speed = 20 + (base_accel_speed * time_elapsed);
-        if (speed > base_speed) {
-          speed = base_speed;
-        }
-      }
-
-      // Aplicar velocidades con corrección PID
-      float left_speed = speed + correction;
-      float right_speed = speed - correction;
-
-      set_motors_speed(left_speed, right_speed);
-
-      // Activar turbina si está configurada
-      if (base_fan_speed > 0) {
-        set_fan_speed(base_fan_speed);
-      }
+  // Fin del frenado tras detener la carrera: se suelta el freno y los motores quedan deshabilitados
+  if (!running && are_motors_enabled() && hal_millis() - race_stopped_ms >= MOTORS_STOP_GRACE_MS) {
+    stop_motors();
+    set_motors_enabled(false);
+  }
+
+  // Turbina por DShot: una trama por ciclo con el mando actual
+  update_fan();
+
+  PROFILE_LOOP_END();
+}
+
+/**
+ * @brief Arranca la ejecución periódica del bucle de control
+ * En el robot es una tarea en CONTROL_TASK_CORE despertada por un temporizador hardware;
+ * debe llamarse desde el núcleo 1 para que la interrupción quede en el mismo núcleo
+ *
+ * @param period_us Periodo del bucle de control en μs
+ */
+void init_control_task(unsigned long period_us) {
+  control_period_us = constrain(period_us, CONTROL_LOOP_MIN_US, CONTROL_LOOP_MAX_US);
+  pid_schedule_pending = true;
+  hal_control_timer_start(control_period_us, control_tick);
+
+  Serial.print("Tarea de control: ");
+  Serial.print(1000000UL / control_period_us);
+  Serial.println(" Hz en nucleo 1");
+}
+
+/**
+ * @brief Mide el coste en ciclos de CPU de cada etapa del bucle de control
+ * Ejecuta posición, PID y conversión a ciclos de trabajo sobre la trama actual de sensores e
+ * imprime el mínimo y la media por iteración. Solo se permite con el robot detenido (motores
+ * deshabilitados): los ciclos de trabajo no se escriben en el PWM, y cada iteración clasifica la
+ * trama desde el mismo estado de marcas, que se restaura al terminar junto con el del control
+ *
+ * @param iterations Número de iteraciones a medir
+ */
+void benchmark_control(int iterations) {
+  if (are_motors_enabled()) {
+    Serial.println("Benchmark no disponible con los motores habilitados");
+    return;
+  }
+  iterations = max(iterations, 1);
+
+  const char *stage_names[3] = {"Posicion", "PID", "Ciclos de trabajo"};
+  uint32_t stage_min[3] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+  uint64_t stage_sum[3] = {0, 0, 0};
+  int bench_position = 0;
+  uint32_t duties[4];
+  int saved_last_position = last_position;
+  auto saved_integral = pid_integral;
+  auto saved_derivative = pid_derivative;
+  unsigned long saved_derivative_frame = derivative_frame;
+  unsigned long saved_derivative_frame_us = derivative_frame_us;
+  bool saved_derivative_ready = derivative_ready;
+  estimator_state_t saved_estimator;
+  get_estimator_state(&saved_estimator);
+  markers_state_t saved_markers;
+  get_markers_state(&saved_markers);
+  bool saved_line_detected = is_line_detected();
+  long saved_line_detected_ms = get_last_line_detected_ms();
+
+  for (int i = 0; i < iterations; i++) {
+    // Sin restaurar, las marcas reconocerían la trama ya clasificada y no la volverían a procesar
+    set_markers_state(&saved_markers);
+
+    uint32_t cycles_start = hal_cycles();
+    bench_position = get_sensor_position(bench_position);
+    uint32_t cycles_position = hal_cycles();
+    int correction = calc_correction(bench_position);
+    uint32_t cycles_pid = hal_cycles();
+#if CONTROL_FIXED_POINT
+    get_motors_speed_pct_duties(base_speed + correction, base_speed - correction, duties);
+#else
+    get_motors_speed_duties(base_speed + correction, base_speed - correction, duties);
+#endif
+    uint32_t cycles_motors = hal_cycles();
+
+    uint32_t stage_cycles[3] = {cycles_position - cycles_start, cycles_pid - cycles_position, cycles_motors - cycles_pid};
+    for (int stage = 0; stage < 3; stage++) {
+      stage_min[stage] = min(stage_min[stage], stage_cycles[stage]);
+      stage_sum[stage] += stage_cycles[stage];
     }
+  }
+  last_position = saved_last_position;
+  pid_integral = saved_integral;
+  pid_derivative = saved_derivative;
+  derivative_frame = saved_derivative_frame;
+  derivative_frame_us = saved_derivative_frame_us;
+  derivative_ready = saved_derivative_ready;
+  set_estimator_state(&saved_estimator);
+  set_markers_state(&saved_markers);
+  set_line_detected(saved_line_detected, saved_line_detected_ms);
+
+  Serial.print("BENCHMARK (");
+  Serial.print(CONTROL_FIXED_POINT ? "punto fijo" : "float");
+  Serial.print(", ");
+  Serial.print(iterations);
+  Serial.println(" iteraciones, ciclos por iteracion)");
+  uint32_t total_min = 0;
+  uint32_t total_avg = 0;
+  for (int stage = 0; stage < 3; stage++) {
+    uint32_t stage_avg = stage_sum[stage] / iterations;
+    total_min += stage_min[stage];
+    total_avg += stage_avg;
+    Serial.print("  ");
+    Serial.print(stage_names[stage]);
+    Serial.print(": min ");
+    Serial.print(stage_min[stage]);
+    Serial.print(" / media ");
+    Serial.println(stage_avg);
+  }
+  Serial.print("  Total: min ");
+  Serial.print(total_min);
+  Serial.print(" / media ");
+  Serial.println(total_avg);
+  Serial.println("  (sin la escritura del PWM: en carrera la mide el perfilador)");
+}
 
-    last_control_loop_us = micros();
+/**
+ * @brief Establece las ganancias de un punto de la tabla de velocidades
+ * La tarea de control reconstruye la interpolación en su siguiente ciclo
+ *
+ * @param point Punto de la tabla (0 a PID_SCHEDULE_POINTS - 1)
+ * @param kp Ganancia proporcional
+ * @param ki Ganancia integral (por ciclo de control)
+ * @param kd Ganancia derivativa
+ */
+void set_pid_gains(int point, float kp, float ki, float kd) {
+  if (point < 0 || point >= PID_SCHEDULE_POINTS) {
+    return;
   }
+  pid_schedule[point].kp = max(kp, 0.0f);
+  pid_schedule[point].ki = max(ki, 0.0f);
+  pid_schedule[point].kd = max(kd, 0.0f);
+  pid_schedule_pending = true;
+}
+
+/**
+ * @brief Obtiene las ganancias de un punto de la tabla de velocidades
+ *
+ * @param point Punto de la tabla (0 a PID_SCHEDULE_POINTS - 1)
+ * @param kp Ganancia proporcional
+ * @param ki Ganancia integral
+ * @param kd Ganancia derivativa
+ */
+void get_pid_gains(int point, float *kp, float *ki, float *kd) {
+  point = constrain(point, 0, PID_SCHEDULE_POINTS - 1);
+  *kp = pid_schedule[point].kp;
+  *ki = pid_schedule[point].ki;
+  *kd = pid_schedule[point].kd;
+}
+
+/**
+ * @brief Obtiene la velocidad de un punto de la tabla
+ *
+ * @param point Punto de la tabla (0 a PID_SCHEDULE_POINTS - 1)
+ * @return int Velocidad del punto (0-100%)
+ */
+int get_pid_schedule_speed(int point) {
+  return pid_schedule_speeds[constrain(point, 0, PID_SCHEDULE_POINTS - 1)];
+}
+
+/**
+ * @brief Imprime la tabla de ganancias por velocidad
+ *
+ */
+void print_pid_gains() {
+  Serial.println("Pt | Vel | Kp     | Ki     | Kd");
+  Serial.println("---+-----+--------+--------+-------");
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    Serial.print(point);
+    Serial.print("  | ");
+    Serial.print(pid_schedule_speeds[point]);
+    Serial.print("  | ");
+    Serial.print(pid_schedule[point].kp, 4);
+    Serial.print(" | ");
+    Serial.print(pid_schedule[point].ki, 4);
+    Serial.print(" | ");
+    Serial.println(pid_schedule[point].kd, 4);
+  }
+}
+
+/**
+ * @brief Cambia el periodo del bucle de control
+ * Ki se reescala al nuevo periodo en el siguiente ciclo; Kd ya usa el tiempo medido
+ *
+ * @param period_us Periodo en μs (CONTROL_LOOP_MIN_US a CONTROL_LOOP_MAX_US)
+ */
+void set_control_period_us(unsigned long period_us) {
+  control_period_us = constrain(period_us, CONTROL_LOOP_MIN_US, CONTROL_LOOP_MAX_US);
+  pid_schedule_pending = true;
+  hal_control_timer_set_period(control_period_us);
+  Serial.print("Periodo de control: ");
+  Serial.print(control_period_us);
+  Serial.print(" us (");
+  Serial.print(1000000UL / control_period_us);
+  Serial.println(" Hz)");
+}
+
+/**
+ * @brief Obtiene el periodo del bucle de control
+ *
+ * @return unsigned long Periodo en μs
+ */
+unsigned long get_control_period_us() {
+  return control_period_us;
+}
+
+/**
+ * @brief Cambia la frecuencia de corte del filtro del derivativo
+ *
+ * @param cutoff_hz Frecuencia de corte en Hz (0 = sin filtro)
+ */
+void set_pid_d_filter_hz(int cutoff_hz) {
+  pid_d_filter_hz = constrain(cutoff_hz, 0, PID_D_FILTER_MAX_HZ);
+  Serial.print("Filtro del derivativo: ");
+  if (pid_d_filter_hz > 0) {
+    Serial.print(pid_d_filter_hz);
+    Serial.println(" Hz");
+  } else {
+    Serial.println("desactivado");
+  }
+}
+
+/**
+ * @brief Obtiene la frecuencia de corte del filtro del derivativo
+ *
+ * @return int Frecuencia de corte en Hz (0 = sin filtro)
+ */
+int get_pid_d_filter_hz() {
+  return pid_d_filter_hz;
+}
+
+/**
+ * @brief Cambia el par de freno máximo al bajar la velocidad objetivo
+ *
+ * @param brake Par de freno máximo (0-100%, 0 = sin frenado activo)
+ */
+void set_brake_max(int brake) {
+  brake_max = constrain(brake, 0, 100);
+  Serial.print("Freno activo: ");
+  if (brake_max > 0) {
+    Serial.print(brake_max);
+    Serial.println("%");
+  } else {
+    Serial.println("desactivado");
+  }
+}
+
+/**
+ * @brief Obtiene el par de freno máximo
+ *
+ * @return int Par de freno máximo (0-100%)
+ */
+int get_brake_max() {
+  return brake_max;
 }
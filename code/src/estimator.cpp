@@ -0,0 +1,136 @@
+#include <estimator.h>
+#include <control.h>
+
+static volatile bool estimator_enabled = false;
+static volatile float process_noise = ESTIMATOR_PROCESS_NOISE;
+
+// Estado y covarianza (solo los toca la tarea de control)
+static estimator_state_t state = {false, 0, 1, 0, 0, 0, 0, 0};
+
+/**
+ * @brief Reinicia el estimador (al arrancar la carrera); la primera trama fija la posición
+ *
+ * @param measurement_sigma Desviación típica de la posición medida (unidades de posición)
+ */
+void estimator_start(float measurement_sigma) {
+  float sigma = max(measurement_sigma, ESTIMATOR_MEASUREMENT_SIGMA_MIN);
+  state.measurement_variance = sigma * sigma;
+  state.ready = false;
+}
+
+/**
+ * @brief Avanza el filtro hasta una trama de sensores y la incorpora (solo tramas con línea)
+ *
+ * @param position Posición medida en la trama (-255 a 255)
+ * @param frame_us Instante de la trama
+ */
+void estimator_update(int position, unsigned long frame_us) {
+  if (!state.ready) {
+    state.position = position;
+    state.rate = 0;
+    state.covariance_pp = state.measurement_variance;
+    state.covariance_pr = 0;
+    state.covariance_rr = ESTIMATOR_RATE_VARIANCE;
+    state.us = frame_us;
+    state.ready = true;
+    return;
+  }
+
+  // Predicción: velocidad constante, aceleración blanca de densidad q
+  float dt = (float)(frame_us - state.us) / CONTROL_REFERENCE_US;
+  float q = process_noise;
+  state.us = frame_us;
+  state.position += state.rate * dt;
+  state.covariance_pp += dt * (2 * state.covariance_pr + dt * state.covariance_rr) + q * dt * dt * dt / 3;
+  state.covariance_pr += dt * state.covariance_rr + q * dt * dt / 2;
+  state.covariance_rr += q * dt;
+
+  // Corrección con la posición medida
+  float innovation = position - state.position;
+  float gain_position = state.covariance_pp / (state.covariance_pp + state.measurement_variance);
+  float gain_rate = state.covariance_pr / (state.covariance_pp + state.measurement_variance);
+  state.position += gain_position * innovation;
+  state.rate += gain_rate * innovation;
+  state.covariance_rr -= gain_rate * state.covariance_pr;
+  state.covariance_pr -= gain_position * state.covariance_pr;
+  state.covariance_pp -= gain_position * state.covariance_pp;
+}
+
+/**
+ * @brief Posición extrapolada hasta que actúa la corrección
+ *
+ * @param now_us Instante actual
+ * @param latency_us Latencia de adquisición y actuación
+ * @param rate Variación estimada de la posición por CONTROL_REFERENCE_US
+ * @return float Posición estimada (-255 a 255)
+ */
+float estimator_predict(unsigned long now_us, unsigned long latency_us, float *rate) {
+  if (!state.ready) {
+    *rate = 0;
+    return 0;
+  }
+  unsigned long horizon_us = min(now_us - state.us, (unsigned long)ESTIMATOR_MAX_HORIZON_US) + latency_us;
+  *rate = state.rate;
+  float position = state.position + state.rate * horizon_us / CONTROL_REFERENCE_US;
+  return constrain(position, (float)-SENSORS_POSITION_MAX, (float)SENSORS_POSITION_MAX);
+}
+
+/**
+ * @brief Copia del estado del filtro (para que benchmark_control lo deje como estaba)
+ *
+ * @param saved Estado actual
+ */
+void get_estimator_state(estimator_state_t *saved) {
+  *saved = state;
+}
+
+void set_estimator_state(const estimator_state_t *saved) {
+  state = *saved;
+}
+
+/**
+ * @brief Latencia compensada además de la edad de la trama (ver ESTIMATOR_ACQUISITION_US)
+ *
+ * @return unsigned long Adquisición + medio periodo de control + medio periodo del PWM (μs)
+ */
+unsigned long get_estimator_latency_us() {
+  return ESTIMATOR_ACQUISITION_US + get_control_period_us() / 2 + 500000UL / get_motors_pwm_hz();
+}
+
+/**
+ * @brief Activa el estimador en lugar del derivativo filtrado (con el robot detenido)
+ *
+ * @param enabled true: posición y variación del filtro de Kalman; false: medida y derivativo
+ */
+void set_estimator_enabled(bool enabled) {
+  estimator_enabled = enabled;
+  state.ready = false;
+}
+
+bool is_estimator_enabled() {
+  return estimator_enabled;
+}
+
+void set_estimator_process_noise(float noise) {
+  process_noise = constrain(noise, 0.0f, ESTIMATOR_PROCESS_NOISE_MAX);
+}
+
+float get_estimator_process_noise() {
+  return process_noise;
+}
+
+/**
+ * @brief Imprime la configuración del estimador
+ *
+ */
+void print_estimator() {
+  Serial.print("Estimador: ");
+  Serial.print(estimator_enabled ? "Kalman" : "desactivado (derivativo filtrado)");
+  Serial.print(" | Ruido posicion: ");
+  Serial.print(get_sensor_position_noise(), 2);
+  Serial.print(" | Ruido proceso: ");
+  Serial.print(process_noise, 3);
+  Serial.print(" | Latencia: ");
+  Serial.print(get_estimator_latency_us());
+  Serial.println(" us + edad de la trama");
+}
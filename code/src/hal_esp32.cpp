@@ -0,0 +1,597 @@
+#include <hal.h>
+#include <sensors.h>
+#include <control.h>
+#include <atomic>
+#include <driver/adc.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <driver/ledc.h>
+#include <hal/ledc_ll.h>
+#include <driver/rmt.h>
+#include <esp_partition.h>
+
+/**
+ * @brief Tiempo y ciclos de CPU
+ *
+ */
+unsigned long hal_millis() {
+  return millis();
+}
+
+unsigned long hal_micros() {
+  return micros();
+}
+
+void hal_delay_ms(unsigned long ms) {
+  delay(ms);
+}
+
+uint32_t hal_cycles() {
+  return ESP.getCycleCount();
+}
+
+uint32_t hal_cycles_per_us() {
+  return getCpuFrequencyMhz();
+}
+
+/**
+ * @brief Entradas/salidas digitales
+ *
+ */
+void hal_gpio_output(int pin) {
+  pinMode(pin, OUTPUT);
+}
+
+void hal_gpio_input(int pin, bool pullup) {
+  pinMode(pin, pullup ? INPUT_PULLUP : INPUT);
+}
+
+void hal_gpio_write(int pin, bool level) {
+  digitalWrite(pin, level ? HIGH : LOW);
+}
+
+bool hal_gpio_read(int pin) {
+  return digitalRead(pin);
+}
+
+/**
+ * @brief Salidas PWM (LEDC)
+ *
+ */
+void hal_pwm_setup(int channel, int frequency_hz, int resolution_bits, int pin) {
+  ledcSetup(channel, frequency_hz, resolution_bits);
+  ledcAttachPin(pin, channel);
+}
+
+void hal_pwm_write(int channel, uint32_t duty) {
+  ledcWrite(channel, duty);
+}
+
+static portMUX_TYPE pwm_sync_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Asigna a todos los canales el timer LEDC del primero
+ * Así comparten periodo y fase, y una actualización conjunta se aplica en el mismo flanco
+ * (ledcSetup del core de Arduino asigna el timer (canal / 2) % 4 a cada canal)
+ *
+ * @param channels Canales PWM
+ * @param count Número de canales
+ */
+void hal_pwm_sync_channels(const int *channels, int count) {
+  ledc_timer_t timer = (ledc_timer_t)((channels[0] / 2) % 4);
+  for (int i = 1; i < count; i++) {
+    ledc_bind_channel_timer(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channels[i], timer);
+  }
+}
+
+/**
+ * @brief Escribe el ciclo de trabajo de varios canales directamente en los registros del LEDC
+ * Primero se cargan todos los ciclos y después, en una ráfaga sin interrupciones, se piden las
+ * actualizaciones: los canales del mismo timer las aplican juntos al final del periodo en curso.
+ * Requiere que los canales se hayan configurado con hal_pwm_setup y escrito una vez con
+ * hal_pwm_write (fija los parámetros de fundido que aquí no se tocan)
+ *
+ * @param channels Canales PWM
+ * @param duties Ciclo de trabajo de cada canal
+ * @param count Número de canales
+ */
+void hal_pwm_write_sync(const int *channels, const uint32_t *duties, int count) {
+  ledc_dev_t *hw = LEDC_LL_GET_HW();
+  for (int i = 0; i < count; i++) {
+    ledc_ll_set_duty_int_part(hw, LEDC_LOW_SPEED_MODE, (ledc_channel_t)channels[i], duties[i]);
+  }
+  portENTER_CRITICAL(&pwm_sync_lock);
+  for (int i = 0; i < count; i++) {
+    ledc_ll_set_duty_start(hw, LEDC_LOW_SPEED_MODE, (ledc_channel_t)channels[i], true);
+    ledc_ll_ls_channel_update(hw, LEDC_LOW_SPEED_MODE, (ledc_channel_t)channels[i]);
+  }
+  portEXIT_CRITICAL(&pwm_sync_lock);
+}
+
+/**
+ * @brief Turbina por DShot con el periférico RMT
+ * Un canal de transmisión genera la trama a partir de 16 ítems (uno por bit) y, en modo
+ * bidireccional, un canal de recepción en el mismo pin (open-drain con pull-up) captura la
+ * respuesta del ESC: 21 bits a 5/4 de la velocidad de la trama, unos 30 μs después
+ *
+ */
+#define DSHOT_TX_CHANNEL RMT_CHANNEL_0
+#define DSHOT_RX_CHANNEL RMT_CHANNEL_4
+#define DSHOT_CLOCK_HZ 80000000UL
+#define DSHOT_RX_BUFFER 512
+#define DSHOT_RESPONSE_BITS 21
+
+static rmt_item32_t dshot_items[17];
+static uint32_t dshot_bit_ticks = 0;
+static bool dshot_bidirectional = false;
+static RingbufHandle_t dshot_rx_ring = NULL;
+
+bool hal_dshot_start(int pin, int bitrate_kbps, bool bidirectional) {
+  dshot_bit_ticks = DSHOT_CLOCK_HZ / (bitrate_kbps * 1000UL);
+  dshot_bidirectional = bidirectional;
+
+  rmt_config_t tx = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, DSHOT_TX_CHANNEL);
+  tx.clk_div = 1;
+  tx.tx_config.idle_output_en = true;
+  tx.tx_config.idle_level = bidirectional ? RMT_IDLE_LEVEL_HIGH : RMT_IDLE_LEVEL_LOW;
+  if (rmt_config(&tx) != ESP_OK || rmt_driver_install(DSHOT_TX_CHANNEL, 0, 0) != ESP_OK) {
+    return false;
+  }
+
+  if (bidirectional) {
+    rmt_config_t rx = RMT_DEFAULT_CONFIG_RX((gpio_num_t)pin, DSHOT_RX_CHANNEL);
+    rx.clk_div = 1;
+    rx.rx_config.filter_en = true;
+    rx.rx_config.filter_ticks_thresh = 40;
+    // Sin flancos durante 4 bits de la respuesta: fin de la captura
+    rx.rx_config.idle_threshold = dshot_bit_ticks * 4 * 4 / 5;
+    if (rmt_config(&rx) != ESP_OK || rmt_driver_install(DSHOT_RX_CHANNEL, DSHOT_RX_BUFFER, 0) != ESP_OK) {
+      return false;
+    }
+    rmt_get_ringbuf_handle(DSHOT_RX_CHANNEL, &dshot_rx_ring);
+
+    // El ESC responde por el mismo cable: ambos canales conectados al pin y salida open-drain.
+    // rmt_set_gpio reconfigura la dirección del pin, así que el open-drain va después
+    rmt_set_gpio(DSHOT_TX_CHANNEL, RMT_MODE_TX, (gpio_num_t)pin, false);
+    rmt_set_gpio(DSHOT_RX_CHANNEL, RMT_MODE_RX, (gpio_num_t)pin, false);
+    gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_pullup_en((gpio_num_t)pin);
+    rmt_rx_start(DSHOT_RX_CHANNEL, true);
+  }
+  return true;
+}
+
+/**
+ * @brief Envía una trama DShot sin esperar a que termine
+ * Bit 1: 75% del bit en activo; bit 0: 37.5%. En modo bidireccional la señal va invertida
+ *
+ * @param frame Valor de 11 bits, bit de telemetría y CRC de 4 bits
+ */
+void hal_dshot_write(uint16_t frame) {
+  uint32_t active = dshot_bidirectional ? 0 : 1;
+  for (int bit = 0; bit < 16; bit++) {
+    bool one = frame & (0x8000 >> bit);
+    uint32_t high = one ? dshot_bit_ticks * 3 / 4 : dshot_bit_ticks * 3 / 8;
+    dshot_items[bit].level0 = active;
+    dshot_items[bit].duration0 = high;
+    dshot_items[bit].level1 = !active;
+    dshot_items[bit].duration1 = dshot_bit_ticks - high;
+  }
+  // Ítem final con duración 0: fin de la transmisión
+  dshot_items[16].val = 0;
+  rmt_write_items(DSHOT_TX_CHANNEL, dshot_items, 17, false);
+}
+
+/**
+ * @brief Recupera los niveles de la última respuesta del ESC (modo bidireccional)
+ * Convierte cada tramo de la captura en bits según la duración de un bit de la respuesta;
+ * descarta la propia trama transmitida, que también se captura por ser el mismo pin
+ *
+ * @param levels Niveles de los 21 bits, el primero en el bit 20
+ * @return true Si había una respuesta completa
+ * @return false Si no llegó respuesta desde la última llamada
+ */
+bool hal_dshot_read_response(uint32_t *levels) {
+  if (dshot_rx_ring == NULL) {
+    return false;
+  }
+
+  uint32_t response_bit_ticks = dshot_bit_ticks * 4 / 5;
+  bool found = false;
+  size_t size = 0;
+  rmt_item32_t *items;
+  while ((items = (rmt_item32_t *)xRingbufferReceive(dshot_rx_ring, &size, 0)) != NULL) {
+    int count = size / sizeof(rmt_item32_t);
+    uint32_t value = 0;
+    int bits = 0;
+    for (int i = 0; i < count && bits < DSHOT_RESPONSE_BITS; i++) {
+      const uint32_t durations[2] = {items[i].duration0, items[i].duration1};
+      const uint32_t item_levels[2] = {items[i].level0, items[i].level1};
+      for (int half = 0; half < 2 && bits < DSHOT_RESPONSE_BITS; half++) {
+        int run = (durations[half] + response_bit_ticks / 2) / response_bit_ticks;
+        // Duración 0: la captura terminó en reposo (alto) hasta completar los bits
+        if (durations[half] == 0) {
+          run = DSHOT_RESPONSE_BITS - bits;
+        }
+        for (int b = 0; b < run && bits < DSHOT_RESPONSE_BITS; b++) {
+          value = (value << 1) | item_levels[half];
+          bits++;
+        }
+      }
+    }
+    vRingbufferReturnItem(dshot_rx_ring, items);
+
+    // La trama propia tiene 16 ítems de bits completos; la respuesta empieza en bajo y
+    // nunca tiene más de 3 bits seguidos al mismo nivel
+    if (count < 16 && bits > 0 && (value >> (bits - 1)) == 0) {
+      while (bits < DSHOT_RESPONSE_BITS) {
+        value = (value << 1) | 1;
+        bits++;
+      }
+      *levels = value;
+      found = true;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Trama completa de los 16 sensores generada en segundo plano
+ *
+ */
+struct sensors_frame_t {
+  uint16_t raw[SENSORS_COUNT];
+  unsigned long count;
+  unsigned long us;
+};
+
+/**
+ * @brief Triple buffer entre la adquisición (escritor) y el control (lector)
+ * El escritor publica intercambiando su trama con la intermedia; el lector toma la intermedia
+ * solo si hay una nueva (bit SENSORS_FRAME_FRESH). Ninguno de los dos espera nunca al otro.
+ *
+ */
+#define SENSORS_FRAME_FRESH 0x80
+static sensors_frame_t sensors_frames[3];
+static uint8_t sensors_frame_write = 0;
+static uint8_t sensors_frame_read = 1;
+static std::atomic<uint8_t> sensors_frame_middle(2);
+
+static bool sensors_dma_enabled = false;
+static esp_timer_handle_t sensors_mux_timer = NULL;
+static uint8_t sensors_mux_state = 0;
+static unsigned long sensors_frame_count = 0;
+static unsigned long sensors_missed_slots = 0;
+static unsigned long sensors_refresh_us = 0;
+
+/**
+ * @brief Configura los pines CBA del multiplexor según el canal (0-7)
+ *
+ * @param channel Canal del multiplexor (0-7)
+ */
+static void set_mux_channel(int channel) {
+  digitalWrite(MUX_A, bitRead(channel, 0)); // Bit A (LSB)
+  digitalWrite(MUX_B, bitRead(channel, 1)); // Bit B
+  digitalWrite(MUX_C, bitRead(channel, 2)); // Bit C (MSB)
+}
+
+/**
+ * @brief Versión rápida de set_mux_channel para el temporizador de adquisición
+ * Escribe los tres bits con dos accesos a registro en lugar de tres digitalWrite
+ *
+ * @param channel Canal del multiplexor (0-7)
+ */
+static void set_mux_channel_fast(int channel) {
+  uint32_t set_mask = 0;
+  uint32_t clear_mask = 0;
+  (bitRead(channel, 0) ? set_mask : clear_mask) |= (1UL << MUX_A);
+  (bitRead(channel, 1) ? set_mask : clear_mask) |= (1UL << MUX_B);
+  (bitRead(channel, 2) ? set_mask : clear_mask) |= (1UL << MUX_C);
+  REG_WRITE(GPIO_OUT_W1TC_REG, clear_mask);
+  REG_WRITE(GPIO_OUT_W1TS_REG, set_mask);
+}
+
+/**
+ * @brief Vacía el buffer del DMA quedándose con la última conversión de cada canal
+ *
+ * @param skip Conversiones por canal que se descartan al principio (asentamiento del MUX)
+ * @param value_1_8 Última conversión de SENSOR_1_8 tras las descartadas (-1 si no hay)
+ * @param value_9_16 Última conversión de SENSOR_9_16 tras las descartadas (-1 si no hay)
+ */
+static void drain_sensors_dma(int skip, int *value_1_8, int *value_9_16) {
+  uint8_t buffer[SENSORS_ADC_CONV_PER_INTR * SOC_ADC_DIGI_RESULT_BYTES * 4];
+  uint32_t length = 0;
+  int count_1_8 = 0;
+  int count_9_16 = 0;
+
+  esp_err_t ret = adc_digi_read_bytes(buffer, sizeof(buffer), &length, 0);
+  while ((ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) && length > 0) {
+    for (uint32_t i = 0; i < length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      adc_digi_output_data_t *result = (adc_digi_output_data_t *)&buffer[i];
+      if (result->type2.channel == SENSORS_ADC_CHANNEL_1_8 && ++count_1_8 > skip) {
+        *value_1_8 = result->type2.data;
+      } else if (result->type2.channel == SENSORS_ADC_CHANNEL_9_16 && ++count_9_16 > skip) {
+        *value_9_16 = result->type2.data;
+      }
+    }
+    ret = adc_digi_read_bytes(buffer, sizeof(buffer), &length, 0);
+  }
+}
+
+/**
+ * @brief Callback del temporizador de adquisición (una vez por ranura del multiplexor)
+ * Vacía el buffer del DMA con las conversiones de la ranura que termina, sin las
+ * SENSORS_MUX_SETTLE_CONV primeras de cada canal (tomadas antes o durante el cambio del MUX), y
+ * avanza al siguiente estado. Lo que el DMA entregue entre el vaciado y el cambio es del estado
+ * anterior y se tira justo después de cambiar; lo que aún no haya entregado cae en las
+ * descartadas de la ranura siguiente.
+ * Canal N del MUX: sensor 8-N en SENSOR_1_8 y sensor 9+N en SENSOR_9_16 (del centro a los extremos)
+ *
+ * @param arg No utilizado
+ */
+static void sensors_mux_timer_cb(void *arg) {
+  int value_1_8 = -1;
+  int value_9_16 = -1;
+  drain_sensors_dma(SENSORS_MUX_SETTLE_CONV, &value_1_8, &value_9_16);
+
+  sensors_frame_t *frame = &sensors_frames[sensors_frame_write];
+  if (value_1_8 >= 0 && value_9_16 >= 0) {
+    frame->raw[7 - sensors_mux_state] = value_1_8;
+    frame->raw[8 + sensors_mux_state] = value_9_16;
+  } else {
+    // Sin conversiones asentadas en esta ranura: se conservan los valores de la trama anterior
+    sensors_missed_slots++;
+  }
+
+  sensors_mux_state++;
+  if (sensors_mux_state >= SENSORS_MUX_STATES) {
+    sensors_mux_state = 0;
+    frame->count = ++sensors_frame_count;
+    frame->us = micros();
+
+    // Publicar la trama y recuperar la intermedia como nueva trama de escritura
+    uint8_t previous = sensors_frame_middle.exchange(sensors_frame_write | SENSORS_FRAME_FRESH);
+    sensors_frame_write = previous & ~SENSORS_FRAME_FRESH;
+
+    // La nueva trama parte de la anterior por si falta alguna ranura
+    memcpy(sensors_frames[sensors_frame_write].raw, frame->raw, sizeof(frame->raw));
+  }
+  set_mux_channel_fast(sensors_mux_state);
+
+  int stale_1_8 = -1;
+  int stale_9_16 = -1;
+  drain_sensors_dma(0, &stale_1_8, &stale_9_16);
+}
+
+/**
+ * @brief Inicia el ADC en modo continuo con DMA y el temporizador de los multiplexores
+ *
+ * @return true Si la adquisición en segundo plano quedó en marcha
+ * @return false Si falló la configuración del ADC o del temporizador
+ */
+static bool init_sensors_dma() {
+  adc_digi_init_config_t init_config = {};
+  init_config.max_store_buf_size = SENSORS_ADC_CONV_PER_INTR * SOC_ADC_DIGI_RESULT_BYTES * 16;
+  init_config.conv_num_each_intr = SENSORS_ADC_CONV_PER_INTR * SOC_ADC_DIGI_RESULT_BYTES;
+  init_config.adc1_chan_mask = (1 << SENSORS_ADC_CHANNEL_1_8) | (1 << SENSORS_ADC_CHANNEL_9_16);
+  init_config.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init_config) != ESP_OK) {
+    return false;
+  }
+
+  static adc_digi_pattern_config_t pattern[2] = {};
+  pattern[0].atten = ADC_ATTEN_DB_11;
+  pattern[0].channel = SENSORS_ADC_CHANNEL_1_8;
+  pattern[0].unit = 0;
+  pattern[0].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  pattern[1] = pattern[0];
+  pattern[1].channel = SENSORS_ADC_CHANNEL_9_16;
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = ADC_CONV_LIMIT_EN;
+  config.conv_limit_num = 250;
+  config.pattern_num = 2;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = SENSORS_ADC_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  esp_timer_create_args_t timer_args = {};
+  timer_args.callback = sensors_mux_timer_cb;
+  timer_args.dispatch_method = ESP_TIMER_TASK;
+  timer_args.name = "sensors_mux";
+  timer_args.skip_unhandled_events = true;
+  if (esp_timer_create(&timer_args, &sensors_mux_timer) != ESP_OK ||
+      esp_timer_start_periodic(sensors_mux_timer, SENSORS_MUX_SLOT_US) != ESP_OK) {
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Configura los pines de los multiplexores y arranca la adquisición en segundo plano
+ *
+ * @return true Adquisición continua por DMA
+ * @return false Falló el DMA; hal_sensors_read_frame usará la lectura bloqueante
+ */
+bool hal_sensors_start() {
+  pinMode(MUX_A, OUTPUT);
+  pinMode(MUX_B, OUTPUT);
+  pinMode(MUX_C, OUTPUT);
+  pinMode(SENSOR_1_8, INPUT);
+  pinMode(SENSOR_9_16, INPUT);
+
+  set_mux_channel(0);
+
+  sensors_dma_enabled = init_sensors_dma();
+  return sensors_dma_enabled;
+}
+
+/**
+ * @brief Lectura bloqueante de los sensores cada 1ms (modo de respaldo sin DMA)
+ * Se van leyendo los valores de dos en dos por cada estado de los multiplexores
+ * La lectura se realiza simétricamente desde el centro hacia los extremos
+ *
+ */
+static bool read_frame_blocking(uint16_t *raw, unsigned long *count, unsigned long *us) {
+  if (micros() - sensors_refresh_us < 1000 && micros() >= sensors_refresh_us) {
+    return false;
+  }
+
+  for (int channel = 0; channel < SENSORS_MUX_STATES; channel++) {
+    set_mux_channel(channel);
+    delayMicroseconds(10);
+    raw[7 - channel] = analogRead(SENSOR_1_8);
+    raw[8 + channel] = analogRead(SENSOR_9_16);
+  }
+
+  // Volver al canal 0
+  set_mux_channel(0);
+
+  sensors_refresh_us = micros();
+  *count = ++sensors_frame_count;
+  *us = sensors_refresh_us;
+  return true;
+}
+
+/**
+ * @brief Toma la última trama completa de los sensores si hay una nueva
+ * Nunca espera a la adquisición (salvo en el modo de respaldo sin DMA)
+ *
+ * @param raw Array de SENSORS_COUNT elementos para los valores sin procesar
+ * @param count Número de trama (crece con cada trama generada)
+ * @param us Instante en μs en que se completó la trama
+ * @return true Si se copió una trama nueva
+ * @return false Si no hay trama nueva; raw, count y us no se modifican
+ */
+bool hal_sensors_read_frame(uint16_t *raw, unsigned long *count, unsigned long *us) {
+  if (!sensors_dma_enabled) {
+    return read_frame_blocking(raw, count, us);
+  }
+
+  if (!(sensors_frame_middle.load() & SENSORS_FRAME_FRESH)) {
+    return false;
+  }
+  uint8_t previous = sensors_frame_middle.exchange(sensors_frame_read);
+  sensors_frame_read = previous & ~SENSORS_FRAME_FRESH;
+
+  sensors_frame_t *frame = &sensors_frames[sensors_frame_read];
+  memcpy(raw, frame->raw, sizeof(frame->raw));
+  *count = frame->count;
+  *us = frame->us;
+  return true;
+}
+
+/**
+ * @brief Ranuras del multiplexor que no recibieron datos del DMA
+ *
+ * @return unsigned long Número de ranuras perdidas desde el arranque
+ */
+unsigned long hal_sensors_missed_slots() {
+  return sensors_missed_slots;
+}
+
+/**
+ * @brief Reserva memoria en la PSRAM
+ *
+ * @param size Bytes
+ * @return void* Memoria reservada o NULL si no hay PSRAM o no cabe
+ */
+void *hal_psram_alloc(size_t size) {
+  return psramFound() ? ps_malloc(size) : NULL;
+}
+
+/**
+ * @brief Partición de datos "blackbox" de partitions.csv (NULL si la tabla no la tiene)
+ *
+ */
+static const esp_partition_t *blackbox_partition() {
+  static const esp_partition_t *partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "blackbox");
+  return partition;
+}
+
+size_t hal_blackbox_partition_size() {
+  return blackbox_partition() != NULL ? blackbox_partition()->size : 0;
+}
+
+/**
+ * @brief Borra el principio de la partición, redondeando a sectores de la flash
+ *
+ * @param size Bytes que se van a escribir
+ */
+bool hal_blackbox_partition_erase(size_t size) {
+  size_t sectors = (size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+  return blackbox_partition() != NULL && sectors <= blackbox_partition()->size &&
+         esp_partition_erase_range(blackbox_partition(), 0, sectors) == ESP_OK;
+}
+
+bool hal_blackbox_partition_write(size_t offset, const void *data, size_t size) {
+  return blackbox_partition() != NULL && esp_partition_write(blackbox_partition(), offset, data, size) == ESP_OK;
+}
+
+bool hal_blackbox_partition_read(size_t offset, void *data, size_t size) {
+  return blackbox_partition() != NULL && esp_partition_read(blackbox_partition(), offset, data, size) == ESP_OK;
+}
+
+static hw_timer_t *control_timer = NULL;
+static TaskHandle_t control_task_handle = NULL;
+static void (*control_tick)(uint32_t ticks) = NULL;
+
+/**
+ * @brief Interrupción del temporizador de control: despierta la tarea de control
+ *
+ */
+static void IRAM_ATTR control_timer_isr() {
+  BaseType_t task_woken = pdFALSE;
+  vTaskNotifyGiveFromISR(control_task_handle, &task_woken);
+  if (task_woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/**
+ * @brief Tarea de control de periodo fijo
+ * Espera la notificación del temporizador y ejecuta un ciclo de control
+ *
+ * @param arg No utilizado
+ */
+static void control_task(void *arg) {
+  for (;;) {
+    uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    control_tick(ticks);
+  }
+}
+
+/**
+ * @brief Crea la tarea de control en CONTROL_TASK_CORE y arranca el temporizador que la despierta
+ *
+ * @param period_us Periodo del bucle de control en μs
+ * @param tick Ciclo de control; recibe los periodos transcurridos desde la llamada anterior
+ */
+void hal_control_timer_start(unsigned long period_us, void (*tick)(uint32_t ticks)) {
+  control_tick = tick;
+  xTaskCreatePinnedToCore(control_task, "control", CONTROL_TASK_STACK, NULL, CONTROL_TASK_PRIORITY, &control_task_handle, CONTROL_TASK_CORE);
+
+  control_timer = timerBegin(CONTROL_TIMER_NUM, CONTROL_TIMER_DIVIDER, true);
+  timerAttachInterrupt(control_timer, &control_timer_isr, true);
+  timerAlarmWrite(control_timer, period_us, true);
+  timerAlarmEnable(control_timer);
+}
+
+/**
+ * @brief Cambia el periodo del temporizador de control sin detenerlo
+ *
+ * @param period_us Nuevo periodo en μs
+ */
+void hal_control_timer_set_period(unsigned long period_us) {
+  if (control_timer != NULL) {
+    timerAlarmWrite(control_timer, period_us, true);
+  }
+}
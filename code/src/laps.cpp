@@ -0,0 +1,305 @@
+#include <laps.h>
+#include <markers.h>
+#include <hal.h>
+
+/**
+ * @brief Marca de salida/meta en LAPS_SOURCE_MARKER
+ *
+ */
+#define LAPS_MARKER MARKER_RIGHT
+
+/**
+ * @brief Tamaño de una fila impresa de las tablas de vueltas e historial (la más ancha ocupa 89)
+ *
+ */
+#define LAPS_PRINT_LINE 96
+
+static volatile LAPS_SOURCES laps_source = LAPS_SOURCE_MARKER;
+static volatile int laps_target = LAPS_TARGET;
+
+// Carrera en curso (solo lo toca la tarea de control)
+static bool run_active = false;
+static int run_base_speed = 0;
+static bool lap_open = false;
+static bool line_crossed = false;
+static unsigned long lap_start_us = 0;
+static int lap_count = 0;
+static lap_stats_t run_laps[LAPS_MAX];
+
+// Acumuladores de la vuelta en curso
+static uint32_t error_sum = 0;
+static uint32_t error_ticks = 0;
+static uint8_t error_max = 0;
+static uint8_t line_losses = 0;
+static uint32_t saturated_us = 0;
+static bool was_lost = false;
+
+// Flanco de la señal de START (lo marca la tarea de interfaz)
+static volatile bool signal_mark_pending = false;
+static volatile unsigned long signal_mark_us = 0;
+
+// Historial de carreras y resumen pendiente de imprimir
+static laps_history_t history = {1, 0, {}};
+static volatile bool summary_pending = false;
+
+static void reset_lap_stats(unsigned long start_us) {
+  lap_start_us = start_us;
+  error_sum = 0;
+  error_ticks = 0;
+  error_max = 0;
+  line_losses = 0;
+  saturated_us = 0;
+}
+
+/**
+ * @brief Empieza a contar las vueltas de una carrera (desde la tarea de control, al arrancar)
+ * Con la señal de START la vuelta 1 empieza en la salida; con marcas, en la primera marca
+ *
+ * @param base_speed Velocidad base de la carrera (se guarda en el historial)
+ */
+void laps_start(int base_speed) {
+  run_active = true;
+  run_base_speed = base_speed;
+  lap_count = 0;
+  lap_open = laps_source == LAPS_SOURCE_SIGNAL;
+  line_crossed = false;
+  was_lost = false;
+  signal_mark_pending = false;
+  reset_lap_stats(hal_micros());
+}
+
+/**
+ * @brief Cierra la vuelta en curso y guarda sus estadísticas
+ *
+ * @param end_us Instante del cruce de la línea de meta
+ */
+static void close_lap(unsigned long end_us) {
+  if (lap_count < LAPS_MAX) {
+    lap_stats_t *lap = &run_laps[lap_count];
+    lap->time_ms = (end_us - lap_start_us) / 1000;
+    lap->mean_error = error_ticks > 0 ? error_sum * 10 / error_ticks : 0;
+    lap->max_error = error_max;
+    lap->line_losses = line_losses;
+    lap->saturated_ms = saturated_us / 1000;
+  }
+  lap_count++;
+}
+
+/**
+ * @brief Avanza el cronometraje y las estadísticas de la vuelta (una vez por ciclo de control)
+ *
+ * @param position Posición de la línea (-255 a 255)
+ * @param line_lost true si la recuperación de línea está activa
+ * @param saturated true si alguna rueda está pedida al 100% o más
+ * @param period_us Periodo del bucle de control (μs)
+ * @return true La carrera ha terminado: vueltas completadas o sin pasar por meta en LAPS_TIMEOUT_MS
+ */
+bool laps_update(int position, bool line_lost, bool saturated, unsigned long period_us) {
+  // Cruce de la línea de meta
+  bool mark = false;
+  unsigned long mark_us = 0;
+  if (laps_source == LAPS_SOURCE_MARKER) {
+    marker_event_t event;
+    while (markers_pop_event(&event)) {
+      if (event.type == LAPS_MARKER) {
+        mark = true;
+        mark_us = event.us;
+      }
+    }
+  } else if (signal_mark_pending) {
+    mark = true;
+    mark_us = signal_mark_us;
+    signal_mark_pending = false;
+  }
+
+  line_crossed = mark && (!lap_open || mark_us - lap_start_us >= LAPS_MIN_LAP_MS * 1000UL);
+  if (line_crossed) {
+    if (lap_open) {
+      close_lap(mark_us);
+    }
+    lap_open = true;
+    reset_lap_stats(mark_us);
+    if (laps_target > 0 && lap_count >= laps_target) {
+      return true;
+    }
+  }
+
+  if (lap_open) {
+    int error = min(abs(position), 255);
+    error_sum += error;
+    error_ticks++;
+    error_max = max(error_max, (uint8_t)error);
+    if (line_lost && !was_lost && line_losses < UINT8_MAX) {
+      line_losses++;
+    }
+    if (saturated) {
+      saturated_us += period_us;
+    }
+  }
+  was_lost = line_lost;
+
+  return hal_micros() - lap_start_us >= LAPS_TIMEOUT_MS * 1000UL;
+}
+
+/**
+ * @brief Indica si el último laps_update cruzó la línea de meta (abre o cierra una vuelta)
+ *
+ * @return true Cruce aceptado en el ciclo actual
+ */
+bool laps_crossed_line() {
+  return line_crossed;
+}
+
+/**
+ * @brief Registra un flanco de subida de la señal de START durante la carrera (desde la interfaz)
+ *
+ */
+void laps_signal_mark() {
+  signal_mark_us = hal_micros();
+  signal_mark_pending = true;
+}
+
+/**
+ * @brief Termina la carrera: añade su resumen al historial (desde la tarea de control, al detener)
+ * La vuelta en curso no se cuenta
+ *
+ */
+void laps_stop() {
+  if (!run_active) {
+    return;
+  }
+  run_active = false;
+
+  laps_run_t run = {};
+  run.run = history.next_run++;
+  run.laps = min(lap_count, LAPS_MAX);
+  run.base_speed = run_base_speed;
+  uint64_t weighted_error = 0;
+  for (int lap = 0; lap < run.laps; lap++) {
+    const lap_stats_t *stats = &run_laps[lap];
+    run.best_ms = lap == 0 ? stats->time_ms : min(run.best_ms, stats->time_ms);
+    run.total_ms += stats->time_ms;
+    weighted_error += (uint64_t)stats->mean_error * stats->time_ms;
+    run.max_error = max(run.max_error, stats->max_error);
+    run.line_losses = min(run.line_losses + stats->line_losses, UINT8_MAX);
+    run.saturated_ms += stats->saturated_ms;
+  }
+  run.mean_error = run.total_ms > 0 ? weighted_error / run.total_ms : 0;
+
+  if (history.count == LAPS_HISTORY) {
+    memmove(&history.runs[0], &history.runs[1], sizeof(laps_run_t) * (LAPS_HISTORY - 1));
+    history.count--;
+  }
+  history.runs[history.count++] = run;
+  summary_pending = true;
+}
+
+/**
+ * @brief Indica (una sola vez) que hay una carrera terminada pendiente de imprimir y guardar
+ *
+ * @return true Acaba de terminar una carrera
+ */
+bool laps_take_summary() {
+  if (!summary_pending) {
+    return false;
+  }
+  summary_pending = false;
+  return true;
+}
+
+void set_laps_source(LAPS_SOURCES source) {
+  laps_source = source;
+}
+
+LAPS_SOURCES get_laps_source() {
+  return laps_source;
+}
+
+/**
+ * @brief Cambia el número de vueltas de la carrera
+ *
+ * @param laps Vueltas (0 = sin límite, hasta LAPS_TIMEOUT_MS sin pasar por meta)
+ */
+void set_laps_target(int laps) {
+  laps_target = constrain(laps, 0, LAPS_MAX);
+}
+
+int get_laps_target() {
+  return laps_target;
+}
+
+/**
+ * @brief Obtiene las vueltas completas de la carrera en curso o de la última
+ *
+ * @return int Vueltas completas
+ */
+int get_laps_count() {
+  return lap_count;
+}
+
+/**
+ * @brief Obtiene las estadísticas de una vuelta completa de la carrera en curso o de la última
+ *
+ * @param lap Vuelta (0 = primera)
+ * @return const lap_stats_t* Estadísticas o NULL si la vuelta no existe
+ */
+const lap_stats_t *get_lap_stats(int lap) {
+  if (lap < 0 || lap >= min(lap_count, LAPS_MAX)) {
+    return NULL;
+  }
+  return &run_laps[lap];
+}
+
+void get_laps_history(laps_history_t *copy) {
+  *copy = history;
+}
+
+/**
+ * @brief Restaura el historial (por ejemplo, cargado de NVS)
+ *
+ * @param saved Historial
+ */
+void set_laps_history(const laps_history_t *saved) {
+  history = *saved;
+  history.count = min(history.count, (uint8_t)LAPS_HISTORY);
+}
+
+void clear_laps_history() {
+  uint16_t next_run = history.next_run;
+  history = {};
+  history.next_run = next_run;
+}
+
+/**
+ * @brief Imprime las vueltas de la última carrera
+ * Una línea por vuelta; el ancho máximo de una fila (valores de 32 bits) cabe en LAPS_PRINT_LINE
+ *
+ */
+void print_laps_run() {
+  char line[LAPS_PRINT_LINE];
+  Serial.print("Vuelta | Tiempo ms | Err med | Err max | Sat ms | Perdidas\n");
+  for (int lap = 0; lap < min(lap_count, LAPS_MAX); lap++) {
+    const lap_stats_t *stats = &run_laps[lap];
+    snprintf(line, sizeof(line), "%6d | %9lu | %5u.%u | %7u | %6lu | %u\n", lap + 1, (unsigned long)stats->time_ms,
+             stats->mean_error / 10, stats->mean_error % 10, stats->max_error, (unsigned long)stats->saturated_ms,
+             stats->line_losses);
+    Serial.print(line);
+  }
+}
+
+/**
+ * @brief Imprime el historial de carreras, de la más antigua a la más reciente
+ *
+ */
+void print_laps_history() {
+  char line[LAPS_PRINT_LINE];
+  Serial.print("Carrera | Vel | Vueltas | Mejor ms | Media ms | Err med | Err max | Sat ms | Perdidas\n");
+  for (int index = 0; index < history.count; index++) {
+    const laps_run_t *run = &history.runs[index];
+    snprintf(line, sizeof(line), "%7u | %3u | %7u | %8lu | %8lu | %5u.%u | %7u | %6lu | %u\n", run->run,
+             run->base_speed, run->laps, (unsigned long)run->best_ms,
+             (unsigned long)(run->laps > 0 ? run->total_ms / run->laps : 0), run->mean_error / 10,
+             run->mean_error % 10, run->max_error, (unsigned long)run->saturated_ms, run->line_losses);
+    Serial.print(line);
+  }
+}
@@ -4,30 +4,34 @@
 #include <motors.h>
 #include <control.h>
 #include <utils.h>
+#include <commands.h>
+#include <storage.h>
+#include <laps.h>
+#include <blackbox.h>
+#include <autotune.h>
 
 /**
  * @brief Configuración del robot
  *
  */
-#define TEST_DURATION_MS 30000   // Tiempo máximo de prueba: 30 segundos
 #define START_DELAY_MS 3000      // Delay antes de iniciar: 3 segundos
 
-void setup() {
-  Serial.begin(115200);
-  delay(1000);
-
-  Serial.println("==============================================");
-  Serial.println("  EHECATL - Line Follower Robot");
-  Serial.println("  Basado en PX-01 Basic");
-  Serial.println("==============================================");
-  Serial.println();
+/**
+ * @brief Configuración de la tarea de interfaz (botón, serial y LED)
+ * Núcleo 0 con prioridad baja para no interferir con la tarea de control
+ *
+ */
+#define UI_TASK_CORE 0
+#define UI_TASK_PRIORITY 1
+#define UI_TASK_STACK 8192
 
-  // Inicializar componentes
-  Serial.println("Inicializando componentes...");
-  init_utils();
-  init_sensors();
-  init_motors();
+static void ui_task(void *arg);
 
+/**
+ * @brief Imprime la configuración de pines
+ *
+ */
+static void print_pinout() {
   Serial.println();
   Serial.println("==============================================");
   Serial.println("  CONFIGURACION DE PINES");
@@ -54,22 +58,69 @@ void setup() {
   Serial.println("  Turbina: Pin 12");
   Serial.println("==============================================");
   Serial.println();
+}
 
-  // LED parpadeando indicando calibración
-  Serial.println("Presiona el boton para calibrar sensores...");
-  while (get_btn_state() != BTN_PRESSED && get_btn_state() != BTN_LONG_PRESSED) {
-    blink_led(500);
-  }
-  set_led(false);
-  delay(500);
+void setup() {
+  Serial.begin(115200);
+
+  Serial.println("==============================================");
+  Serial.println("  EHECATL - Line Follower Robot");
+  Serial.println("  Basado en PX-01 Basic");
+  Serial.println("==============================================");
+  Serial.println();
+
+  // Inicializar componentes (el ESC se arma en segundo plano)
+  Serial.println("Inicializando componentes...");
+  init_utils();
+
+  // Mantener el botón pulsado al encender fuerza la calibración
+  bool force_calibration = get_btn_state() == BTN_PRESSING;
+
+  init_sensors();
+  init_motors();
+  init_telemetry();
+  init_blackbox();
+
+  // Ajustes guardados en NVS (también al forzar la calibración, que solo rehace los sensores)
+  bool config_loaded = load_config();
+  bool fast_boot = config_loaded && !force_calibration;
+  load_laps_history();
 
-  // Calibrar sensores
-  calibrate_sensors();
+  // Control en el núcleo 1 a periodo fijo (también mueve el robot en la calibración automática)
+  init_control_task(get_control_period_us());
 
-  // Configurar velocidades
-  set_base_speed(30);        // Velocidad base: 30%
-  set_base_accel_speed(60);  // Aceleración: 60%
-  set_base_fan_speed(80);    // Turbina: 80%
+  if (fast_boot) {
+    Serial.println("Arranque rapido: calibracion cargada de NVS");
+  } else {
+    print_pinout();
+
+    // LED parpadeando indicando calibración
+    Serial.println("Presiona el boton para calibrar sensores...");
+    Serial.println("  (presion larga: calibracion automatica girando sobre la linea)");
+
+    // El botón que forzó la calibración sigue pulsado: al soltarlo daría una presión larga
+    // (calibración automática con el robot en la mano); solo valen las presiones posteriores
+    while (get_btn_state() != BTN_IDLE) {
+      delay(10);
+    }
+    BTN_STATES btn_state = get_btn_state();
+    while (btn_state != BTN_PRESSED && btn_state != BTN_LONG_PRESSED) {
+      blink_led(500);
+      btn_state = get_btn_state();
+    }
+    set_led(false);
+    delay(500);
+
+    // Calibrar sensores
+    if (btn_state == BTN_LONG_PRESSED) {
+      calibrate_sensors_auto();
+    } else {
+      calibrate_sensors();
+    }
+
+    // Guardar la calibración (con los ajustes cargados o los de control.h) para que el siguiente arranque sea rápido
+    save_config();
+  }
 
   Serial.println("Sistema listo!");
   Serial.println();
@@ -80,24 +131,41 @@ void setup() {
   Serial.println("  2. Senal de START (Pin 6)");
   Serial.println("  3. Comando serial: s");
   Serial.println();
-  Serial.println("  OTROS COMANDOS:");
-  Serial.println("  x - Detener carrera");
-  Serial.println("  r - Mostrar sensores RAW");
-  Serial.println("  c - Mostrar sensores calibrados");
-  Serial.println("  v[num] - Cambiar velocidad base (ej: v40)");
-  Serial.println("  a[num] - Cambiar aceleracion (ej: a70)");
-  Serial.println("  f[num] - Cambiar velocidad turbina (ej: f90)");
-  Serial.println("  cal - Re-calibrar sensores");
+  Serial.println("  COMANDOS:");
+  print_commands_help();
   Serial.println("==============================================");
   Serial.println();
 
-  // LED indicando listo para iniciar
+  // LED indicando listo para iniciar (breve en arranque rápido)
   set_led(true);
-  delay(500);
+  delay(fast_boot ? 50 : 500);
   set_led(false);
+
+  // Interfaz en el núcleo 0
+  xTaskCreatePinnedToCore(ui_task, "ui", UI_TASK_STACK, NULL, UI_TASK_PRIORITY, NULL, UI_TASK_CORE);
 }
 
 void loop() {
+  // Todo el trabajo se hace en las tareas de control e interfaz
+  vTaskDelete(NULL);
+}
+
+/**
+ * @brief Un ciclo de la interfaz: botón, serial, LED y condiciones de parada
+ *
+ */
+static void ui_loop() {
+  static bool last_start_signal = false;
+
+  // Procesar los bytes recibidos por serial sin esperar líneas completas
+  process_commands();
+
+  // Señal de START: solo cuentan los flancos de subida, tanto para arrancar como para las vueltas.
+  // Si la carrera termina con START alto no vuelve a arrancar hasta que baje y suba de nuevo
+  bool start_signal = get_start_signal();
+  bool start_edge = start_signal && !last_start_signal;
+  last_start_signal = start_signal;
+
   // Verificar si NO está en carrera
   if (!is_race_started()) {
 
@@ -142,20 +210,19 @@ void loop() {
             set_led(false);
           }
 
-        } else {
+        } else if (!is_race_starting()) {
           // Último segundo: PRE-INICIO INTELIGENTE
           set_led(true);
-          set_race_starting(true);
 
-          // Activar turbina al 85% para preparar succión
+          // La tarea de control ejecuta el PID sin avanzar (mantiene centrado) y arranca la
+          // turbina con el planificador de succión
           if (get_base_fan_speed() > 0) {
-            set_fan_speed(get_base_fan_speed() * 0.85f);
-            Serial.println("  Pre-inicio: Turbina activada al 85%");
+            Serial.println("  Pre-inicio: Turbina en rampa (planificador de succion)");
           }
-
-          // Ejecutar control PID sin avanzar (mantiene centrado)
-          initial_control_loop();
+          set_race_starting(true);
         }
+
+        vTaskDelay(1);
       }
 
       Serial.println("  GO!");
@@ -164,96 +231,61 @@ void loop() {
     }
 
     // Verificar señal de START externa
-    if (get_start_signal()) {
+    if (start_edge) {
       Serial.println();
       Serial.println("Senal de START detectada!");
       delay(100);  // Pequeño delay para estabilizar
       set_race_started(true);
     }
 
-    // Procesar comandos del serial
-    if (Serial.available() > 0) {
-      String command = Serial.readStringUntil('\n');
-      command.trim();
-
-      if (command == "s") {
-        // Iniciar carrera con delay
-        Serial.println();
-        Serial.println("Iniciando en 3 segundos...");
-        for (int i = 3; i > 0; i--) {
-          Serial.print(i);
-          Serial.println("...");
-          delay(1000);
-        }
-        set_race_started(true);
-
-      } else if (command == "r") {
-        // Mostrar sensores RAW
-        print_sensors_raw();
-
-      } else if (command == "c") {
-        // Mostrar sensores calibrados
-        print_sensors_calibrated();
-
-      } else if (command.startsWith("v")) {
-        // Cambiar velocidad base
-        int speed = command.substring(1).toInt();
-        set_base_speed(speed);
-
-      } else if (command.startsWith("a")) {
-        // Cambiar aceleración
-        int accel = command.substring(1).toInt();
-        set_base_accel_speed(accel);
-
-      } else if (command.startsWith("f")) {
-        // Cambiar velocidad turbina
-        int fan = command.substring(1).toInt();
-        set_base_fan_speed(fan);
-
-      } else if (command == "cal") {
-        // Re-calibrar sensores
-        Serial.println("Re-calibrando sensores...");
-        calibrate_sensors();
-
-      } else if (command == "x") {
-        // Este comando solo funciona durante la carrera
-        Serial.println("El robot no esta en carrera");
-
-      } else {
-        Serial.println("Comando no reconocido");
-      }
-    }
-
   } else {
-    // EN CARRERA
-
-    // Ejecutar bucle de control
-    control_loop();
-
-    // Verificar comando de detención por serial
-    if (Serial.available() > 0) {
-      String command = Serial.readStringUntil('\n');
-      command.trim();
-      if (command == "x") {
-        Serial.println();
-        Serial.println("Detencion manual solicitada");
-        set_race_started(false);
-      }
-    }
+    // EN CARRERA (el bucle de control corre en su propia tarea)
 
     // Verificar botón para detener
     BTN_STATES btn_state = get_btn_state();
     if (btn_state == BTN_PRESSED || btn_state == BTN_LONG_PRESSED) {
       Serial.println();
       Serial.println("Boton presionado - Deteniendo");
+      blackbox_trigger(BLACKBOX_REASON_BUTTON);
       set_race_started(false);
     }
 
-    // Detener después del tiempo máximo de prueba
-    if (millis() - get_race_started_ms() >= TEST_DURATION_MS) {
+    // Paso por meta con la señal de START (el fin de la carrera lo decide el cronometraje)
+    if (start_edge && get_laps_source() == LAPS_SOURCE_SIGNAL) {
+      laps_signal_mark();
+    }
+  }
+
+  // Resumen de la carrera recién terminada
+  if (laps_take_summary()) {
+    Serial.println();
+    Serial.println("==============================================");
+    Serial.println("  RESUMEN DE LA CARRERA");
+    Serial.println("==============================================");
+    print_laps_run();
+    Serial.println();
+    print_laps_history();
+    save_laps_history();
+    if (get_autotune_twiddle_state() != AUTOTUNE_TWIDDLE_OFF) {
       Serial.println();
-      Serial.println("Tiempo de prueba completado");
-      set_race_started(false);
+      print_autotune_twiddle();
     }
   }
+
+  // Volcado de la caja negra a la flash, solo con el robot detenido
+  if (!is_race_started() && !is_race_starting() && blackbox_commit_pending()) {
+    blackbox_commit();
+  }
+}
+
+/**
+ * @brief Tarea de interfaz de baja prioridad
+ *
+ * @param arg No utilizado
+ */
+static void ui_task(void *arg) {
+  for (;;) {
+    ui_loop();
+    vTaskDelay(1);
+  }
 }
@@ -0,0 +1,266 @@
+#include <markers.h>
+#include <sensors.h>
+
+// Patrón de la trama anterior y protección de la posición (solo lo toca la tarea de control)
+static unsigned long last_frame_us = 0;
+static MARKER_TYPES last_type = MARKER_NONE;
+static uint16_t last_line = 0;
+static unsigned long hold_start_us = 0;
+static bool holding = false;
+
+// Histéresis de los eventos
+static MARKER_TYPES candidate_type = MARKER_NONE;
+static int candidate_frames = 0;
+static unsigned long candidate_us = 0;
+static volatile MARKER_TYPES active_type = MARKER_NONE;
+static int release_frames = 0;
+
+/**
+ * @brief Cola de eventos: la escribe la tarea de control y la lee quien los consuma
+ * Si está llena el evento se descarta (el contador del tipo sí se incrementa)
+ *
+ */
+static marker_event_t marker_queue[MARKERS_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+static volatile unsigned long marker_counts[MARKER_TYPES_COUNT];
+
+static const char *const marker_names[MARKER_TYPES_COUNT] = {
+  "ninguna", "izquierda", "derecha", "cruce", "linea ancha"
+};
+
+/**
+ * @brief Reinicia la histéresis, la cola y los contadores (al empezar la carrera)
+ *
+ */
+void markers_reset() {
+  last_frame_us = 0;
+  last_type = MARKER_NONE;
+  last_line = 0;
+  holding = false;
+  candidate_type = MARKER_NONE;
+  candidate_frames = 0;
+  active_type = MARKER_NONE;
+  release_frames = 0;
+  queue_tail = queue_head;
+  for (int type = 0; type < MARKER_TYPES_COUNT; type++) {
+    marker_counts[type] = 0;
+  }
+}
+
+static void publish_event(MARKER_TYPES type, unsigned long us) {
+  marker_counts[type]++;
+  uint32_t head = queue_head;
+  if (head - queue_tail >= MARKERS_QUEUE_SIZE) {
+    return;
+  }
+  marker_queue[head & (MARKERS_QUEUE_SIZE - 1)] = {type, us};
+  queue_head = head + 1;
+}
+
+/**
+ * @brief Avanza la histéresis de los eventos con el patrón de una trama nueva
+ *
+ * @param type Patrón de la trama
+ * @param frame_us Instante de la trama
+ */
+static void update_events(MARKER_TYPES type, unsigned long frame_us) {
+  if (active_type != MARKER_NONE) {
+    if (type == active_type) {
+      release_frames = 0;
+      return;
+    }
+    if (++release_frames < MARKERS_RELEASE_FRAMES) {
+      return;
+    }
+    active_type = MARKER_NONE;
+  }
+
+  if (type == MARKER_NONE) {
+    candidate_type = MARKER_NONE;
+    candidate_frames = 0;
+    return;
+  }
+  if (type != candidate_type) {
+    candidate_type = type;
+    candidate_frames = 0;
+    candidate_us = frame_us;
+  }
+  if (++candidate_frames >= MARKERS_CONFIRM_FRAMES) {
+    active_type = candidate_type;
+    release_frames = 0;
+    candidate_type = MARKER_NONE;
+    candidate_frames = 0;
+    publish_event(active_type, candidate_us);
+  }
+}
+
+/**
+ * @brief Clasifica una trama binarizada y elige los sensores de la línea
+ * Separa los sensores sobre el umbral en grupos contiguos; el de la línea es el más cercano a la
+ * última posición y el resto son marcas a su izquierda o derecha. En cruces y líneas anchas la
+ * posición no es fiable: line queda a 0 para que se mantenga la última, como mucho
+ * MARKERS_HOLD_MAX_MS seguidos. Cada trama nueva avanza la histéresis de los eventos
+ *
+ * @param detected Bit i a 1 si el sensor i está sobre el umbral (sensor 0 a la izquierda)
+ * @param last_position Última posición (-SENSORS_POSITION_MAX a SENSORS_POSITION_MAX)
+ * @param frame_us Instante de la trama (una misma trama solo cuenta una vez)
+ * @param line Sensores que se usan para la posición (0 = mantener la última posición)
+ * @return MARKER_TYPES Patrón de la trama, sin histéresis
+ */
+MARKER_TYPES markers_classify(uint16_t detected, int last_position, unsigned long frame_us, uint16_t *line) {
+  if (frame_us == last_frame_us) {
+    *line = last_line;
+    return last_type;
+  }
+  last_frame_us = frame_us;
+
+  // Grupos de sensores contiguos: el de la línea es el de centro más cercano al esperado
+  // (en medios sensores: 0 = sensor 0, 2 * (SENSORS_COUNT - 1) = último sensor)
+  int expected = (last_position + SENSORS_POSITION_MAX) * (SENSORS_COUNT - 1) / SENSORS_POSITION_MAX;
+  int count = 0;
+  int groups = 0;
+  int line_first = -1;
+  int line_last = -1;
+  int sensor = 0;
+  while (sensor < SENSORS_COUNT) {
+    if (!(detected & (1 << sensor))) {
+      sensor++;
+      continue;
+    }
+    int first = sensor;
+    while (sensor < SENSORS_COUNT && (detected & (1 << sensor))) {
+      sensor++;
+    }
+    int last = sensor - 1;
+    count += last - first + 1;
+    groups++;
+    if (line_first < 0 || abs(first + last - expected) < abs(line_first + line_last - expected)) {
+      line_first = first;
+      line_last = last;
+    }
+  }
+
+  MARKER_TYPES type = MARKER_NONE;
+  uint16_t line_mask = detected;
+  if (count >= MARKERS_CROSSING_SENSORS) {
+    type = MARKER_CROSSING;
+  } else if (groups > 1) {
+    line_mask = (uint16_t)(((1 << (line_last + 1)) - 1) & ~((1 << line_first) - 1));
+    bool left = (detected & ((1 << line_first) - 1)) != 0;
+    bool right = (detected & ~((1 << (line_last + 1)) - 1)) != 0;
+    type = left && right ? MARKER_CROSSING : (left ? MARKER_LEFT : MARKER_RIGHT);
+  } else if (groups == 1 && line_last - line_first + 1 > MARKERS_LINE_MAX_SENSORS) {
+    type = MARKER_WIDE;
+  }
+  update_events(type, frame_us);
+
+  // Protección de la posición en cruces y líneas anchas, limitada en el tiempo
+  if (type == MARKER_CROSSING || type == MARKER_WIDE) {
+    if (!holding) {
+      holding = true;
+      hold_start_us = frame_us;
+    }
+    line_mask = frame_us - hold_start_us < MARKERS_HOLD_MAX_MS * 1000UL ? 0 : detected;
+  } else {
+    holding = false;
+  }
+
+  last_type = type;
+  last_line = line_mask;
+  *line = line_mask;
+  return type;
+}
+
+/**
+ * @brief Saca el evento más antiguo de la cola
+ *
+ * @param event Evento leído
+ * @return true Había un evento
+ * @return false Cola vacía
+ */
+bool markers_pop_event(marker_event_t *event) {
+  uint32_t tail = queue_tail;
+  if (tail == queue_head) {
+    return false;
+  }
+  *event = marker_queue[tail & (MARKERS_QUEUE_SIZE - 1)];
+  queue_tail = tail + 1;
+  return true;
+}
+
+/**
+ * @brief Obtiene el evento activo (tras la histéresis)
+ *
+ * @return MARKER_TYPES Evento en curso o MARKER_NONE
+ */
+MARKER_TYPES get_marker_active() {
+  return active_type;
+}
+
+/**
+ * @brief Obtiene cuántos eventos de un tipo se detectaron desde el inicio de la carrera
+ *
+ * @param type Tipo de evento
+ * @return unsigned long Número de eventos
+ */
+unsigned long get_marker_count(MARKER_TYPES type) {
+  if (type < 0 || type >= MARKER_TYPES_COUNT) {
+    return 0;
+  }
+  return marker_counts[type];
+}
+
+/**
+ * @brief Copia del estado de las marcas (para que benchmark_control lo deje como estaba)
+ *
+ * @param saved Estado actual
+ */
+void get_markers_state(markers_state_t *saved) {
+  saved->last_frame_us = last_frame_us;
+  saved->last_type = last_type;
+  saved->last_line = last_line;
+  saved->hold_start_us = hold_start_us;
+  saved->holding = holding;
+  saved->candidate_type = candidate_type;
+  saved->candidate_frames = candidate_frames;
+  saved->candidate_us = candidate_us;
+  saved->active_type = active_type;
+  saved->release_frames = release_frames;
+  saved->queue_head = queue_head;
+  for (int type = 0; type < MARKER_TYPES_COUNT; type++) {
+    saved->counts[type] = marker_counts[type];
+  }
+}
+
+void set_markers_state(const markers_state_t *saved) {
+  last_frame_us = saved->last_frame_us;
+  last_type = saved->last_type;
+  last_line = saved->last_line;
+  hold_start_us = saved->hold_start_us;
+  holding = saved->holding;
+  candidate_type = saved->candidate_type;
+  candidate_frames = saved->candidate_frames;
+  candidate_us = saved->candidate_us;
+  active_type = saved->active_type;
+  release_frames = saved->release_frames;
+  queue_head = saved->queue_head;
+  for (int type = 0; type < MARKER_TYPES_COUNT; type++) {
+    marker_counts[type] = saved->counts[type];
+  }
+}
+
+/**
+ * @brief Imprime los eventos detectados en la carrera
+ *
+ */
+void print_markers() {
+  Serial.print("Marcas: activa ");
+  Serial.println(marker_names[active_type]);
+  for (int type = MARKER_LEFT; type < MARKER_TYPES_COUNT; type++) {
+    Serial.print("  ");
+    Serial.print(marker_names[type]);
+    Serial.print(": ");
+    Serial.println(marker_counts[type]);
+  }
+}
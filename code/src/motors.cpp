@@ -1,5 +1,79 @@
 #include <motors.h>
-#include <control.h>
+#include <hal.h>
+
+/**
+ * @brief Tabla de conversión velocidad (0-100%) a ciclo de trabajo PWM
+ * Evita la multiplicación y división en punto flotante en cada ciclo de control
+ *
+ */
+static uint16_t motors_duty_lut[101];
+
+/**
+ * @brief Configuración actual del PWM de los motores (frecuencia, resolución y ciclo máximo)
+ *
+ */
+static int motors_pwm_hz = PWM_MOTORS_HZ;
+static int motors_pwm_resolution = PWM_MOTORS_RESOLUTION;
+static uint32_t motors_pwm_max = PWM_MOTORS_MAX;
+
+static volatile enum MOTORS_DECAY_MODES motors_decay_mode = MOTORS_DECAY_SLOW;
+
+static unsigned long fan_arming_start_ms = 0;
+static bool fan_armed = false;
+
+static const int motors_channels[4] = {PWM_MOTOR_LEFT_A, PWM_MOTOR_LEFT_B, PWM_MOTOR_RIGHT_A, PWM_MOTOR_RIGHT_B};
+
+/**
+ * @brief Último ciclo de trabajo escrito en cada canal (motores y turbina)
+ * Solo se escriben al periférico los canales que cambian
+ *
+ */
+static uint32_t motors_duty_cache[4] = {PWM_MOTORS_MIN, PWM_MOTORS_MIN, PWM_MOTORS_MIN, PWM_MOTORS_MIN};
+#if FAN_PROTOCOL
+/**
+ * @brief Estado de la turbina por DShot
+ * set_fan_throttle solo guarda el mando; update_fan lo envía en cada ciclo de control y
+ * recoge la respuesta del ESC a la trama anterior (RPM, -1 sin telemetría)
+ *
+ */
+static volatile uint16_t fan_throttle = 0;
+static volatile long fan_rpm = -1;
+static bool fan_dshot_ready = false;
+#else
+static uint32_t fan_duty_cache = PWM_FAN_MIN;
+#endif
+
+/**
+ * @brief Motores habilitados; lo mantiene la tarea de control según el estado de la carrera
+ * (en carrera, en pre-inicio o durante el frenado tras detenerse)
+ *
+ */
+static volatile bool motors_enabled = false;
+
+/**
+ * @brief Configura los cuatro canales de los motores con la frecuencia y resolución actuales
+ * Los deja en el mismo timer, detenidos, y recalcula la tabla de ciclos de trabajo
+ *
+ */
+static void setup_motors_pwm() {
+  hal_pwm_setup(PWM_MOTOR_LEFT_A, motors_pwm_hz, motors_pwm_resolution, MOTOR_LEFT_A);
+  hal_pwm_setup(PWM_MOTOR_LEFT_B, motors_pwm_hz, motors_pwm_resolution, MOTOR_LEFT_B);
+  hal_pwm_setup(PWM_MOTOR_RIGHT_A, motors_pwm_hz, motors_pwm_resolution, MOTOR_RIGHT_A);
+  hal_pwm_setup(PWM_MOTOR_RIGHT_B, motors_pwm_hz, motors_pwm_resolution, MOTOR_RIGHT_B);
+
+  // Los cuatro canales de los motores en el mismo timer: los cambios se aplican en el mismo periodo
+  hal_pwm_sync_channels(motors_channels, 4);
+
+  for (int i = 0; i < 4; i++) {
+    hal_pwm_write(motors_channels[i], PWM_MOTORS_MIN);
+    motors_duty_cache[i] = PWM_MOTORS_MIN;
+  }
+
+  motors_pwm_max = (1UL << motors_pwm_resolution) - 1;
+  for (int pct = 0; pct <= 100; pct++) {
+    motors_duty_lut[pct] = (motors_pwm_max * pct) / 100;
+  }
+}
 
 /**
  * @brief Inicializa los motores configurando los canales PWM
@@ -7,34 +81,131 @@
  */
 void init_motors() {
   // Configuración de los canales PWM del Timer - Motores
-  ledcSetup(PWM_MOTOR_LEFT_A, PWM_MOTORS_HZ, PWM_MOTORS_RESOLUTION);
-  ledcSetup(PWM_MOTOR_LEFT_B, PWM_MOTORS_HZ, PWM_MOTORS_RESOLUTION);
-  ledcSetup(PWM_MOTOR_RIGHT_A, PWM_MOTORS_HZ, PWM_MOTORS_RESOLUTION);
-  ledcSetup(PWM_MOTOR_RIGHT_B, PWM_MOTORS_HZ, PWM_MOTORS_RESOLUTION);
+  setup_motors_pwm();
 
+#if FAN_PROTOCOL
+  // ESC de turbina por DShot: las tramas las envía update_fan desde la tarea de control
+  fan_dshot_ready = hal_dshot_start(FAN_PIN, FAN_PROTOCOL, FAN_DSHOT_BIDIRECTIONAL);
+  if (!fan_dshot_ready) {
+    Serial.println("ERROR: no se pudo iniciar DShot en el RMT");
+  }
+#else
   // Configuración del canal PWM para ESC de turbina (50Hz = protocolo servo)
-  ledcSetup(PWM_FAN, PWM_FAN_HZ, PWM_FAN_RESOLUTION);
+  hal_pwm_setup(PWM_FAN, PWM_FAN_HZ, PWM_FAN_RESOLUTION, FAN_PIN);
+  hal_pwm_write(PWM_FAN, PWM_FAN_MIN);
+#endif
+
+  // El ESC necesita 2-3 segundos con la señal mínima para armarse
+  // No se espera aquí: el armado transcurre en paralelo con el resto del arranque
+  fan_arming_start_ms = hal_millis();
+  fan_armed = false;
+  Serial.println("Armando ESC de turbina en segundo plano...");
+}
+
+/**
+ * @brief Comprueba si el ESC de la turbina ya terminó de armarse
+ *
+ * @return true ESC armado, acepta órdenes de velocidad
+ * @return false Todavía en armado (señal mínima)
+ */
+bool is_fan_armed() {
+  if (!fan_armed && hal_millis() - fan_arming_start_ms >= FAN_ARMING_MS) {
+    fan_armed = true;
+  }
+  return fan_armed;
+}
+
+/**
+ * @brief Habilita o deshabilita los motores de tracción
+ * Deshabilitados, cualquier velocidad se aplica como detenido
+ *
+ * @param enabled true para permitir movimiento
+ */
+void set_motors_enabled(bool enabled) {
+  motors_enabled = enabled;
+}
 
-  // Asignación de los pines a los canales PWM
-  ledcAttachPin(MOTOR_LEFT_A, PWM_MOTOR_LEFT_A);
-  ledcAttachPin(MOTOR_LEFT_B, PWM_MOTOR_LEFT_B);
-  ledcAttachPin(MOTOR_RIGHT_A, PWM_MOTOR_RIGHT_A);
-  ledcAttachPin(MOTOR_RIGHT_B, PWM_MOTOR_RIGHT_B);
-  ledcAttachPin(FAN_PIN, PWM_FAN);
+/**
+ * @brief Comprueba si los motores de tracción están habilitados
+ *
+ * @return true Se aplican las velocidades pedidas
+ * @return false Los motores quedan detenidos
+ */
+bool are_motors_enabled() {
+  return motors_enabled;
+}
+
+/**
+ * @brief Etapa de salida de los motores
+ * Compara con la caché y solo escribe los canales que cambian, todos en una misma ráfaga
+ * para que se apliquen juntos en el siguiente periodo del PWM
+ *
+ * @param left_a Ciclo de trabajo de MOTOR_LEFT_A
+ * @param left_b Ciclo de trabajo de MOTOR_LEFT_B
+ * @param right_a Ciclo de trabajo de MOTOR_RIGHT_A
+ * @param right_b Ciclo de trabajo de MOTOR_RIGHT_B
+ */
+static void write_motors_duty(uint32_t left_a, uint32_t left_b, uint32_t right_a, uint32_t right_b) {
+  const uint32_t duties[4] = {left_a, left_b, right_a, right_b};
+  int channels[4];
+  uint32_t changed[4];
+  int count = 0;
+  for (int i = 0; i < 4; i++) {
+    if (duties[i] != motors_duty_cache[i]) {
+      motors_duty_cache[i] = duties[i];
+      channels[count] = motors_channels[i];
+      changed[count] = duties[i];
+      count++;
+    }
+  }
+  if (count > 0) {
+    hal_pwm_write_sync(channels, changed, count);
+  }
+}
 
-  // Establece el valor inicial de los canales PWM
-  ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MIN);
-  ledcWrite(PWM_FAN, PWM_FAN_MIN);
+/**
+ * @brief Ciclos de trabajo de las entradas A y B del driver RZ7886 para una velocidad
+ * Decaimiento lento (marcha/freno):
+ * - Para avanzar: A=MAX, B=MAX-duty
+ * - Para retroceder: A=MAX-duty, B=MAX
+ * Decaimiento rápido (marcha/rueda libre):
+ * - Para avanzar: A=duty, B=MIN
+ * - Para retroceder: A=MIN, B=duty
+ * Detenido: A=MIN, B=MIN
+ *
+ * @param duty Ciclo de trabajo de la velocidad (0 a motors_pwm_max)
+ * @param reverse true para retroceder
+ * @param duty_a Ciclo de trabajo de la entrada A
+ * @param duty_b Ciclo de trabajo de la entrada B
+ */
+static inline void motor_duty(uint32_t duty, bool reverse, uint32_t *duty_a, uint32_t *duty_b) {
+  if (duty == 0) {
+    *duty_a = PWM_MOTORS_MIN;
+    *duty_b = PWM_MOTORS_MIN;
+  } else if (motors_decay_mode == MOTORS_DECAY_FAST) {
+    *duty_a = reverse ? PWM_MOTORS_MIN : duty;
+    *duty_b = reverse ? duty : PWM_MOTORS_MIN;
+  } else if (reverse) {
+    *duty_a = motors_pwm_max - duty;
+    *duty_b = motors_pwm_max;
+  } else {
+    *duty_a = motors_pwm_max;
+    *duty_b = motors_pwm_max - duty;
+  }
+}
 
-  // Tiempo de espera para inicialización del ESC
-  // El ESC necesita 2-3 segundos para calibrar
-  // Este delay se puede quitar si ya se espera durante la calibración de sensores
-  Serial.println("Inicializando ESC de turbina...");
-  delay(2000);
-  Serial.println("ESC listo");
+/**
+ * @brief Ciclos de trabajo de las entradas A y B para frenar con una intensidad dada
+ * Los dos canales comparten timer y fase: durante duty ambos están en alto (freno, el motor en
+ * cortocircuito) y el resto del periodo ambos en bajo (rueda libre)
+ *
+ * @param duty Ciclo de trabajo del freno (0 a motors_pwm_max)
+ * @param duty_a Ciclo de trabajo de la entrada A
+ * @param duty_b Ciclo de trabajo de la entrada B
+ */
+static inline void brake_duty(uint32_t duty, uint32_t *duty_a, uint32_t *duty_b) {
+  *duty_a = duty;
+  *duty_b = duty;
 }
 
 /**
@@ -51,82 +222,330 @@ void init_motors() {
  * @param velD Velocidad del motor derecho (-100 a 100%)
  */
 void set_motors_speed(float velI, float velD) {
+  // Solo permitir movimiento si está en carrera, pre-inicio, o recién detenido (freno gradual)
+  if (!motors_enabled) {
+    velI = 0;
+    velD = 0;
+  }
+
+  uint32_t duties[4];
+  get_motors_speed_duties(velI, velD, duties);
+  write_motors_duty(duties[0], duties[1], duties[2], duties[3]);
+}
+
+/**
+ * @brief Ciclos de trabajo de set_motors_speed, sin escribirlos en el PWM
+ * benchmark_control mide así la conversión con los motores deshabilitados
+ *
+ * @param velI Velocidad del motor izquierdo (-100 a 100%)
+ * @param velD Velocidad del motor derecho (-100 a 100%)
+ * @param duties MOTOR_LEFT_A, MOTOR_LEFT_B, MOTOR_RIGHT_A y MOTOR_RIGHT_B
+ */
+void get_motors_speed_duties(float velI, float velD, uint32_t *duties) {
   // Limitar velocidades
   velI = constrain(velI, -100, 100);
   velD = constrain(velD, -100, 100);
 
+  motor_duty(motors_pwm_max * fabsf(velI) / 100, velI < 0, &duties[0], &duties[1]);
+  motor_duty(motors_pwm_max * fabsf(velD) / 100, velD < 0, &duties[2], &duties[3]);
+}
+
+/**
+ * @brief Establece la velocidad de los motores con valores enteros (ruta de punto fijo)
+ * Misma lógica que set_motors_speed pero sin operaciones en punto flotante
+ *
+ * @param velI Velocidad del motor izquierdo (-100 a 100%)
+ * @param velD Velocidad del motor derecho (-100 a 100%)
+ */
+void set_motors_speed_pct(int velI, int velD) {
   // Solo permitir movimiento si está en carrera, pre-inicio, o recién detenido (freno gradual)
-  bool motors_enabled = is_race_started() || is_race_starting() || (millis() - get_race_stopped_ms() < 1000);
+  if (!motors_enabled) {
+    velI = 0;
+    velD = 0;
+  }
 
-  // Motor Izquierdo
-  if (motors_enabled) {
-    if (velI > 0) {
-      // Adelante
-      ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MAX);
-      ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MAX - (PWM_MOTORS_MAX * velI / 100));
-    } else if (velI < 0) {
-      // Reversa
-      ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MAX - (PWM_MOTORS_MAX * abs(velI) / 100));
-      ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MAX);
-    } else {
-      // Detenido
-      ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MIN);
-      ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MIN);
-    }
+  uint32_t duties[4];
+  get_motors_speed_pct_duties(velI, velD, duties);
+  write_motors_duty(duties[0], duties[1], duties[2], duties[3]);
+}
+
+/**
+ * @brief Ciclos de trabajo de set_motors_speed_pct, sin escribirlos en el PWM
+ *
+ * @param velI Velocidad del motor izquierdo (-100 a 100%)
+ * @param velD Velocidad del motor derecho (-100 a 100%)
+ * @param duties MOTOR_LEFT_A, MOTOR_LEFT_B, MOTOR_RIGHT_A y MOTOR_RIGHT_B
+ */
+void get_motors_speed_pct_duties(int velI, int velD, uint32_t *duties) {
+  velI = constrain(velI, -100, 100);
+  velD = constrain(velD, -100, 100);
+
+  motor_duty(motors_duty_lut[abs(velI)], velI < 0, &duties[0], &duties[1]);
+  motor_duty(motors_duty_lut[abs(velD)], velD < 0, &duties[2], &duties[3]);
+}
+
+/**
+ * @brief Establece el par de los motores con signo en el sentido de avance
+ * Los valores positivos avanzan con el modo de decaimiento actual; los negativos frenan
+ * (A=HIGH, B=HIGH) con intensidad proporcional, en vez de invertir el giro como
+ * set_motors_speed_pct. Así el control puede decelerar con fuerza sin esperar al rozamiento.
+ *
+ * @param torqueI Par del motor izquierdo (-100 freno máximo a 100 avance máximo)
+ * @param torqueD Par del motor derecho (-100 freno máximo a 100 avance máximo)
+ */
+void set_motors_torque(int torqueI, int torqueD) {
+  if (!motors_enabled) {
+    torqueI = 0;
+    torqueD = 0;
+  }
+
+  torqueI = constrain(torqueI, -100, 100);
+  torqueD = constrain(torqueD, -100, 100);
+
+  uint32_t left_a, left_b, right_a, right_b;
+  if (torqueI < 0) {
+    brake_duty(motors_duty_lut[-torqueI], &left_a, &left_b);
   } else {
-    // Motores deshabilitados
-    ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MIN);
-    ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MIN);
+    motor_duty(motors_duty_lut[torqueI], false, &left_a, &left_b);
   }
+  if (torqueD < 0) {
+    brake_duty(motors_duty_lut[-torqueD], &right_a, &right_b);
+  } else {
+    motor_duty(motors_duty_lut[torqueD], false, &right_a, &right_b);
+  }
+  write_motors_duty(left_a, left_b, right_a, right_b);
+}
+
+/**
+ * @brief Frena ambos motores
+ *
+ * @param strength Intensidad del freno (0 rueda libre a 100 freno total)
+ */
+void brake_motors(int strength) {
+  strength = constrain(strength, 0, 100);
+  set_motors_torque(-strength, -strength);
+}
 
-  // Motor Derecho
+/**
+ * @brief Selecciona el modo de decaimiento de la corriente de los motores
+ * Se aplica en la siguiente escritura de velocidad
+ *
+ * @param mode MOTORS_DECAY_SLOW o MOTORS_DECAY_FAST
+ */
+void set_motors_decay_mode(enum MOTORS_DECAY_MODES mode) {
+  motors_decay_mode = mode;
+}
+
+enum MOTORS_DECAY_MODES get_motors_decay_mode() {
+  return motors_decay_mode;
+}
+
+/**
+ * @brief Cambia la frecuencia y la resolución del PWM de los motores
+ * Reconfigura el timer de los motores, así que solo se permite con los motores deshabilitados
+ *
+ * @param frequency_hz Frecuencia (PWM_MOTORS_MIN_HZ a PWM_MOTORS_MAX_HZ)
+ * @param resolution_bits Resolución (PWM_MOTORS_MIN_RESOLUTION a PWM_MOTORS_MAX_RESOLUTION)
+ * @return true Configuración aplicada
+ * @return false Valores fuera de rango, combinación no alcanzable o motores en marcha
+ */
+bool set_motors_pwm(int frequency_hz, int resolution_bits) {
   if (motors_enabled) {
-    if (velD > 0) {
-      // Adelante
-      ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MAX);
-      ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MAX - (PWM_MOTORS_MAX * velD / 100));
-    } else if (velD < 0) {
-      // Reversa
-      ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MAX - (PWM_MOTORS_MAX * abs(velD) / 100));
-      ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MAX);
-    } else {
-      // Detenido
-      ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MIN);
-      ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MIN);
-    }
-  } else {
-    // Motores deshabilitados
-    ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MIN);
-    ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MIN);
+    return false;
+  }
+  if (frequency_hz < PWM_MOTORS_MIN_HZ || frequency_hz > PWM_MOTORS_MAX_HZ ||
+      resolution_bits < PWM_MOTORS_MIN_RESOLUTION || resolution_bits > PWM_MOTORS_MAX_RESOLUTION) {
+    return false;
+  }
+  if ((unsigned long)frequency_hz << resolution_bits > PWM_MOTORS_CLOCK_HZ) {
+    return false;
   }
+  motors_pwm_hz = frequency_hz;
+  motors_pwm_resolution = resolution_bits;
+  setup_motors_pwm();
+  return true;
+}
+
+int get_motors_pwm_hz() {
+  return motors_pwm_hz;
+}
+
+int get_motors_pwm_resolution() {
+  return motors_pwm_resolution;
 }
 
 /**
- * @brief Establece la velocidad de la turbina/succión usando protocolo ESC
- * Protocolo servo: 1000μs = apagado, 2000μs = máximo
+ * @brief Establece la velocidad de la turbina/succión
  *
  * @param vel Velocidad de la turbina (0-100%)
  */
 void set_fan_speed(int vel) {
   vel = constrain(vel, 0, 100);
-  if (vel != 0) {
-    // Mapear 0-100% a rango 102-204 (1000μs a 2000μs)
-    int pwm_value = map(vel, 0, 100, PWM_FAN_MIN, PWM_FAN_MAX);
-    ledcWrite(PWM_FAN, pwm_value);
-  } else {
-    // Apagar turbina
-    ledcWrite(PWM_FAN, PWM_FAN_MIN);
+  set_fan_throttle(vel * FAN_THROTTLE_MAX / 100);
+}
+
+/**
+ * @brief Establece el mando de la turbina con la resolución completa del protocolo
+ * PWM de servo: 1000μs = apagado, 2000μs = máximo (se escribe al momento)
+ * DShot: se envía en el siguiente ciclo de control (update_fan)
+ * Mientras el ESC se arma se mantiene la señal mínima
+ *
+ * @param throttle Mando de la turbina (0 a FAN_THROTTLE_MAX)
+ */
+void set_fan_throttle(int throttle) {
+  throttle = constrain(throttle, 0, FAN_THROTTLE_MAX);
+  if (!is_fan_armed()) {
+    throttle = 0;
+  }
+#if FAN_PROTOCOL
+  fan_throttle = throttle;
+#else
+  uint32_t pwm_value = PWM_FAN_MIN;
+  if (throttle != 0) {
+    // Mapear 0-FAN_THROTTLE_MAX a rango 102-204 (1000μs a 2000μs)
+    pwm_value = map(throttle, 0, FAN_THROTTLE_MAX, PWM_FAN_MIN, PWM_FAN_MAX);
+  }
+  if (pwm_value != fan_duty_cache) {
+    fan_duty_cache = pwm_value;
+    hal_pwm_write(PWM_FAN, pwm_value);
+  }
+#endif
+}
+
+#if FAN_PROTOCOL
+/**
+ * @brief Trama DShot: 11 bits de valor, bit de telemetría y CRC de 4 bits
+ * En modo bidireccional el CRC va invertido (así el ESC sabe que debe responder)
+ *
+ * @param value Valor (0 = parado, 48-2047 = mando)
+ * @return uint16_t Trama a enviar
+ */
+uint16_t dshot_frame(uint16_t value) {
+  uint16_t packet = value << 1;
+  uint16_t crc = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+  if (FAN_DSHOT_BIDIRECTIONAL) {
+    crc = ~crc & 0x0F;
+  }
+  return (packet << 4) | crc;
+}
+
+/**
+ * @brief Decodifica la respuesta del ESC en DShot bidireccional
+ * Los 21 niveles codifican 20 bits GCR como cambios de nivel; cada 5 bits GCR son 4 bits del
+ * valor eeem mmmm mmmm cccc: periodo eléctrico en μs = m << e y CRC de 4 bits
+ *
+ * @param levels Niveles de la línea (21 bits, el primero en el bit 20)
+ * @param erpm RPM eléctricas (0 si el motor está parado)
+ * @return true Respuesta válida
+ * @return false Código GCR o CRC no válidos
+ */
+bool dshot_decode_erpm(uint32_t levels, uint32_t *erpm) {
+  static const int8_t gcr_nibbles[32] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, 10, 11, -1, 13, 14, 15,
+    -1, -1, 2, 3, -1, 5, 6, 7, -1, 0, 8, 1, -1, 4, 12, -1,
+  };
+
+  uint32_t gcr = (levels ^ (levels >> 1)) & 0xFFFFF;
+  uint16_t value = 0;
+  for (int nibble = 3; nibble >= 0; nibble--) {
+    int decoded = gcr_nibbles[(gcr >> (nibble * 5)) & 0x1F];
+    if (decoded < 0) {
+      return false;
+    }
+    value |= decoded << (nibble * 4);
+  }
+
+  uint16_t crc = value ^ (value >> 4) ^ (value >> 8) ^ (value >> 12);
+  if ((crc & 0x0F) != 0x0F) {
+    return false;
+  }
+
+  value >>= 4;
+  if (value == 0x0FFF) {
+    *erpm = 0;
+    return true;
+  }
+  uint32_t period_us = (uint32_t)(value & 0x01FF) << (value >> 9);
+  *erpm = period_us > 0 ? 60000000UL / period_us : 0;
+  return true;
+}
+#endif
+
+/**
+ * @brief Envía el mando de la turbina y recoge su telemetría (desde la tarea de control)
+ * DShot necesita un flujo continuo de tramas: se llama en cada ciclo, haya carrera o no
+ * En PWM de servo no hace nada (el LEDC repite la señal por sí solo)
+ *
+ */
+void update_fan() {
+#if FAN_PROTOCOL
+  if (!fan_dshot_ready) {
+    return;
+  }
+  uint32_t levels;
+  uint32_t erpm;
+  if (FAN_DSHOT_BIDIRECTIONAL && hal_dshot_read_response(&levels) && dshot_decode_erpm(levels, &erpm)) {
+    fan_rpm = erpm / (FAN_MOTOR_POLES / 2);
+  }
+  uint16_t throttle = fan_throttle;
+  hal_dshot_write(dshot_frame(throttle == 0 ? 0 : DSHOT_THROTTLE_MIN - 1 + throttle));
+#endif
+}
+
+/**
+ * @brief Obtiene las RPM de la turbina según la telemetría del ESC
+ *
+ * @return long RPM mecánicas, -1 si el protocolo no las proporciona
+ */
+long get_fan_rpm() {
+#if FAN_PROTOCOL
+  return fan_rpm;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * @brief Imprime el protocolo, el mando y la telemetría de la turbina
+ *
+ */
+void print_fan_status() {
+#if FAN_PROTOCOL
+  Serial.print("Turbina: DShot");
+  Serial.print(FAN_PROTOCOL);
+  Serial.print(FAN_DSHOT_BIDIRECTIONAL ? " bidireccional" : "");
+  Serial.print(", mando ");
+  Serial.print(fan_throttle);
+#else
+  Serial.print("Turbina: PWM de servo, ciclo ");
+  Serial.print(fan_duty_cache);
+#endif
+  Serial.print(is_fan_armed() ? ", armada" : ", armando");
+  long rpm = get_fan_rpm();
+  if (rpm >= 0) {
+    Serial.print(", ");
+    Serial.print(rpm);
+    Serial.print(" RPM");
   }
+  Serial.println();
 }
 
 /**
  * @brief Detiene ambos motores y la turbina
+ * Escribe siempre todos los canales (sin comparar con la caché) para que la parada
+ * no dependa de escrituras concurrentes desde otra tarea
  *
  */
 void stop_motors() {
-  ledcWrite(PWM_MOTOR_LEFT_A, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_LEFT_B, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_RIGHT_A, PWM_MOTORS_MIN);
-  ledcWrite(PWM_MOTOR_RIGHT_B, PWM_MOTORS_MIN);
-  ledcWrite(PWM_FAN, PWM_FAN_MIN);
+  for (int i = 0; i < 4; i++) {
+    motors_duty_cache[i] = PWM_MOTORS_MIN;
+  }
+  const uint32_t duties[4] = {PWM_MOTORS_MIN, PWM_MOTORS_MIN, PWM_MOTORS_MIN, PWM_MOTORS_MIN};
+  hal_pwm_write_sync(motors_channels, duties, 4);
+#if FAN_PROTOCOL
+  fan_throttle = 0;
+#else
+  fan_duty_cache = PWM_FAN_MIN;
+  hal_pwm_write(PWM_FAN, PWM_FAN_MIN);
+#endif
 }
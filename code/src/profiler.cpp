@@ -0,0 +1,276 @@
+#include <profiler.h>
+
+#if PROFILER_ENABLED
+
+/**
+ * @brief Estadísticas de una magnitud: mínimo, máximo, suma e histograma logarítmico
+ *
+ */
+struct profiler_stats_t {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[PROFILER_BUCKETS];
+};
+
+static const char *stage_names[STAGE_COUNT] = {
+  "Adquisicion", "Posicion", "PID", "Motores", "Telemetria", "Ciclo"
+};
+
+static profiler_stats_t stage_stats[STAGE_COUNT];
+static profiler_stats_t period_stats;
+static uint32_t jitter_bins[PROFILER_JITTER_BINS];
+static int32_t jitter_min_us = 0;
+static int32_t jitter_max_us = 0;
+
+static uint32_t deadline_misses = 0;
+static uint32_t missed_ticks = 0;
+
+static uint32_t loop_start_cycles = 0;
+static uint32_t last_loop_start_cycles = 0;
+static unsigned long loop_period_us = 0;
+static bool loop_started = false;
+static uint32_t cycles_per_us = 240;
+static volatile bool reset_pending = true;
+
+/**
+ * @brief Índice del histograma logarítmico para un valor
+ * Octava = bit más significativo; subdivisión = los PROFILER_SUB_BITS bits siguientes
+ *
+ * @param value Valor a clasificar
+ * @return int Índice de la barra
+ */
+static int stats_bucket(uint32_t value) {
+  if (value < (1UL << PROFILER_SUB_BITS)) {
+    return value;
+  }
+  int msb = 31 - __builtin_clz(value);
+  int sub = (value >> (msb - PROFILER_SUB_BITS)) & ((1 << PROFILER_SUB_BITS) - 1);
+  return ((msb - PROFILER_SUB_BITS + 1) << PROFILER_SUB_BITS) | sub;
+}
+
+/**
+ * @brief Límite superior de los valores de una barra del histograma
+ *
+ * @param bucket Índice de la barra
+ * @return uint32_t Valor máximo de la barra
+ */
+static uint32_t stats_bucket_limit(int bucket) {
+  if (bucket < (1 << PROFILER_SUB_BITS)) {
+    return bucket;
+  }
+  int msb = (bucket >> PROFILER_SUB_BITS) + PROFILER_SUB_BITS - 1;
+  int sub = bucket & ((1 << PROFILER_SUB_BITS) - 1);
+  uint64_t low = (1ULL << msb) | ((uint64_t)sub << (msb - PROFILER_SUB_BITS));
+  return low + (1ULL << (msb - PROFILER_SUB_BITS)) - 1;
+}
+
+static void stats_reset(profiler_stats_t *stats) {
+  memset(stats, 0, sizeof(profiler_stats_t));
+  stats->min = UINT32_MAX;
+}
+
+static void stats_add(profiler_stats_t *stats, uint32_t value) {
+  stats->count++;
+  stats->sum += value;
+  if (value < stats->min) {
+    stats->min = value;
+  }
+  if (value > stats->max) {
+    stats->max = value;
+  }
+  stats->buckets[stats_bucket(value)]++;
+}
+
+/**
+ * @brief Percentil aproximado a partir del histograma
+ *
+ * @param stats Estadísticas
+ * @param percentile Percentil (0-100)
+ * @return uint32_t Límite superior de la barra que contiene el percentil
+ */
+static uint32_t stats_percentile(const profiler_stats_t *stats, int percentile) {
+  uint64_t target = ((uint64_t)stats->count * percentile + 99) / 100;
+  uint64_t accumulated = 0;
+  for (int bucket = 0; bucket < PROFILER_BUCKETS; bucket++) {
+    accumulated += stats->buckets[bucket];
+    if (accumulated >= target) {
+      return min(stats_bucket_limit(bucket), stats->max);
+    }
+  }
+  return stats->max;
+}
+
+/**
+ * @brief Reinicia todas las estadísticas (solo desde la tarea de control)
+ *
+ */
+static void apply_reset() {
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    stats_reset(&stage_stats[stage]);
+  }
+  stats_reset(&period_stats);
+  memset(jitter_bins, 0, sizeof(jitter_bins));
+  jitter_min_us = 0;
+  jitter_max_us = 0;
+  deadline_misses = 0;
+  missed_ticks = 0;
+  loop_started = false;
+  cycles_per_us = hal_cycles_per_us();
+  reset_pending = false;
+}
+
+/**
+ * @brief Registra la duración de una etapa
+ *
+ * @param stage Etapa medida
+ * @param cycles Ciclos de CPU de la etapa
+ */
+void profiler_record(PROFILER_STAGES stage, uint32_t cycles) {
+  stats_add(&stage_stats[stage], cycles);
+}
+
+/**
+ * @brief Marca el inicio de un ciclo de control: mide el periodo real y su jitter
+ *
+ * @param period_us Periodo nominal del bucle en μs
+ * @param ticks Notificaciones del temporizador acumuladas (más de 1 = ciclos perdidos)
+ */
+void profiler_loop_start(unsigned long period_us, uint32_t ticks) {
+  if (reset_pending) {
+    apply_reset();
+  }
+
+  loop_start_cycles = hal_cycles();
+  loop_period_us = period_us;
+  if (ticks > 1) {
+    missed_ticks += ticks - 1;
+  }
+
+  if (loop_started) {
+    uint32_t measured_us = (loop_start_cycles - last_loop_start_cycles) / cycles_per_us;
+    int32_t jitter_us = (int32_t)measured_us - (int32_t)period_us;
+    stats_add(&period_stats, measured_us);
+    jitter_min_us = min(jitter_min_us, jitter_us);
+    jitter_max_us = max(jitter_max_us, jitter_us);
+    int bin = constrain(jitter_us + PROFILER_JITTER_BINS / 2, 0, PROFILER_JITTER_BINS - 1);
+    jitter_bins[bin]++;
+  }
+  last_loop_start_cycles = loop_start_cycles;
+  loop_started = true;
+}
+
+/**
+ * @brief Marca el final de un ciclo de control: registra su duración y si superó el periodo
+ *
+ */
+void profiler_loop_end() {
+  uint32_t cycles = hal_cycles() - loop_start_cycles;
+  stats_add(&stage_stats[STAGE_LOOP], cycles);
+  if (cycles / cycles_per_us >= loop_period_us) {
+    deadline_misses++;
+  }
+}
+
+/**
+ * @brief Imprime una fila de la tabla de estadísticas
+ *
+ */
+static void print_stats_row(const char *name, const profiler_stats_t *stats) {
+  Serial.print(name);
+  Serial.print("\t| ");
+  Serial.print(stats->count);
+  Serial.print("\t| ");
+  Serial.print(stats->count > 0 ? stats->min : 0);
+  Serial.print("\t| ");
+  Serial.print(stats->count > 0 ? (uint32_t)(stats->sum / stats->count) : 0);
+  Serial.print("\t| ");
+  Serial.print(stats->max);
+  Serial.print("\t| ");
+  Serial.println(stats_percentile(stats, 99));
+}
+
+/**
+ * @brief Imprime las estadísticas por etapa, el histograma de jitter y los plazos incumplidos
+ * Las estadísticas se leen mientras la tarea de control sigue escribiendo; pueden diferir
+ * en un ciclo entre columnas
+ *
+ */
+void print_profiler_stats() {
+  Serial.println("==============================================");
+  Serial.print("PERFIL DEL BUCLE DE CONTROL (ciclos a ");
+  Serial.print(hal_cycles_per_us());
+  Serial.println(" MHz)");
+  Serial.println("Etapa\t\t| n\t| min\t| media\t| max\t| p99");
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    print_stats_row(stage_names[stage], &stage_stats[stage]);
+  }
+  Serial.println();
+  Serial.println("Periodo (us)\t| n\t| min\t| media\t| max\t| p99");
+  print_stats_row("Periodo", &period_stats);
+
+  Serial.println();
+  Serial.print("Jitter: ");
+  Serial.print(jitter_min_us);
+  Serial.print(" a +");
+  Serial.print(jitter_max_us);
+  Serial.print(" us (nominal ");
+  Serial.print(loop_period_us);
+  Serial.println(" us)");
+  for (int bin = 0; bin < PROFILER_JITTER_BINS; bin++) {
+    if (jitter_bins[bin] > 0) {
+      int jitter_us = bin - PROFILER_JITTER_BINS / 2;
+      Serial.print(bin == 0 ? "  <=" : (bin == PROFILER_JITTER_BINS - 1 ? "  >=" : "    "));
+      Serial.print(jitter_us);
+      Serial.print(" us: ");
+      Serial.println(jitter_bins[bin]);
+    }
+  }
+
+  Serial.print("Plazos incumplidos (ciclo > periodo): ");
+  Serial.println(deadline_misses);
+  Serial.print("Ciclos perdidos (notificaciones acumuladas): ");
+  Serial.println(missed_ticks);
+  Serial.println("==============================================");
+}
+
+/**
+ * @brief Percentil de la duración de una etapa (mismo cálculo que la columna p99)
+ *
+ * @param stage Etapa
+ * @param percentile Percentil (0-100)
+ * @return uint32_t Ciclos, por exceso como mucho un 12.5% y nunca por encima del máximo
+ */
+uint32_t get_profiler_percentile(PROFILER_STAGES stage, int percentile) {
+  return stats_percentile(&stage_stats[stage], percentile);
+}
+
+/**
+ * @brief Pide reiniciar las estadísticas; se aplica al inicio del siguiente ciclo de control
+ *
+ */
+void reset_profiler_stats() {
+  reset_pending = true;
+  Serial.println("Estadisticas del perfilador reiniciadas");
+}
+
+#else
+
+void profiler_record(PROFILER_STAGES stage, uint32_t cycles) {}
+void profiler_loop_start(unsigned long period_us, uint32_t ticks) {}
+void profiler_loop_end() {}
+
+uint32_t get_profiler_percentile(PROFILER_STAGES stage, int percentile) {
+  return 0;
+}
+
+void print_profiler_stats() {
+  Serial.println("Perfilador deshabilitado (PROFILER_ENABLED = 0)");
+}
+
+void reset_profiler_stats() {
+  print_profiler_stats();
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include <recovery.h>
+
+// Estado de la recuperación (solo lo toca la tarea de control)
+static RECOVERY_STATES recovery_state = RECOVERY_TRACKING;
+static unsigned long state_us = 0;
+static unsigned long lost_us = 0;
+static int recovery_side = 1;
+
+// Última medida con la línea detectada
+static int last_position = 0;
+static long last_position_rate = 0;
+static int last_correction = 0;
+
+/**
+ * @brief Estadísticas de la carrera: veces que se entró en cada estado y pérdida más larga
+ *
+ */
+static unsigned long state_count[RECOVERY_ABORT + 1];
+static unsigned long recovered_count = 0;
+static unsigned long max_lost_us = 0;
+
+static const char *const recovery_state_names[RECOVERY_ABORT + 1] = {
+  "siguiendo", "hueco", "busqueda", "reversa", "abortada"
+};
+
+/**
+ * @brief Reinicia la recuperación al empezar la carrera
+ *
+ */
+void recovery_start() {
+  recovery_state = RECOVERY_TRACKING;
+  state_us = 0;
+  lost_us = 0;
+  last_position = 0;
+  last_position_rate = 0;
+  last_correction = 0;
+  for (int state = 0; state <= RECOVERY_ABORT; state++) {
+    state_count[state] = 0;
+  }
+  recovered_count = 0;
+  max_lost_us = 0;
+}
+
+static void enter_state(RECOVERY_STATES state) {
+  recovery_state = state;
+  state_us = 0;
+  state_count[state]++;
+}
+
+/**
+ * @brief Avanza la máquina de estados de la recuperación (una vez por ciclo de control)
+ * Con la línea detectada solo memoriza la posición, su variación y la corrección; al perderla
+ * elige hueco o búsqueda según la posición extrapolada y pasa de un estado al siguiente al
+ * agotar su tiempo. Si la línea reaparece en cualquier estado, vuelve a mandar el PID.
+ *
+ * @param line_detected Línea detectada en la trama actual
+ * @param position Posición de la línea (-255 a 255)
+ * @param position_rate Variación de la posición (unidades por segundo)
+ * @param correction Corrección del PID en este ciclo
+ * @param speed Velocidad objetivo en este ciclo (0-100%)
+ * @param period_us Periodo del bucle de control (μs)
+ * @param left_speed Velocidad del motor izquierdo durante la recuperación
+ * @param right_speed Velocidad del motor derecho durante la recuperación
+ * @return RECOVERY_STATES Estado actual; con RECOVERY_TRACKING las velocidades no se modifican
+ */
+RECOVERY_STATES recovery_update(bool line_detected, int position, long position_rate, int correction,
+                                int speed, unsigned long period_us, int *left_speed, int *right_speed) {
+  if (recovery_state == RECOVERY_ABORT) {
+    *left_speed = 0;
+    *right_speed = 0;
+    return recovery_state;
+  }
+
+  if (line_detected) {
+    if (recovery_state != RECOVERY_TRACKING) {
+      recovered_count++;
+      max_lost_us = max(max_lost_us, lost_us);
+      recovery_state = RECOVERY_TRACKING;
+    }
+    last_position = position;
+    last_position_rate = position_rate;
+    last_correction = correction;
+    return recovery_state;
+  }
+
+  if (recovery_state == RECOVERY_TRACKING) {
+    // Recién perdida: hacia dónde iba la línea
+    long predicted = last_position + last_position_rate * RECOVERY_TREND_MS / 1000;
+    recovery_side = predicted >= 0 ? 1 : -1;
+    lost_us = 0;
+    enter_state(labs(predicted) < RECOVERY_GAP_POSITION ? RECOVERY_GAP : RECOVERY_SEARCH);
+  } else {
+    state_us += period_us;
+    lost_us += period_us;
+    if (recovery_state == RECOVERY_GAP && state_us >= RECOVERY_GAP_MS * 1000UL) {
+      enter_state(RECOVERY_SEARCH);
+    } else if (recovery_state == RECOVERY_SEARCH && state_us >= RECOVERY_SEARCH_MS * 1000UL) {
+      enter_state(RECOVERY_REVERSE);
+    } else if (recovery_state == RECOVERY_REVERSE && state_us >= RECOVERY_REVERSE_MS * 1000UL) {
+      max_lost_us = max(max_lost_us, lost_us);
+      enter_state(RECOVERY_ABORT);
+    }
+  }
+
+  int search_speed = min(speed, RECOVERY_SEARCH_SPEED);
+  switch (recovery_state) {
+    case RECOVERY_GAP:
+      // Mismo rumbo: velocidad y último giro del PID antes del hueco
+      *left_speed = speed + last_correction;
+      *right_speed = speed - last_correction;
+      break;
+    case RECOVERY_SEARCH:
+      *left_speed = search_speed + recovery_side * RECOVERY_SEARCH_TURN;
+      *right_speed = search_speed - recovery_side * RECOVERY_SEARCH_TURN;
+      break;
+    case RECOVERY_REVERSE:
+      // En reversa el mismo diferencial sigue girando el frente de la regleta hacia la línea
+      *left_speed = -RECOVERY_REVERSE_SPEED + recovery_side * RECOVERY_SEARCH_TURN;
+      *right_speed = -RECOVERY_REVERSE_SPEED - recovery_side * RECOVERY_SEARCH_TURN;
+      break;
+    default:
+      *left_speed = 0;
+      *right_speed = 0;
+      break;
+  }
+  return recovery_state;
+}
+
+/**
+ * @brief Obtiene el estado actual de la recuperación
+ *
+ * @return RECOVERY_STATES Estado actual
+ */
+RECOVERY_STATES get_recovery_state() {
+  return recovery_state;
+}
+
+/**
+ * @brief Imprime cuántas veces se perdió la línea en la carrera y cómo se recuperó
+ *
+ */
+void print_recovery_stats() {
+  Serial.print("Recuperacion: ");
+  Serial.println(recovery_state_names[recovery_state]);
+  for (int state = RECOVERY_GAP; state <= RECOVERY_ABORT; state++) {
+    Serial.print("  ");
+    Serial.print(recovery_state_names[state]);
+    Serial.print(": ");
+    Serial.println(state_count[state]);
+  }
+  Serial.print("  recuperadas: ");
+  Serial.print(recovered_count);
+  Serial.print(", perdida mas larga: ");
+  Serial.print(max_lost_us / 1000.0f, 1);
+  Serial.println(" ms");
+}
@@ -1,171 +1,289 @@
 #include <sensors.h>
+#include <control.h>
+#include <profiler.h>
+#include <hal.h>
+#include <markers.h>
+
+#if SENSORS_SIMD
+#include <esp_dsp.h>
+#endif
 
 static int sensors_raw[SENSORS_COUNT];
-static long sensors_refresh_us = 0;
 
 static int sensors_max[SENSORS_COUNT];
 static int sensors_min[SENSORS_COUNT];
 static int sensors_threshold[SENSORS_COUNT];
-
-static long last_line_detected_ms = 0;
+static int sensors_noise = SENSORS_NOISE_DEFAULT;
 
 /**
- * @brief Configura los pines CBA del multiplexor según el canal (0-7)
+ * @brief Trama en formato de procesado: un array int16 alineado por magnitud para que cada
+ * paso recorra los 16 canales con instrucciones vectoriales (8 muestras por registro de 128 bits)
  *
- * @param channel Canal del multiplexor (0-7)
  */
-static void set_mux_channel(int channel) {
-  digitalWrite(MUX_A, bitRead(channel, 0)); // Bit A (LSB)
-  digitalWrite(MUX_B, bitRead(channel, 1)); // Bit B
-  digitalWrite(MUX_C, bitRead(channel, 2)); // Bit C (MSB)
-}
+struct sensors_frame_soa {
+  int16_t raw[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t offset[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t gain[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t alpha[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t normalized[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t delta[SENSORS_COUNT] __attribute__((aligned(16)));
+  int16_t smoothed[SENSORS_COUNT] __attribute__((aligned(16)));
+};
+static sensors_frame_soa sensors_soa;
+static volatile int sensors_smoothing = 0;
+
+static long last_line_detected_ms = 0;
+static bool line_detected = false;
+static volatile POSITION_MODES position_mode = POSITION_BINARY;
+
+static uint16_t sensors_frame[SENSORS_COUNT];
+static unsigned long sensors_frame_us = 0;
+static unsigned long sensors_raw_count = 0;
 
 /**
  * @brief Inicializa los pines de los sensores
  *
  */
 void init_sensors() {
-  pinMode(MUX_A, OUTPUT);
-  pinMode(MUX_B, OUTPUT);
-  pinMode(MUX_C, OUTPUT);
-  pinMode(SENSOR_1_8, INPUT);
-  pinMode(SENSOR_9_16, INPUT);
-
   // Inicializar valores de calibración
   for (int i = 0; i < SENSORS_COUNT; i++) {
     sensors_min[i] = SENSORS_MAX;
     sensors_max[i] = SENSORS_MIN;
     sensors_threshold[i] = 0;
   }
+  set_sensors_smoothing(sensors_smoothing);
 
-  set_mux_channel(0);
+  // Adquisición en segundo plano; si no se puede, se usa la lectura bloqueante
+  if (hal_sensors_start()) {
+    Serial.println("Sensores: adquisicion continua por DMA");
+  } else {
+    Serial.println("Sensores: ERROR iniciando DMA, usando lectura bloqueante");
+  }
 }
 
 /**
- * @brief Actualiza los valores de los sensores cada 1ms
- * Se van leyendo los valores de dos en dos por cada estado de los multiplexores
- * La lectura se realiza simétricamente desde el centro hacia los extremos
+ * @brief Normaliza y suaviza la trama recorriendo los canales uno a uno
+ * Misma aritmética que la versión vectorial: productos de 16x16 bits, desplazamiento aritmético
+ * y resultado truncado a 16 bits
  *
+ * @param frame Trama a procesar
  */
-static void refresh_sensors() {
-  if (micros() - sensors_refresh_us >= 1000 || micros() < sensors_refresh_us) {
-    // Canal 0 (CBA=000): Sensores 8 y 9 (centro)
-    set_mux_channel(0);
-    delayMicroseconds(10);
-    sensors_raw[7] = analogRead(SENSOR_1_8);
-    sensors_raw[8] = analogRead(SENSOR_9_16);
+static void process_frame_scalar(sensors_frame_soa *frame) {
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    int16_t offset = frame->raw[sensor] - frame->offset[sensor];
+    frame->normalized[sensor] = ((int32_t)offset * frame->gain[sensor]) >> SENSORS_GAIN_SHIFT;
+    frame->delta[sensor] = frame->normalized[sensor] - frame->smoothed[sensor];
+    frame->delta[sensor] = ((int32_t)frame->delta[sensor] * frame->alpha[sensor]) >> 15;
+    frame->smoothed[sensor] += frame->delta[sensor];
+  }
+}
 
-    // Canal 1 (CBA=001): Sensores 7 y 10
-    set_mux_channel(1);
-    delayMicroseconds(10);
-    sensors_raw[6] = analogRead(SENSOR_1_8);
-    sensors_raw[9] = analogRead(SENSOR_9_16);
+#if SENSORS_SIMD
+/**
+ * @brief Normaliza y suaviza la trama con las funciones vectoriales de esp-dsp
+ * En el ESP32-S3 cada llamada procesa los 16 canales en dos registros de 8 muestras
+ *
+ * @param frame Trama a procesar
+ */
+static void process_frame_simd(sensors_frame_soa *frame) {
+  dsps_sub_s16(frame->raw, frame->offset, frame->normalized, SENSORS_COUNT, 1, 1, 1, 0);
+  dsps_mul_s16(frame->normalized, frame->gain, frame->normalized, SENSORS_COUNT, 1, 1, 1, SENSORS_GAIN_SHIFT);
+  dsps_sub_s16(frame->normalized, frame->smoothed, frame->delta, SENSORS_COUNT, 1, 1, 1, 0);
+  dsps_mul_s16(frame->delta, frame->alpha, frame->delta, SENSORS_COUNT, 1, 1, 1, 15);
+  dsps_add_s16(frame->smoothed, frame->delta, frame->smoothed, SENSORS_COUNT, 1, 1, 1, 0);
+}
+#endif
+
+static void process_frame(sensors_frame_soa *frame) {
+#if SENSORS_SIMD
+  process_frame_simd(frame);
+#else
+  process_frame_scalar(frame);
+#endif
+}
 
-    // Canal 2 (CBA=010): Sensores 6 y 11
-    set_mux_channel(2);
-    delayMicroseconds(10);
-    sensors_raw[5] = analogRead(SENSOR_1_8);
-    sensors_raw[10] = analogRead(SENSOR_9_16);
+/**
+ * @brief Actualiza los valores de los sensores con la última trama completa
+ * Nunca bloquea: si no hay una trama nueva se conservan los valores actuales; cada trama nueva
+ * pasa una sola vez por la normalización y el filtro. Solo la llama la tarea de control, en cada
+ * ciclo, como único consumidor del buffer triple de la HAL; el resto de funciones (posición,
+ * calibración, comandos) leen la última trama procesada
+ *
+ */
+void update_sensors() {
+  PROFILE_BEGIN(acquisition);
+  if (hal_sensors_read_frame(sensors_frame, &sensors_raw_count, &sensors_frame_us)) {
+    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+      sensors_raw[sensor] = sensors_frame[sensor];
+      sensors_soa.raw[sensor] = sensors_frame[sensor];
+    }
+    process_frame(&sensors_soa);
+  }
+  PROFILE_END(STAGE_ACQUISITION, acquisition);
+}
 
-    // Canal 3 (CBA=011): Sensores 5 y 12
-    set_mux_channel(3);
-    delayMicroseconds(10);
-    sensors_raw[4] = analogRead(SENSOR_1_8);
-    sensors_raw[11] = analogRead(SENSOR_9_16);
+/**
+ * @brief Recalcula el desplazamiento y la ganancia de cada sensor para la normalización
+ * Se llama cada vez que cambian los valores de calibración; el filtro arranca desde la trama actual
+ *
+ */
+static void update_sensors_normalization() {
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    int range = sensors_max[sensor] - sensors_min[sensor];
+    sensors_soa.offset[sensor] = constrain(sensors_min[sensor], SENSORS_MIN, SENSORS_MAX);
+    sensors_soa.gain[sensor] = range > 0 ? min((SENSORS_NORM_ONE << SENSORS_GAIN_SHIFT) / range, (long)SENSORS_GAIN_MAX) : 0;
+    int16_t offset = sensors_soa.raw[sensor] - sensors_soa.offset[sensor];
+    sensors_soa.smoothed[sensor] = ((int32_t)offset * sensors_soa.gain[sensor]) >> SENSORS_GAIN_SHIFT;
+  }
+}
 
-    // Canal 4 (CBA=100): Sensores 4 y 13
-    set_mux_channel(4);
-    delayMicroseconds(10);
-    sensors_raw[3] = analogRead(SENSOR_1_8);
-    sensors_raw[12] = analogRead(SENSOR_9_16);
+/**
+ * @brief Histogramas de la calibración (uno por sensor, una muestra por trama)
+ *
+ */
+static uint16_t calibration_histogram[SENSORS_COUNT][SENSORS_HISTOGRAM_BINS];
+static uint16_t calibration_samples = 0;
 
-    // Canal 5 (CBA=101): Sensores 3 y 14
-    set_mux_channel(5);
-    delayMicroseconds(10);
-    sensors_raw[2] = analogRead(SENSOR_1_8);
-    sensors_raw[13] = analogRead(SENSOR_9_16);
+static void reset_calibration_histograms() {
+  memset(calibration_histogram, 0, sizeof(calibration_histogram));
+  calibration_samples = 0;
+}
 
-    // Canal 6 (CBA=110): Sensores 2 y 15
-    set_mux_channel(6);
-    delayMicroseconds(10);
-    sensors_raw[1] = analogRead(SENSOR_1_8);
-    sensors_raw[14] = analogRead(SENSOR_9_16);
+/**
+ * @brief Añade la última trama procesada por la tarea de control a los histogramas si es nueva
+ * Cada sensor se lee con una sola copia de 32 bits, así que una trama a medio actualizar solo
+ * mezcla muestras válidas de dos tramas seguidas
+ *
+ * @param last_frame Número de la última trama añadida (se actualiza)
+ */
+static void add_calibration_frame(unsigned long *last_frame) {
+  if (sensors_raw_count == *last_frame || calibration_samples == UINT16_MAX) {
+    return;
+  }
+  *last_frame = sensors_raw_count;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    int value = constrain(sensors_raw[sensor], SENSORS_MIN, SENSORS_MAX);
+    calibration_histogram[sensor][value >> SENSORS_HISTOGRAM_SHIFT]++;
+  }
+  calibration_samples++;
+}
 
-    // Canal 7 (CBA=111): Sensores 1 y 16 (extremos)
-    set_mux_channel(7);
-    delayMicroseconds(10);
-    sensors_raw[0] = analogRead(SENSOR_1_8);
-    sensors_raw[15] = analogRead(SENSOR_9_16);
+/**
+ * @brief Percentil de un sensor a partir de su histograma
+ *
+ * @param sensor Sensor (0-15)
+ * @param pct Percentil (0-100)
+ * @return int Valor en el centro del intervalo donde cae el percentil
+ */
+static int calibration_percentile(int sensor, int pct) {
+  uint32_t target = (uint32_t)calibration_samples * pct / 100;
+  uint32_t count = 0;
+  int bin = 0;
+  for (; bin < SENSORS_HISTOGRAM_BINS - 1; bin++) {
+    count += calibration_histogram[sensor][bin];
+    if (count > target) {
+      break;
+    }
+  }
+  return (bin << SENSORS_HISTOGRAM_SHIFT) + (1 << (SENSORS_HISTOGRAM_SHIFT - 1));
+}
 
-    // Volver al canal 0
-    set_mux_channel(0);
+/**
+ * @brief Valor de la muestra número target (de menor a mayor) de un sensor, interpolando
+ * linealmente dentro de su intervalo del histograma
+ *
+ * @param sensor Sensor (0-15)
+ * @param target Número de muestra
+ * @return float Valor en cuentas del ADC
+ */
+static float calibration_quantile(int sensor, uint32_t target) {
+  uint32_t count = 0;
+  for (int bin = 0; bin < SENSORS_HISTOGRAM_BINS; bin++) {
+    uint32_t in_bin = calibration_histogram[sensor][bin];
+    if (count + in_bin > target) {
+      return (bin << SENSORS_HISTOGRAM_SHIFT) + (float)(target - count) * (1 << SENSORS_HISTOGRAM_SHIFT) / in_bin;
+    }
+    count += in_bin;
+  }
+  return SENSORS_MAX;
+}
 
-    sensors_refresh_us = micros();
+/**
+ * @brief Estima el ruido de los sensores con sus muestras de fondo (ver SENSORS_NOISE_DEFAULT)
+ * Se llama con los umbrales ya calculados; sin muestras suficientes se mantiene el anterior
+ *
+ */
+static void update_noise_from_histograms() {
+  float sigma_sum = 0;
+  int sigma_count = 0;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    uint32_t background = 0;
+    for (int bin = 0; bin < (sensors_threshold[sensor] >> SENSORS_HISTOGRAM_SHIFT); bin++) {
+      background += calibration_histogram[sensor][bin];
+    }
+    if (background < SENSORS_NOISE_MIN_SAMPLES) {
+      continue;
+    }
+    float low = calibration_quantile(sensor, background * SENSORS_CALIBRATION_LOW_PCT / 100);
+    float median = calibration_quantile(sensor, background / 2);
+    sigma_sum += (median - low) / 2.054f;
+    sigma_count++;
+  }
+  if (sigma_count > 0) {
+    sensors_noise = max((int)lroundf(sigma_sum / sigma_count), 1);
   }
 }
 
 /**
- * @brief Calibra los sensores obteniendo los valores máximos y mínimos
+ * @brief Calcula mínimo, máximo y umbral de cada sensor con los percentiles de los histogramas
  * El umbral se calcula como el 2/3 del rango de valores entre el máximo y el mínimo
  *
+ * @return int Número de sensores con suficiente contraste
  */
-void calibrate_sensors() {
-  Serial.println("==============================================");
-  Serial.println("CALIBRACION DE SENSORES");
-  Serial.println("==============================================");
-  Serial.println("Mueve el robot sobre la linea durante 3 segundos...");
-  Serial.println();
-
-  long calibration_start_ms = millis();
+static int update_calibration_from_histograms() {
   int count_ok = 0;
-
-  do {
-    count_ok = 0;
-    for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
-      int sensor_value = get_sensor_raw(sensor);
-      if (sensor_value > sensors_max[sensor]) {
-        sensors_max[sensor] = sensor_value;
-      }
-      if (sensor_value < sensors_min[sensor]) {
-        sensors_min[sensor] = sensor_value;
-      }
-      // Umbral = min + 2/3 del rango
-      sensors_threshold[sensor] = sensors_min[sensor] + ((sensors_max[sensor] - sensors_min[sensor]) * 2 / 3);
-
-      // Verificar que hay suficiente contraste
-      if (abs(sensors_max[sensor] - sensors_min[sensor]) >= 1000) {
-        count_ok++;
-      }
-    }
-
-    // Mostrar progreso cada 500ms
-    if ((millis() - calibration_start_ms) % 500 < 50) {
-      Serial.print(".");
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    sensors_min[sensor] = calibration_percentile(sensor, SENSORS_CALIBRATION_LOW_PCT);
+    sensors_max[sensor] = calibration_percentile(sensor, SENSORS_CALIBRATION_HIGH_PCT);
+    // Umbral = min + 2/3 del rango
+    sensors_threshold[sensor] = sensors_min[sensor] + ((sensors_max[sensor] - sensors_min[sensor]) * 2 / 3);
+    if (sensors_max[sensor] - sensors_min[sensor] >= SENSORS_CALIBRATION_CONTRAST) {
+      count_ok++;
     }
+  }
+  update_noise_from_histograms();
+  return count_ok;
+}
 
-  } while (millis() - calibration_start_ms < SENSORS_CALIBRATION_MS);
-
+/**
+ * @brief Imprime el resultado de la calibración
+ * La tabla se compone en memoria y se envía de una vez en lugar de campo a campo
+ *
+ * @param count_ok Número de sensores con suficiente contraste
+ */
+static void print_calibration_result(int count_ok) {
   Serial.println();
   Serial.println();
   Serial.println("Calibracion completa:");
   Serial.print("Sensores con buen contraste: ");
   Serial.print(count_ok);
   Serial.print("/");
-  Serial.println(SENSORS_COUNT);
+  Serial.print(SENSORS_COUNT);
+  Serial.print(" (");
+  Serial.print(calibration_samples);
+  Serial.println(" tramas)");
+  Serial.print("Ruido del fondo: ");
+  Serial.print(sensors_noise);
+  Serial.println(" cuentas (desviacion tipica)");
 
   // Mostrar valores de calibración
-  Serial.println();
-  Serial.println("S# | Min  | Max  | Umbral");
-  Serial.println("---+------+------+-------");
+  char table[64 + SENSORS_COUNT * 28];
+  int length = snprintf(table, sizeof(table), "\nS# | Min  | Max  | Umbral\n---+------+------+-------\n");
   for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
-    Serial.print(sensor + 1);
-    Serial.print("  | ");
-    Serial.print(sensors_min[sensor]);
-    Serial.print(" | ");
-    Serial.print(sensors_max[sensor]);
-    Serial.print(" | ");
-    Serial.println(sensors_threshold[sensor]);
+    length += snprintf(table + length, sizeof(table) - length, "%-2d | %4d | %4d | %d\n", sensor + 1,
+                       sensors_min[sensor], sensors_max[sensor], sensors_threshold[sensor]);
   }
+  Serial.print(table);
 
   Serial.println("==============================================");
   Serial.println();
@@ -174,8 +292,183 @@ void calibrate_sensors() {
     Serial.println("ADVERTENCIA: Algunos sensores no tienen suficiente contraste!");
     Serial.println();
   }
+}
+
+/**
+ * @brief Calibra los sensores moviendo el robot a mano sobre la línea
+ * Mínimo, máximo y umbral salen de los histogramas de SENSORS_CALIBRATION_MS de tramas
+ *
+ */
+void calibrate_sensors() {
+  Serial.println("==============================================");
+  Serial.println("CALIBRACION DE SENSORES");
+  Serial.println("==============================================");
+  Serial.println("Mueve el robot sobre la linea durante 3 segundos...");
+  Serial.println();
+
+  reset_calibration_histograms();
+  unsigned long last_frame = sensors_raw_count;
+  unsigned long calibration_start_ms = hal_millis();
+  unsigned long progress_ms = calibration_start_ms;
+
+  while (hal_millis() - calibration_start_ms < SENSORS_CALIBRATION_MS) {
+    add_calibration_frame(&last_frame);
+
+    // Mostrar progreso cada 500ms
+    if (hal_millis() - progress_ms >= 500) {
+      progress_ms += 500;
+      Serial.print(".");
+    }
+    hal_delay_ms(1);
+  }
+
+  int count_ok = update_calibration_from_histograms();
+  update_sensors_normalization();
+  print_calibration_result(count_ok);
+
+  hal_delay_ms(1000);
+}
+
+/**
+ * @brief Calibra los sensores girando el robot en el sitio sobre la línea
+ * La tarea de control mueve los motores con un patrón fijo (ver set_calibration_spin) mientras
+ * se acumulan los histogramas; termina en cuanto todos los sensores tienen contraste o al agotar
+ * SENSORS_AUTO_CALIBRATION_MS. Requiere la tarea de control en marcha y el robot parado
+ *
+ * @return true Todos los sensores con suficiente contraste
+ * @return false Calibración incompleta (se aplica igualmente) o no se pudo girar
+ */
+bool calibrate_sensors_auto() {
+  Serial.println("==============================================");
+  Serial.println("CALIBRACION AUTOMATICA DE SENSORES");
+  Serial.println("==============================================");
+  Serial.println("Robot sobre la linea: girando en el sitio...");
+
+  if (!set_calibration_spin(true)) {
+    Serial.println("ERROR: no se puede girar durante la carrera");
+    return false;
+  }
+
+  reset_calibration_histograms();
+  unsigned long last_frame = sensors_raw_count;
+  unsigned long calibration_start_ms = hal_millis();
+  unsigned long check_ms = calibration_start_ms;
+  int checks = 0;
+  int count_ok = 0;
+
+  while (hal_millis() - calibration_start_ms < SENSORS_AUTO_CALIBRATION_MS) {
+    add_calibration_frame(&last_frame);
+
+    // Comprobar el contraste cada 50 ms
+    if (hal_millis() - check_ms >= 50) {
+      check_ms += 50;
+      if (++checks % 10 == 0) {
+        Serial.print(".");
+      }
+      count_ok = update_calibration_from_histograms();
+      if (count_ok == SENSORS_COUNT && hal_millis() - calibration_start_ms >= SENSORS_AUTO_CALIBRATION_MIN_MS) {
+        break;
+      }
+    }
+    hal_delay_ms(1);
+  }
+  unsigned long calibration_ms = hal_millis() - calibration_start_ms;
+
+  // El giro termina de vuelta en el centro
+  set_calibration_spin(false);
+  while (is_calibration_spinning()) {
+    hal_delay_ms(1);
+  }
+
+  count_ok = update_calibration_from_histograms();
+  update_sensors_normalization();
+  print_calibration_result(count_ok);
+  Serial.print("Tiempo de calibracion: ");
+  Serial.print(calibration_ms);
+  Serial.println(" ms");
+
+  return count_ok == SENSORS_COUNT;
+}
+
+/**
+ * @brief Copia los valores de calibración actuales
+ *
+ * @param min Array de SENSORS_COUNT valores mínimos
+ * @param max Array de SENSORS_COUNT valores máximos
+ * @param threshold Array de SENSORS_COUNT umbrales
+ */
+void get_sensors_calibration(int *min, int *max, int *threshold) {
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    min[sensor] = sensors_min[sensor];
+    max[sensor] = sensors_max[sensor];
+    threshold[sensor] = sensors_threshold[sensor];
+  }
+}
+
+/**
+ * @brief Establece los valores de calibración (por ejemplo, cargados de NVS)
+ *
+ * @param min Array de SENSORS_COUNT valores mínimos
+ * @param max Array de SENSORS_COUNT valores máximos
+ * @param threshold Array de SENSORS_COUNT umbrales
+ */
+void set_sensors_calibration(const int *min, const int *max, const int *threshold) {
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    sensors_min[sensor] = min[sensor];
+    sensors_max[sensor] = max[sensor];
+    sensors_threshold[sensor] = threshold[sensor];
+  }
+  update_sensors_normalization();
+}
+
+/**
+ * @brief Obtiene el ruido de los sensores medido en la calibración
+ *
+ * @return int Desviación típica en cuentas del ADC
+ */
+int get_sensors_noise() {
+  return sensors_noise;
+}
+
+/**
+ * @brief Establece el ruido de los sensores (por ejemplo, cargado de NVS)
+ *
+ * @param noise Desviación típica en cuentas del ADC
+ */
+void set_sensors_noise(int noise) {
+  sensors_noise = constrain(noise, 1, SENSORS_MAX);
+}
 
-  delay(1000);
+/**
+ * @brief Desviación típica de la posición medida, según el ruido de los sensores y el modo
+ * Ruido: desplaza el centroide en proporción al ruido relativo al rango de calibración, con los
+ * sensores de la ventana en modo analógico y solo los bordes de la línea en binario
+ * Cuantificación: saltos de medio sensor en binario (paridad de sensores activos), 1 en analógico
+ *
+ * @return float Desviación típica en unidades de posición
+ */
+float get_sensor_position_noise() {
+  long range_sum = 0;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    range_sum += sensors_max[sensor] - sensors_min[sensor];
+  }
+  float range = max((float)range_sum / SENSORS_COUNT, 1.0f);
+  float pitch = 2.0f * SENSORS_POSITION_MAX / (SENSORS_COUNT + 1);
+  float relative_noise = sensors_noise / range;
+
+  float noise, step;
+  if (position_mode == POSITION_ANALOG) {
+    float window = 0;  // Σ k² de los vecinos de la ventana a ambos lados
+    for (int neighbour = 1; neighbour <= SENSORS_ANALOG_WINDOW; neighbour++) {
+      window += 2 * neighbour * neighbour;
+    }
+    noise = pitch * relative_noise * sqrtf(window);
+    step = 1;
+  } else {
+    noise = pitch * relative_noise;
+    step = pitch / 2;
+  }
+  return sqrtf(noise * noise + step * step / 12);
 }
 
 /**
@@ -186,12 +479,23 @@ void calibrate_sensors() {
  */
 int get_sensor_raw(int sensor) {
   if (sensor >= 0 && sensor < SENSORS_COUNT) {
-    refresh_sensors();
     return sensors_raw[sensor];
   }
   return -1;
 }
 
+/**
+ * @brief Copia los valores sin procesar de los 16 sensores de la trama actual
+ * No refresca: devuelve exactamente la trama usada por la última posición calculada
+ *
+ * @param values Array de SENSORS_COUNT elementos
+ */
+void get_sensors_raw_frame(uint16_t *values) {
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    values[sensor] = sensors_raw[sensor];
+  }
+}
+
 /**
  * @brief Obtiene el valor calibrado de un sensor (binario: sobre línea o no)
  *
@@ -200,26 +504,41 @@ int get_sensor_raw(int sensor) {
  */
 int get_sensor_calibrated(int sensor) {
   if (sensor >= 0 && sensor < SENSORS_COUNT) {
-    refresh_sensors();
     return sensors_raw[sensor] >= sensors_threshold[sensor] ? SENSORS_MAX : SENSORS_MIN;
   }
   return -1;
 }
 
 /**
- * @brief Obtiene la posición del robot en la pista
- * Calcula la posición ponderada de la línea usando todos los sensores
+ * @brief Obtiene el valor normalizado (y suavizado) de un sensor con su rango de calibración
  *
- * @param last_position Última posición conocida del robot
- * @return int Posición del robot (-SENSORS_POSITION_MAX a +SENSORS_POSITION_MAX)
+ * @param sensor Sensor a leer (0-15)
+ * @return float 0 (fondo) a 1 (línea), -1 si el sensor no existe
  */
-int get_sensor_position(int last_position) {
+float get_sensor_normalized(int sensor) {
+  if (sensor >= 0 && sensor < SENSORS_COUNT) {
+    float value = (float)sensors_soa.smoothed[sensor] / SENSORS_NORM_ONE;
+    return constrain(value, 0.0f, 1.0f);
+  }
+  return -1;
+}
+
+#if !CONTROL_FIXED_POINT
+/**
+ * @brief Posición binaria: media ponderada de los sensores binarizados con el umbral
+ *
+ * @param last_position Última posición en unidades de peso (-position_max a position_max)
+ * @param position_max Posición máxima en unidades de peso
+ * @param line Sensores de la línea sobre el umbral (sin las marcas laterales)
+ * @return int Posición en unidades de peso
+ */
+static int get_sensor_position_binary(int last_position, int position_max, uint16_t line) {
   long sum_sensors_weight = 0;
   long sum_sensors = 0;
   int count_sensors_detecting = 0;
 
   for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
-    int sensor_value = get_sensor_calibrated(sensor);
+    int sensor_value = line & (1 << sensor) ? SENSORS_MAX : SENSORS_MIN;
     if (sensor_value >= sensors_threshold[sensor]) {
       count_sensors_detecting++;
     }
@@ -228,20 +547,250 @@ int get_sensor_position(int last_position) {
     sum_sensors += sensor_value;
   }
 
+  // Si detecta la línea (no todos los sensores en negro ni todos en blanco)
+  if (count_sensors_detecting > 0 && count_sensors_detecting < SENSORS_COUNT) {
+    last_line_detected_ms = hal_millis();
+    line_detected = true;
+    return (sum_sensors_weight / sum_sensors) - position_max;
+  }
+
+  // Línea perdida, mantener última dirección
+  return last_position >= 0 ? position_max : -position_max;
+}
+
+/**
+ * @brief Posición analógica: centroide continuo alrededor del sensor más fuerte
+ * Usa los valores normalizados a 0..1 con el min/max de calibración (y suavizados); el centroide se calcula
+ * solo con el pico y sus SENSORS_ANALOG_WINDOW vecinos a cada lado, restando el suelo de ruido,
+ * de forma que la posición varía de forma continua entre sensores
+ *
+ * @param last_position Última posición en unidades de peso (-position_max a position_max)
+ * @param position_max Posición máxima en unidades de peso
+ * @param eligible Sensores que pueden formar parte de la línea (sin las marcas laterales)
+ * @return int Posición en unidades de peso
+ */
+static int get_sensor_position_analog(int last_position, int position_max, uint16_t eligible) {
+  float normalized[SENSORS_COUNT];
+  int peak_sensor = 0;
+  int count_sensors_detecting = 0;
+
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    float value = eligible & (1 << sensor) ? (float)sensors_soa.smoothed[sensor] / SENSORS_NORM_ONE : 0;
+    normalized[sensor] = constrain(value, 0.0f, 1.0f);
+    if (normalized[sensor] > normalized[peak_sensor]) {
+      peak_sensor = sensor;
+    }
+    if (normalized[sensor] >= SENSORS_ANALOG_DETECT) {
+      count_sensors_detecting++;
+    }
+  }
+
+  // Sin pico claro o todos los sensores sobre la línea: línea perdida, mantener última dirección
+  if (normalized[peak_sensor] < SENSORS_ANALOG_DETECT || count_sensors_detecting >= SENSORS_COUNT) {
+    return last_position >= 0 ? position_max : -position_max;
+  }
+
+  int first = max(peak_sensor - SENSORS_ANALOG_WINDOW, 0);
+  int last = min(peak_sensor + SENSORS_ANALOG_WINDOW, SENSORS_COUNT - 1);
+  float sum_sensors_weight = 0;
+  float sum_sensors = 0;
+  for (int sensor = first; sensor <= last; sensor++) {
+    float weight = normalized[sensor] - SENSORS_ANALOG_FLOOR;
+    if (weight > 0) {
+      // Mismos pesos que el modo binario: sensor 0 (izq) = 1000, sensor 15 (der) = 16000
+      sum_sensors_weight += (sensor + 1) * 1000 * weight;
+      sum_sensors += weight;
+    }
+  }
+
+  last_line_detected_ms = hal_millis();
+  line_detected = true;
+  return (int)(sum_sensors_weight / sum_sensors) - position_max;
+}
+
+#else
+/**
+ * @brief Recíproco Q16 del número de sensores detectando (índice 0 sin uso)
+ *
+ */
+static const uint32_t sensors_count_recip[SENSORS_COUNT + 1] = {
+  0, 65536, 32768, 21845, 16384, 13107, 10923, 9362, 8192,
+  7282, 6554, 5958, 5461, 5041, 4681, 4369, 4096
+};
+
+/**
+ * @brief Posición binaria en punto fijo, sin la división larga de la versión original
+ * Con sensores binarizados la media ponderada se reduce a la media de los índices detectando,
+ * que se obtiene con el recíproco tabulado del número de sensores
+ *
+ * @param last_position Última posición en unidades de peso (-position_max a position_max)
+ * @param position_max Posición máxima en unidades de peso
+ * @param line Sensores de la línea sobre el umbral (sin las marcas laterales)
+ * @return int Posición en unidades de peso
+ */
+static int get_sensor_position_binary_fixed(int last_position, int position_max, uint16_t line) {
+  int32_t sum_sensors_index = 0;
+  int count_sensors_detecting = 0;
+
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    if (line & (1 << sensor)) {
+      sum_sensors_index += sensor + 1;
+      count_sensors_detecting++;
+    }
+  }
+
+  if (count_sensors_detecting > 0 && count_sensors_detecting < SENSORS_COUNT) {
+    last_line_detected_ms = hal_millis();
+    line_detected = true;
+    int64_t centroid_q16 = (int64_t)sum_sensors_index * 1000 * sensors_count_recip[count_sensors_detecting];
+    return (int)((centroid_q16 + 0x8000) >> 16) - position_max;
+  }
+
+  // Línea perdida, mantener última dirección
+  return last_position >= 0 ? position_max : -position_max;
+}
+
+/**
+ * @brief Posición analógica en punto fijo sobre la trama ya normalizada en Q12
+ * Misma ventana y suelo que get_sensor_position_analog; queda una única división por trama
+ *
+ * @param last_position Última posición en unidades de peso (-position_max a position_max)
+ * @param position_max Posición máxima en unidades de peso
+ * @param eligible Sensores que pueden formar parte de la línea (sin las marcas laterales)
+ * @return int Posición en unidades de peso
+ */
+static int get_sensor_position_analog_fixed(int last_position, int position_max, uint16_t eligible) {
+  const int32_t floor_q = SENSORS_ANALOG_FLOOR * SENSORS_NORM_ONE;
+  const int32_t detect_q = SENSORS_ANALOG_DETECT * SENSORS_NORM_ONE;
+  int32_t normalized[SENSORS_COUNT];
+  int peak_sensor = 0;
+  int count_sensors_detecting = 0;
+
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    int32_t value = eligible & (1 << sensor) ? sensors_soa.smoothed[sensor] : 0;
+    normalized[sensor] = constrain(value, (int32_t)0, (int32_t)SENSORS_NORM_ONE);
+    if (normalized[sensor] > normalized[peak_sensor]) {
+      peak_sensor = sensor;
+    }
+    if (normalized[sensor] >= detect_q) {
+      count_sensors_detecting++;
+    }
+  }
+
+  if (normalized[peak_sensor] < detect_q || count_sensors_detecting >= SENSORS_COUNT) {
+    return last_position >= 0 ? position_max : -position_max;
+  }
+
+  int first = max(peak_sensor - SENSORS_ANALOG_WINDOW, 0);
+  int last = min(peak_sensor + SENSORS_ANALOG_WINDOW, SENSORS_COUNT - 1);
+  int32_t sum_sensors_weight = 0;
+  int32_t sum_sensors = 0;
+  for (int sensor = first; sensor <= last; sensor++) {
+    int32_t weight = normalized[sensor] - floor_q;
+    if (weight > 0) {
+      sum_sensors_weight += (sensor + 1) * weight;
+      sum_sensors += weight;
+    }
+  }
+
+  last_line_detected_ms = hal_millis();
+  line_detected = true;
+  return (sum_sensors_weight * 1000) / sum_sensors - position_max;
+}
+
+#endif
+
+/**
+ * @brief Escala Q16 de unidades de peso a -SENSORS_POSITION_MAX..SENSORS_POSITION_MAX
+ *
+ */
+#define SENSORS_POSITION_SCALE_Q16 ((SENSORS_POSITION_MAX * 65536L) / ((1000 * (SENSORS_COUNT + 1)) / 2))
+
+/**
+ * @brief Obtiene la posición del robot en la pista
+ * Calcula la posición ponderada de la línea usando todos los sensores con el modo seleccionado,
+ * descartando las marcas laterales; en cruces y líneas anchas mantiene la última posición
+ * (ver markers_classify) para no provocar saltos en el derivativo
+ *
+ * @param last_position Última posición conocida del robot
+ * @return int Posición del robot (-SENSORS_POSITION_MAX a +SENSORS_POSITION_MAX)
+ */
+int get_sensor_position(int last_position) {
   int position_max = ((1000 * (SENSORS_COUNT + 1)) / 2);
   int position = 0;
 
-  // Si detecta la línea (no todos los sensores en negro ni todos en blanco)
-  if (count_sensors_detecting > 0 && count_sensors_detecting < SENSORS_COUNT) {
-    position = (sum_sensors_weight / sum_sensors) - position_max;
-    last_line_detected_ms = millis();
+  // Una sola trama para todos los sensores: la última que procesó update_sensors
+  line_detected = false;
+
+  // Patrón de la trama: marcas, cruces y sensores de la línea, con el mismo criterio de
+  // detección que el modo de posición
+  const int16_t detect_q = SENSORS_ANALOG_DETECT * SENSORS_NORM_ONE;
+  uint16_t detected = 0;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    bool on_line = position_mode == POSITION_ANALOG ? sensors_soa.smoothed[sensor] >= detect_q
+                                                    : sensors_raw[sensor] >= sensors_threshold[sensor];
+    if (on_line) {
+      detected |= 1 << sensor;
+    }
+  }
+  uint16_t line = 0;
+  MARKER_TYPES marker = markers_classify(detected, last_position, sensors_frame_us, &line);
+  if (detected != 0 && line == 0) {
+    last_line_detected_ms = hal_millis();
+    line_detected = true;
+    return last_position;
+  }
+
+  // En modo analógico la línea son sus sensores y los vecinos de la ventana del centroide
+  uint16_t eligible = 0xFFFF;
+  if (marker == MARKER_LEFT || marker == MARKER_RIGHT) {
+    eligible = line;
+    for (int neighbour = 1; neighbour <= SENSORS_ANALOG_WINDOW; neighbour++) {
+      eligible |= (line << neighbour) | (line >> neighbour);
+    }
+  }
+
+#if CONTROL_FIXED_POINT
+  // Solo importa el signo de la última posición
+  if (position_mode == POSITION_ANALOG) {
+    position = get_sensor_position_analog_fixed(last_position, position_max, eligible);
+  } else {
+    position = get_sensor_position_binary_fixed(last_position, position_max, line);
+  }
+
+  // Escalar a rango -SENSORS_POSITION_MAX a +SENSORS_POSITION_MAX sin map()
+  return (position * SENSORS_POSITION_SCALE_Q16) / 65536;
+#else
+  int last_position_weight = map(last_position, -SENSORS_POSITION_MAX, SENSORS_POSITION_MAX, -position_max, position_max);
+  if (position_mode == POSITION_ANALOG) {
+    position = get_sensor_position_analog(last_position_weight, position_max, eligible);
   } else {
-    // Línea perdida, mantener última dirección
-    position = last_position >= 0 ? position_max : -position_max;
+    position = get_sensor_position_binary(last_position_weight, position_max, line);
   }
 
   // Mapear a rango -SENSORS_POSITION_MAX a +SENSORS_POSITION_MAX
   return map(position, -position_max, position_max, -SENSORS_POSITION_MAX, SENSORS_POSITION_MAX);
+#endif
+}
+
+/**
+ * @brief Selecciona el modo de cálculo de la posición
+ *
+ * @param mode POSITION_BINARY o POSITION_ANALOG
+ */
+void set_sensor_position_mode(POSITION_MODES mode) {
+  position_mode = mode;
+  Serial.print("Modo de posicion: ");
+  Serial.println(mode == POSITION_ANALOG ? "analogico" : "binario");
+}
+
+/**
+ * @brief Obtiene el modo de cálculo de la posición
+ *
+ * @return POSITION_MODES Modo actual
+ */
+POSITION_MODES get_sensor_position_mode() {
+  return position_mode;
 }
 
 /**
@@ -253,6 +802,55 @@ long get_last_line_detected_ms() {
   return last_line_detected_ms;
 }
 
+/**
+ * @brief Indica si la última llamada a get_sensor_position vio la línea
+ * Si no, la posición devuelta es el extremo del último lado conocido
+ *
+ * @return true Línea detectada en la trama actual
+ * @return false Línea perdida
+ */
+bool is_line_detected() {
+  return line_detected;
+}
+
+/**
+ * @brief Restaura la detección de línea que dejó get_sensor_position (para benchmark_control)
+ *
+ * @param detected Valor anterior de is_line_detected
+ * @param detected_ms Valor anterior de get_last_line_detected_ms
+ */
+void set_line_detected(bool detected, long detected_ms) {
+  line_detected = detected;
+  last_line_detected_ms = detected_ms;
+}
+
+/**
+ * @brief Obtiene el número de trama de los valores actuales de los sensores
+ *
+ * @return unsigned long Contador de tramas completas (crece con cada trama nueva)
+ */
+unsigned long get_sensors_frame_count() {
+  return sensors_raw_count;
+}
+
+/**
+ * @brief Obtiene el instante en que se completó la trama actual
+ *
+ * @return unsigned long Tiempo en μs de la trama actual
+ */
+unsigned long get_sensors_frame_us() {
+  return sensors_frame_us;
+}
+
+/**
+ * @brief Obtiene las ranuras del multiplexor que no recibieron datos del DMA
+ *
+ * @return unsigned long Número de ranuras perdidas desde el arranque
+ */
+unsigned long get_sensors_missed_slots() {
+  return hal_sensors_missed_slots();
+}
+
 /**
  * @brief Imprime los valores raw de todos los sensores
  *
@@ -273,8 +871,79 @@ void print_sensors_raw() {
 void print_sensors_calibrated() {
   Serial.print("CAL: ");
   for (int i = 0; i < SENSORS_COUNT; i++) {
-    Serial.print(get_sensor_calibrated(i) == SENSORS_MAX ? "1" : "0");
+    Serial.print(sensors_raw[i] >= sensors_threshold[i] ? "1" : "0");
     if (i < SENSORS_COUNT - 1) Serial.print(" ");
   }
   Serial.println();
 }
+
+/**
+ * @brief Cambia el suavizado del filtro IIR de cada sensor
+ * 0 = sin filtro (la trama normalizada tal cual); cuanto mayor, más peso tienen las tramas anteriores
+ *
+ * @param smoothing Suavizado (0 a SENSORS_SMOOTHING_MAX %)
+ */
+void set_sensors_smoothing(int smoothing) {
+  sensors_smoothing = constrain(smoothing, 0, SENSORS_SMOOTHING_MAX);
+  int16_t alpha = sensors_smoothing == 0 ? INT16_MAX : (100 - sensors_smoothing) * 32768L / 100;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    sensors_soa.alpha[sensor] = alpha;
+  }
+}
+
+int get_sensors_smoothing() {
+  return sensors_smoothing;
+}
+
+/**
+ * @brief Compara los ciclos por trama del procesado vectorial y del escalar
+ * Ambos procesan copias de la trama actual con la calibración actual y se comprueba que el
+ * resultado sea el mismo
+ *
+ * @param iterations Tramas a procesar con cada versión
+ */
+void benchmark_sensors(int iterations) {
+  iterations = max(iterations, 1);
+  static sensors_frame_soa frame_scalar;
+  frame_scalar = sensors_soa;
+  uint32_t cycles_start = hal_cycles();
+  for (int i = 0; i < iterations; i++) {
+    process_frame_scalar(&frame_scalar);
+  }
+  uint32_t cycles_scalar = (hal_cycles() - cycles_start) / iterations;
+
+  Serial.print("BENCHMARK SENSORES (");
+  Serial.print(iterations);
+  Serial.println(" tramas, ciclos por trama)");
+  Serial.print("  Escalar: ");
+  Serial.println(cycles_scalar);
+
+#if SENSORS_SIMD
+  static sensors_frame_soa frame_simd;
+  frame_simd = sensors_soa;
+  cycles_start = hal_cycles();
+  for (int i = 0; i < iterations; i++) {
+    process_frame_simd(&frame_simd);
+  }
+  uint32_t cycles_simd = (hal_cycles() - cycles_start) / iterations;
+
+  int mismatches = 0;
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    if (frame_simd.normalized[sensor] != frame_scalar.normalized[sensor] ||
+        frame_simd.smoothed[sensor] != frame_scalar.smoothed[sensor]) {
+      mismatches++;
+    }
+  }
+  Serial.print("  SIMD: ");
+  Serial.println(cycles_simd);
+  Serial.print("  Sensores con resultado distinto: ");
+  Serial.println(mismatches);
+#else
+  Serial.println("  SIMD: no disponible en esta plataforma");
+#endif
+  Serial.print("  Adquisicion: ");
+  Serial.print(get_sensors_frame_count());
+  Serial.print(" tramas, ");
+  Serial.print(get_sensors_missed_slots());
+  Serial.println(" ranuras sin conversion asentada");
+}
@@ -0,0 +1,198 @@
+#include <storage.h>
+#include <control.h>
+#include <track_map.h>
+#include <estimator.h>
+#include <Preferences.h>
+#include <esp_rom_crc.h>
+
+/**
+ * @brief Calcula el CRC32 de la configuración (sin el propio campo crc)
+ *
+ * @param config Configuración
+ * @return uint32_t CRC32
+ */
+static uint32_t calc_config_crc(const storage_config_t *config) {
+  return esp_rom_crc32_le(0, (const uint8_t *)config, offsetof(storage_config_t, crc));
+}
+
+/**
+ * @brief Guarda en NVS la calibración de sensores y los parámetros de ajuste actuales
+ *
+ * @return true Si se guardó correctamente
+ * @return false Si falló la escritura
+ */
+bool save_config() {
+  storage_config_t config = {};
+  int sensors_min[SENSORS_COUNT];
+  int sensors_max[SENSORS_COUNT];
+  int sensors_threshold[SENSORS_COUNT];
+
+  get_sensors_calibration(sensors_min, sensors_max, sensors_threshold);
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    config.sensors_min[sensor] = sensors_min[sensor];
+    config.sensors_max[sensor] = sensors_max[sensor];
+    config.sensors_threshold[sensor] = sensors_threshold[sensor];
+  }
+  config.version = STORAGE_VERSION;
+  config.size = sizeof(storage_config_t);
+  config.base_speed = get_base_speed();
+  config.base_accel_speed = get_base_accel_speed();
+  config.base_fan_speed = get_base_fan_speed();
+  config.position_mode = get_sensor_position_mode();
+  config.map_speed_straight = get_track_map_straight_speed();
+  config.map_speed_curve = get_track_map_curve_speed();
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    get_pid_gains(point, &config.pid_gains[point][0], &config.pid_gains[point][1], &config.pid_gains[point][2]);
+  }
+  config.control_period_us = get_control_period_us();
+  config.pid_d_filter_hz = get_pid_d_filter_hz();
+  config.brake_max = get_brake_max();
+  config.motors_decay_mode = get_motors_decay_mode();
+  config.motors_pwm_resolution = get_motors_pwm_resolution();
+  config.motors_pwm_hz = get_motors_pwm_hz();
+  config.suction_enabled = is_suction_enabled();
+  for (int point = 0; point < SUCTION_SCHEDULE_POINTS; point++) {
+    config.suction_fan[point] = get_suction_fan(point);
+  }
+  config.suction_curve_gain = get_suction_curve_gain();
+  config.suction_brake_boost = get_suction_brake_boost();
+  config.suction_ramp = get_suction_ramp();
+  config.sensors_smoothing = get_sensors_smoothing();
+  config.laps_target = get_laps_target();
+  config.laps_source = get_laps_source();
+  config.sensors_noise = get_sensors_noise();
+  config.estimator_enabled = is_estimator_enabled();
+  config.estimator_process_noise = get_estimator_process_noise();
+  config.crc = calc_config_crc(&config);
+
+  Preferences preferences;
+  preferences.begin(STORAGE_NAMESPACE, false);
+  bool saved = preferences.putBytes(STORAGE_KEY_CONFIG, &config, sizeof(config)) == sizeof(config);
+  preferences.end();
+
+  Serial.println(saved ? "Configuracion guardada" : "ERROR guardando configuracion");
+  return saved;
+}
+
+/**
+ * @brief Carga de NVS la configuración guardada y la aplica
+ * Solo se aplica si la versión, el tamaño y el CRC coinciden
+ *
+ * @return true Si había una configuración válida y se aplicó
+ * @return false Si no hay configuración o no es válida
+ */
+bool load_config() {
+  storage_config_t config = {};
+
+  Preferences preferences;
+  preferences.begin(STORAGE_NAMESPACE, true);
+  size_t length = preferences.getBytes(STORAGE_KEY_CONFIG, &config, sizeof(config));
+  preferences.end();
+
+  if (length != sizeof(config) || config.version != STORAGE_VERSION || config.size != sizeof(config)) {
+    Serial.println("Sin configuracion guardada valida");
+    return false;
+  }
+  if (config.crc != calc_config_crc(&config)) {
+    Serial.println("Configuracion guardada corrupta (CRC)");
+    return false;
+  }
+
+  int sensors_min[SENSORS_COUNT];
+  int sensors_max[SENSORS_COUNT];
+  int sensors_threshold[SENSORS_COUNT];
+  for (int sensor = 0; sensor < SENSORS_COUNT; sensor++) {
+    sensors_min[sensor] = config.sensors_min[sensor];
+    sensors_max[sensor] = config.sensors_max[sensor];
+    sensors_threshold[sensor] = config.sensors_threshold[sensor];
+  }
+  set_sensors_calibration(sensors_min, sensors_max, sensors_threshold);
+  set_base_speed(config.base_speed);
+  set_base_accel_speed(config.base_accel_speed);
+  set_base_fan_speed(config.base_fan_speed);
+  set_sensor_position_mode(config.position_mode == POSITION_ANALOG ? POSITION_ANALOG : POSITION_BINARY);
+  set_track_map_speeds(config.map_speed_straight, config.map_speed_curve);
+  for (int point = 0; point < PID_SCHEDULE_POINTS; point++) {
+    set_pid_gains(point, config.pid_gains[point][0], config.pid_gains[point][1], config.pid_gains[point][2]);
+  }
+  set_control_period_us(config.control_period_us);
+  set_pid_d_filter_hz(config.pid_d_filter_hz);
+  set_brake_max(config.brake_max);
+  set_motors_decay_mode(config.motors_decay_mode == MOTORS_DECAY_FAST ? MOTORS_DECAY_FAST : MOTORS_DECAY_SLOW);
+  set_motors_pwm(config.motors_pwm_hz, config.motors_pwm_resolution);
+  set_suction_enabled(config.suction_enabled);
+  for (int point = 0; point < SUCTION_SCHEDULE_POINTS; point++) {
+    set_suction_fan(point, config.suction_fan[point]);
+  }
+  set_suction_curve_gain(config.suction_curve_gain);
+  set_suction_brake_boost(config.suction_brake_boost);
+  set_suction_ramp(config.suction_ramp);
+  set_sensors_smoothing(config.sensors_smoothing);
+  set_laps_target(config.laps_target);
+  set_laps_source(config.laps_source == LAPS_SOURCE_SIGNAL ? LAPS_SOURCE_SIGNAL : LAPS_SOURCE_MARKER);
+  set_sensors_noise(config.sensors_noise);
+  set_estimator_enabled(config.estimator_enabled);
+  set_estimator_process_noise(config.estimator_process_noise);
+
+  Serial.println("Configuracion cargada");
+  return true;
+}
+
+/**
+ * @brief Borra la configuración guardada (el siguiente arranque pedirá calibración)
+ *
+ */
+void erase_config() {
+  Preferences preferences;
+  preferences.begin(STORAGE_NAMESPACE, false);
+  preferences.remove(STORAGE_KEY_CONFIG);
+  preferences.end();
+  Serial.println("Configuracion borrada");
+}
+
+/**
+ * @brief Guarda en NVS el historial de carreras
+ *
+ * @return true Si se guardó correctamente
+ * @return false Si falló la escritura
+ */
+bool save_laps_history() {
+  storage_laps_t laps = {};
+  laps.version = STORAGE_VERSION;
+  laps.size = sizeof(storage_laps_t);
+  get_laps_history(&laps.history);
+  laps.crc = esp_rom_crc32_le(0, (const uint8_t *)&laps, offsetof(storage_laps_t, crc));
+
+  Preferences preferences;
+  preferences.begin(STORAGE_NAMESPACE, false);
+  bool saved = preferences.putBytes(STORAGE_KEY_LAPS, &laps, sizeof(laps)) == sizeof(laps);
+  preferences.end();
+
+  if (!saved) {
+    Serial.println("ERROR guardando historial de carreras");
+  }
+  return saved;
+}
+
+/**
+ * @brief Carga de NVS el historial de carreras
+ * Solo se aplica si la versión, el tamaño y el CRC coinciden
+ *
+ * @return true Si había un historial válido
+ * @return false Si no hay historial o no es válido
+ */
+bool load_laps_history() {
+  storage_laps_t laps = {};
+
+  Preferences preferences;
+  preferences.begin(STORAGE_NAMESPACE, true);
+  size_t length = preferences.getBytes(STORAGE_KEY_LAPS, &laps, sizeof(laps));
+  preferences.end();
+
+  if (length != sizeof(laps) || laps.version != STORAGE_VERSION || laps.size != sizeof(laps) ||
+      laps.crc != esp_rom_crc32_le(0, (const uint8_t *)&laps, offsetof(storage_laps_t, crc))) {
+    return false;
+  }
+  set_laps_history(&laps.history);
+  return true;
+}
@@ -0,0 +1,181 @@
+#include <suction.h>
+#include <motors.h>
+
+static const int suction_speeds[SUCTION_SCHEDULE_POINTS] = SUCTION_SCHEDULE_SPEEDS;
+static volatile int suction_fan[SUCTION_SCHEDULE_POINTS] = SUCTION_SCHEDULE_FAN;
+static volatile int suction_curve_gain = SUCTION_CURVE_GAIN;
+static volatile int suction_brake_boost = SUCTION_BRAKE_BOOST;
+static volatile int suction_ramp = SUCTION_RAMP_PCT_PER_S;
+static volatile bool suction_enabled = true;
+
+/**
+ * @brief Mando actual de la turbina (pasos de FAN_THROTTLE_MAX en Q8; solo lo toca la tarea de control)
+ *
+ */
+static int32_t suction_throttle_q8 = 0;
+
+/**
+ * @brief Succión en recta para una velocidad, interpolando la tabla
+ *
+ * @param speed Velocidad actual (0-100%)
+ * @return int32_t Mando de la turbina (0 a FAN_THROTTLE_MAX)
+ */
+static int32_t straight_throttle(int speed) {
+  int point = 0;
+  while (point < SUCTION_SCHEDULE_POINTS - 1 && speed > suction_speeds[point + 1]) {
+    point++;
+  }
+  int32_t throttle = suction_fan[point] * FAN_THROTTLE_MAX / 100;
+  if (point < SUCTION_SCHEDULE_POINTS - 1 && speed > suction_speeds[point]) {
+    int32_t next = suction_fan[point + 1] * FAN_THROTTLE_MAX / 100;
+    throttle += (next - throttle) * (speed - suction_speeds[point]) /
+                (suction_speeds[point + 1] - suction_speeds[point]);
+  }
+  return throttle;
+}
+
+/**
+ * @brief Actualiza el mando de la turbina (desde la tarea de control, una vez por ciclo)
+ * Objetivo: succión de la tabla para la velocidad actual, más la de curva según la posición de
+ * la línea o su variación, más la de frenada; limitado a fan_max y alcanzado con rampa
+ * Con el planificador desactivado el objetivo es fan_max constante (comportamiento original)
+ *
+ * @param speed Velocidad actual (0-100%)
+ * @param position Posición de la línea (-255 a 255)
+ * @param position_rate Variación de la posición (unidades por segundo)
+ * @param braking true si el control está frenando activamente
+ * @param fan_max Succión máxima (0-100%, 0 = turbina apagada)
+ * @param period_us Periodo del bucle de control (μs)
+ */
+void suction_update(int speed, int position, long position_rate, bool braking, int fan_max,
+                    unsigned long period_us) {
+  int32_t max_throttle = constrain(fan_max, 0, 100) * FAN_THROTTLE_MAX / 100;
+  int32_t target = max_throttle;
+  if (suction_enabled) {
+    // Fracción de curva en ‰: la mayor entre la posición y su variación
+    int32_t curve = abs(position) * 1000 / 255;
+    int32_t rate = min(labs(position_rate), (long)SUCTION_RATE_FULL) * 1000 / SUCTION_RATE_FULL;
+    if (rate > curve) {
+      curve = rate;
+    }
+    target = straight_throttle(speed) + (int32_t)suction_curve_gain * FAN_THROTTLE_MAX / 100 * curve / 1000;
+    if (braking) {
+      target += suction_brake_boost * FAN_THROTTLE_MAX / 100;
+    }
+    target = constrain(target, 0, max_throttle);
+  }
+
+  // Rampa: pasos de mando por ciclo en Q8
+  int32_t step = (int32_t)((int64_t)suction_ramp * FAN_THROTTLE_MAX / 100 * period_us * 256 / 1000000);
+  int32_t target_q8 = target << 8;
+  if (suction_throttle_q8 < target_q8) {
+    suction_throttle_q8 = min(suction_throttle_q8 + step, target_q8);
+  } else if (suction_throttle_q8 > target_q8) {
+    suction_throttle_q8 = max(suction_throttle_q8 - step, target_q8);
+  }
+  set_fan_throttle(suction_throttle_q8 >> 8);
+}
+
+/**
+ * @brief Reinicia la rampa con la turbina parada (al detener la carrera)
+ *
+ */
+void suction_reset() {
+  suction_throttle_q8 = 0;
+}
+
+/**
+ * @brief Obtiene el mando actual de la turbina
+ *
+ * @return int Succión (0-100%)
+ */
+int get_suction_fan_speed() {
+  return (suction_throttle_q8 >> 8) * 100 / FAN_THROTTLE_MAX;
+}
+
+/**
+ * @brief Activa o desactiva el planificador de succión
+ * Desactivado, la turbina va a la velocidad base (f) constante
+ *
+ * @param enabled true para ajustar la succión a la velocidad y a las curvas
+ */
+void set_suction_enabled(bool enabled) {
+  suction_enabled = enabled;
+}
+
+bool is_suction_enabled() {
+  return suction_enabled;
+}
+
+/**
+ * @brief Cambia la succión en recta de un punto de la tabla
+ *
+ * @param point Punto de la tabla (0 a SUCTION_SCHEDULE_POINTS - 1)
+ * @param fan Succión (0-100%)
+ */
+void set_suction_fan(int point, int fan) {
+  if (point < 0 || point >= SUCTION_SCHEDULE_POINTS) {
+    return;
+  }
+  suction_fan[point] = constrain(fan, 0, 100);
+}
+
+int get_suction_fan(int point) {
+  return suction_fan[constrain(point, 0, SUCTION_SCHEDULE_POINTS - 1)];
+}
+
+int get_suction_speed(int point) {
+  return suction_speeds[constrain(point, 0, SUCTION_SCHEDULE_POINTS - 1)];
+}
+
+void set_suction_curve_gain(int gain) {
+  suction_curve_gain = constrain(gain, 0, 100);
+}
+
+int get_suction_curve_gain() {
+  return suction_curve_gain;
+}
+
+void set_suction_brake_boost(int boost) {
+  suction_brake_boost = constrain(boost, 0, 100);
+}
+
+int get_suction_brake_boost() {
+  return suction_brake_boost;
+}
+
+void set_suction_ramp(int pct_per_s) {
+  suction_ramp = constrain(pct_per_s, 1, SUCTION_RAMP_MAX_PCT_PER_S);
+}
+
+int get_suction_ramp() {
+  return suction_ramp;
+}
+
+/**
+ * @brief Imprime la tabla y los ajustes del planificador de succión
+ *
+ */
+void print_suction() {
+  Serial.print("Planificador de succion: ");
+  Serial.println(suction_enabled ? "activo" : "desactivado (turbina constante)");
+  Serial.println("Pt | Vel | Recta");
+  Serial.println("---+-----+------");
+  for (int point = 0; point < SUCTION_SCHEDULE_POINTS; point++) {
+    Serial.print(point);
+    Serial.print("  | ");
+    Serial.print(suction_speeds[point]);
+    Serial.print("  | ");
+    Serial.print(suction_fan[point]);
+    Serial.println("%");
+  }
+  Serial.print("Curva: +");
+  Serial.print(suction_curve_gain);
+  Serial.print("%, frenada: +");
+  Serial.print(suction_brake_boost);
+  Serial.print("%, rampa: ");
+  Serial.print(suction_ramp);
+  Serial.print(" %/s, actual: ");
+  Serial.print(get_suction_fan_speed());
+  Serial.println("%");
+}
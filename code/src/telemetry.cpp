@@ -0,0 +1,187 @@
+#include <telemetry.h>
+#include <atomic>
+#include <esp_rom_crc.h>
+
+/**
+ * @brief Buffer circular de un productor (control, núcleo 1) y un consumidor (envío, núcleo 0)
+ * El productor solo escribe head y el consumidor solo escribe tail; ninguno espera al otro.
+ * Si el buffer está lleno la trama se descarta y se cuenta.
+ *
+ */
+static telemetry_frame_t *telemetry_buffer = NULL;
+static uint32_t telemetry_mask = 0;
+static std::atomic<uint32_t> telemetry_head(0);
+static std::atomic<uint32_t> telemetry_tail(0);
+
+static volatile bool telemetry_streaming = false;
+static uint32_t telemetry_seq = 0;
+static std::atomic<uint32_t> telemetry_dropped(0);
+
+/**
+ * @brief Escribe un paquete con cabecera de sincronismo y CRC en el buffer de salida
+ *
+ * @param out Buffer de salida
+ * @param type Tipo de paquete
+ * @param data Datos del paquete
+ * @param length Longitud de los datos
+ * @return size_t Bytes escritos en out
+ */
+static size_t telemetry_encode(uint8_t *out, uint8_t type, const void *data, uint8_t length) {
+  out[0] = TELEMETRY_SYNC_0;
+  out[1] = TELEMETRY_SYNC_1;
+  out[2] = type;
+  out[3] = length;
+  memcpy(&out[4], data, length);
+  uint16_t crc = esp_rom_crc16_le(0, &out[2], length + 2);
+  out[4 + length] = crc & 0xFF;
+  out[5 + length] = crc >> 8;
+  return length + 6;
+}
+
+/**
+ * @brief Tarea de envío: vacía el buffer circular por USB CDC en bloques
+ *
+ * @param arg No utilizado
+ */
+static void telemetry_task(void *arg) {
+  uint8_t packet_buffer[(sizeof(telemetry_frame_t) + 6) * 8 + sizeof(telemetry_status_t) + 6];
+  unsigned long last_status_ms = 0;
+
+  for (;;) {
+    uint32_t tail = telemetry_tail.load(std::memory_order_relaxed);
+    uint32_t head = telemetry_head.load(std::memory_order_acquire);
+
+    if (!telemetry_streaming) {
+      // Sin envío activo se descarta lo pendiente para empezar siempre con datos recientes
+      telemetry_tail.store(head, std::memory_order_release);
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+
+    size_t packet_length = 0;
+    while (tail != head && packet_length + sizeof(telemetry_frame_t) + 6 <= sizeof(packet_buffer) - sizeof(telemetry_status_t) - 6) {
+      packet_length += telemetry_encode(&packet_buffer[packet_length], TELEMETRY_PACKET_FRAME,
+                                        &telemetry_buffer[tail & telemetry_mask], sizeof(telemetry_frame_t));
+      tail++;
+    }
+    telemetry_tail.store(tail, std::memory_order_release);
+
+    if (millis() - last_status_ms >= TELEMETRY_STATUS_MS) {
+      telemetry_status_t status;
+      status.pushed = telemetry_seq;
+      status.dropped = telemetry_dropped.load(std::memory_order_relaxed);
+      status.capacity = telemetry_mask + 1;
+      status.used = head - tail;
+      packet_length += telemetry_encode(&packet_buffer[packet_length], TELEMETRY_PACKET_STATUS, &status, sizeof(status));
+      last_status_ms = millis();
+    }
+
+    if (packet_length > 0) {
+      TELEMETRY_SERIAL.write(packet_buffer, packet_length);
+    }
+
+    // Ceder solo si no queda nada pendiente
+    if (tail == telemetry_head.load(std::memory_order_acquire)) {
+      vTaskDelay(1);
+    }
+  }
+}
+
+/**
+ * @brief Reserva el buffer circular en PSRAM y arranca la tarea de envío
+ *
+ */
+void init_telemetry() {
+  uint32_t capacity = TELEMETRY_CAPACITY;
+  if (psramFound()) {
+    telemetry_buffer = (telemetry_frame_t *)ps_malloc(capacity * sizeof(telemetry_frame_t));
+  }
+  if (telemetry_buffer == NULL) {
+    capacity = TELEMETRY_FALLBACK_CAPACITY;
+    telemetry_buffer = (telemetry_frame_t *)malloc(capacity * sizeof(telemetry_frame_t));
+  }
+  if (telemetry_buffer == NULL) {
+    Serial.println("Telemetria: ERROR sin memoria");
+    return;
+  }
+  telemetry_mask = capacity - 1;
+
+#if !ARDUINO_USB_CDC_ON_BOOT
+  TELEMETRY_SERIAL.begin();
+#endif
+  xTaskCreatePinnedToCore(telemetry_task, "telemetry", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, NULL, TELEMETRY_TASK_CORE);
+
+  Serial.print("Telemetria: ");
+  Serial.print(capacity);
+  Serial.println(psramFound() && capacity == TELEMETRY_CAPACITY ? " tramas en PSRAM" : " tramas en RAM interna");
+}
+
+/**
+ * @brief Añade una trama al buffer circular (solo desde la tarea de control)
+ * Nunca bloquea ni reserva memoria: si el buffer está lleno la trama se descarta
+ *
+ * @param frame Trama a añadir; se le asigna el número de secuencia
+ * @return true Si la trama se guardó
+ * @return false Si el envío está desactivado o el buffer está lleno
+ */
+bool telemetry_push(telemetry_frame_t *frame) {
+  if (!telemetry_streaming || telemetry_buffer == NULL) {
+    return false;
+  }
+
+  frame->seq = telemetry_seq++;
+  uint32_t head = telemetry_head.load(std::memory_order_relaxed);
+  if (head - telemetry_tail.load(std::memory_order_acquire) > telemetry_mask) {
+    telemetry_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  telemetry_buffer[head & telemetry_mask] = *frame;
+  telemetry_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Activa o desactiva el envío binario de telemetría
+ *
+ * @param streaming true para enviar
+ */
+void set_telemetry_streaming(bool streaming) {
+  telemetry_streaming = streaming;
+  Serial.print("Telemetria: ");
+  Serial.println(streaming ? "enviando" : "detenida");
+}
+
+/**
+ * @brief Comprueba si el envío de telemetría está activo
+ *
+ * @return true Enviando
+ * @return false Detenida
+ */
+bool is_telemetry_streaming() {
+  return telemetry_streaming;
+}
+
+/**
+ * @brief Obtiene las tramas descartadas por buffer lleno
+ *
+ * @return unsigned long Tramas descartadas desde el arranque
+ */
+unsigned long get_telemetry_dropped() {
+  return telemetry_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Imprime el estado de la telemetría
+ *
+ */
+void print_telemetry_status() {
+  Serial.print("Telemetria: ");
+  Serial.print(telemetry_streaming ? "enviando" : "detenida");
+  Serial.print(" | Tramas: ");
+  Serial.print(telemetry_seq);
+  Serial.print(" | Descartadas: ");
+  Serial.print(get_telemetry_dropped());
+  Serial.print(" | Capacidad: ");
+  Serial.println(telemetry_mask + 1);
+}
@@ -0,0 +1,303 @@
+#include <track_map.h>
+#include <control.h>
+
+static volatile TRACK_MAP_MODES track_map_mode = TRACK_MAP_OFF;
+
+static int8_t map_curvature[TRACK_MAP_BINS];
+static uint8_t map_profile[TRACK_MAP_BINS];
+static int map_bins = 0;
+
+static int map_speed_straight = TRACK_MAP_SPEED_STRAIGHT;
+static int map_speed_curve = TRACK_MAP_SPEED_CURVE;
+
+// Estado de la vuelta en curso (solo lo toca la tarea de control)
+static int32_t motor_speed_q8 = 0;
+static int32_t distance_units = 0;
+static int current_bin = 0;
+static int32_t bin_curvature_sum = 0;
+static int32_t bin_samples = 0;
+static bool map_closed = false;
+
+/**
+ * @brief Velocidad objetivo de un tramo según su curvatura
+ * Interpola linealmente entre la velocidad de recta y la de curva
+ *
+ * @param curvature Curvatura del tramo en Q7
+ * @return int Velocidad (0-100%)
+ */
+static int curvature_to_speed(int curvature) {
+  int k = abs(curvature);
+  if (k <= TRACK_MAP_STRAIGHT_K) {
+    return map_speed_straight;
+  }
+  if (k >= TRACK_MAP_CURVE_K) {
+    return map_speed_curve;
+  }
+  return map_speed_straight - (map_speed_straight - map_speed_curve) * (k - TRACK_MAP_STRAIGHT_K) /
+                                  (TRACK_MAP_CURVE_K - TRACK_MAP_STRAIGHT_K);
+}
+
+/**
+ * @brief Calcula el perfil de velocidad a partir de la curvatura del mapa
+ * El mapa es una vuelta cerrada: tras el último tramo viene el primero
+ * 1. Velocidad por curvatura, tomando el mínimo de los tramos de anticipación
+ * 2. Pasada hacia atrás: puntos de frenado antes de cada curva
+ * 3. Pasada hacia delante: aceleración limitada a la salida de las curvas
+ *
+ */
+static void update_track_map_profile() {
+  if (map_bins < TRACK_MAP_MIN_BINS) {
+    return;
+  }
+  for (int bin = 0; bin < map_bins; bin++) {
+    int speed = 100;
+    for (int ahead = 0; ahead <= TRACK_MAP_LOOKAHEAD_BINS; ahead++) {
+      speed = min(speed, curvature_to_speed(map_curvature[(bin + ahead) % map_bins]));
+    }
+    map_profile[bin] = speed;
+  }
+  // Dos vueltas en cada sentido para propagar las frenadas y aceleraciones a través de la meta
+  for (int i = 2 * map_bins - 1; i > 0; i--) {
+    int bin = (i - 1) % map_bins;
+    int next = i % map_bins;
+    map_profile[bin] = min((int)map_profile[bin], map_profile[next] + TRACK_MAP_BRAKE_PER_BIN);
+  }
+  for (int i = 1; i < 2 * map_bins; i++) {
+    int bin = i % map_bins;
+    int previous = (i - 1) % map_bins;
+    map_profile[bin] = min((int)map_profile[bin], map_profile[previous] + TRACK_MAP_ACCEL_PER_BIN);
+  }
+}
+
+/**
+ * @brief Selecciona el modo del mapa de pista
+ * REPLAY solo es posible con un mapa grabado
+ *
+ * @param mode Modo del mapa
+ */
+void set_track_map_mode(TRACK_MAP_MODES mode) {
+  if (mode == TRACK_MAP_REPLAY && map_bins < TRACK_MAP_MIN_BINS) {
+    Serial.println("Mapa: no hay mapa grabado, ejecuta primero una vuelta de aprendizaje");
+    return;
+  }
+  track_map_mode = mode;
+  Serial.print("Mapa: ");
+  Serial.println(mode == TRACK_MAP_LEARN ? "aprendizaje en la siguiente carrera"
+                                         : (mode == TRACK_MAP_REPLAY ? "perfil de velocidad activo" : "desactivado"));
+}
+
+/**
+ * @brief Obtiene el modo del mapa de pista
+ *
+ * @return TRACK_MAP_MODES Modo actual
+ */
+TRACK_MAP_MODES get_track_map_mode() {
+  return track_map_mode;
+}
+
+/**
+ * @brief Establece las velocidades de recta y curva y recalcula el perfil
+ *
+ * @param straight_speed Velocidad en rectas (0-100%)
+ * @param curve_speed Velocidad en las curvas más cerradas (0-100%)
+ */
+void set_track_map_speeds(int straight_speed, int curve_speed) {
+  map_speed_straight = constrain(straight_speed, 0, 100);
+  map_speed_curve = constrain(curve_speed, 0, map_speed_straight);
+  update_track_map_profile();
+}
+
+int get_track_map_straight_speed() {
+  return map_speed_straight;
+}
+
+int get_track_map_curve_speed() {
+  return map_speed_curve;
+}
+
+/**
+ * @brief Vuelve al primer tramo sin tocar la velocidad estimada de los motores
+ *
+ */
+static void restart_distance() {
+  distance_units = 0;
+  current_bin = 0;
+  bin_curvature_sum = 0;
+  bin_samples = 0;
+}
+
+/**
+ * @brief Guarda la curvatura media del tramo actual en el mapa que se está grabando
+ *
+ */
+static void close_learning_bin() {
+  if (current_bin < TRACK_MAP_BINS) {
+    map_curvature[current_bin] = bin_samples > 0 ? constrain(bin_curvature_sum / bin_samples, -127, 127) : 0;
+    map_bins = current_bin + 1;
+  }
+}
+
+/**
+ * @brief Reinicia la distancia al comenzar la carrera (desde la tarea de control)
+ * En aprendizaje descarta el mapa anterior
+ *
+ */
+void track_map_start() {
+  motor_speed_q8 = 0;
+  restart_distance();
+  map_closed = false;
+  if (track_map_mode == TRACK_MAP_LEARN) {
+    map_bins = 0;
+  }
+}
+
+/**
+ * @brief Paso por la línea de meta (desde la tarea de control, con laps_crossed_line)
+ * El mapa es una vuelta de meta a meta: en aprendizaje el cruce que abre la vuelta 1 empieza el
+ * mapa y el que la cierra lo termina, aunque la carrera siga; al reproducir, cada cruce vuelve
+ * al primer tramo para que el error de la distancia estimada no se acumule entre vueltas
+ *
+ * @param laps Vueltas completadas tras el cruce (0: el cruce abre la vuelta 1)
+ */
+void track_map_lap(int laps) {
+  if (track_map_mode == TRACK_MAP_LEARN) {
+    if (map_closed) {
+      return;
+    }
+    if (laps > 0) {
+      close_learning_bin();
+      map_closed = true;
+      return;
+    }
+    map_bins = 0;
+  }
+  if (track_map_mode != TRACK_MAP_OFF) {
+    restart_distance();
+  }
+}
+
+/**
+ * @brief Avanza la distancia estimada y, en aprendizaje, acumula la curvatura del tramo actual
+ * Se llama una vez por ciclo de control con las velocidades pedidas a los motores (al frenar, las
+ * de antes de sustituirlas por el par de freno)
+ *
+ * @param left_speed Velocidad del motor izquierdo (-100 a 100%)
+ * @param right_speed Velocidad del motor derecho (-100 a 100%)
+ */
+void track_map_update(int left_speed, int right_speed) {
+  if (track_map_mode == TRACK_MAP_OFF) {
+    return;
+  }
+  left_speed = constrain(left_speed, -100, 100);
+  right_speed = constrain(right_speed, -100, 100);
+
+  // Velocidad real aproximada: primer orden sobre la velocidad media aplicada
+  int32_t command_q8 = ((left_speed + right_speed) * 256) / 2;
+  motor_speed_q8 += (command_q8 - motor_speed_q8) >> TRACK_MAP_MOTOR_SHIFT;
+  if (motor_speed_q8 > 0) {
+    distance_units += (motor_speed_q8 * (int32_t)get_control_period_us() / 1000) >> 8;
+  }
+
+  bool learning = track_map_mode == TRACK_MAP_LEARN && !map_closed;
+  if (learning && left_speed + right_speed > 0 && map_bins < TRACK_MAP_BINS) {
+    bin_curvature_sum += (127 * (left_speed - right_speed)) / (left_speed + right_speed);
+    bin_samples++;
+  }
+
+  int bin = distance_units / TRACK_MAP_BIN_UNITS;
+  if (bin != current_bin) {
+    if (learning) {
+      close_learning_bin();
+    }
+    current_bin = bin;
+    bin_curvature_sum = 0;
+    bin_samples = 0;
+  }
+}
+
+/**
+ * @brief Cierra la carrera (desde la tarea de control)
+ * Tras una vuelta de aprendizaje calcula el perfil y pasa a reproducirlo; si no se llegó a
+ * cerrar la vuelta en la meta el mapa cubre toda la carrera
+ *
+ */
+void track_map_stop() {
+  if (track_map_mode != TRACK_MAP_LEARN) {
+    return;
+  }
+  if (!map_closed) {
+    Serial.println("Mapa: sin vuelta completa de meta a meta, se usa toda la carrera");
+  }
+  if (map_bins < TRACK_MAP_MIN_BINS) {
+    map_bins = 0;
+    Serial.println("Mapa: vuelta de aprendizaje demasiado corta, mapa descartado");
+    return;
+  }
+  update_track_map_profile();
+  track_map_mode = TRACK_MAP_REPLAY;
+  Serial.print("Mapa grabado: ");
+  Serial.print(map_bins);
+  Serial.println(" tramos, perfil de velocidad activo");
+}
+
+/**
+ * @brief Velocidad objetivo en la posición actual de la pista
+ * Cada paso por meta vuelve al primer tramo; si la distancia estimada supera la longitud del
+ * mapa antes de llegar a la meta se sigue por el principio
+ *
+ * @param base_speed Velocidad base (fuera del mapa o sin reproducir)
+ * @return int Velocidad objetivo (0-100%)
+ */
+int get_track_map_speed(int base_speed) {
+  if (track_map_mode != TRACK_MAP_REPLAY) {
+    return base_speed;
+  }
+  return map_profile[current_bin % map_bins];
+}
+
+/**
+ * @brief Imprime el mapa agrupado en segmentos de recta y curva con su velocidad
+ *
+ */
+void print_track_map() {
+  Serial.println("==============================================");
+  Serial.print("MAPA DE PISTA (");
+  Serial.print(map_bins);
+  Serial.print(" tramos de ");
+  Serial.print(TRACK_MAP_BIN_UNITS);
+  Serial.println(" unidades)");
+  Serial.print("Recta: ");
+  Serial.print(map_speed_straight);
+  Serial.print("% | Curva: ");
+  Serial.print(map_speed_curve);
+  Serial.println("%");
+  Serial.println("Tipo\t| Inicio\t| Tramos\t| Curvatura\t| Vel. min");
+
+  int segments = 0;
+  int start = 0;
+  while (start < map_bins && segments < TRACK_MAP_MAX_SEGMENTS) {
+    bool straight = abs(map_curvature[start]) <= TRACK_MAP_STRAIGHT_K;
+    int end = start;
+    int peak = 0;
+    int slowest = 100;
+    while (end < map_bins && (abs(map_curvature[end]) <= TRACK_MAP_STRAIGHT_K) == straight) {
+      if (abs(map_curvature[end]) > abs(peak)) {
+        peak = map_curvature[end];
+      }
+      slowest = min(slowest, (int)map_profile[end]);
+      end++;
+    }
+    Serial.print(straight ? "Recta" : (peak > 0 ? "Curva D" : "Curva I"));
+    Serial.print("\t| ");
+    Serial.print(start);
+    Serial.print("\t\t| ");
+    Serial.print(end - start);
+    Serial.print("\t\t| ");
+    Serial.print(peak);
+    Serial.print("\t\t| ");
+    Serial.println(slowest);
+    start = end;
+    segments++;
+  }
+  Serial.println("==============================================");
+}
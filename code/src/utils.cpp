@@ -1,10 +1,11 @@
 #include <utils.h>
+#include <hal.h>
 
 static long btn_pressed_start_ms = 0;
 static bool btn_last_state = false;
 static BTN_STATES btn_current_state = BTN_IDLE;
 
-static long last_blink_ms = 0;
+static unsigned long last_blink_ms = 0;
 static bool led_blink_state = false;
 
 /**
@@ -12,13 +13,13 @@ static bool led_blink_state = false;
  *
  */
 void init_utils() {
-  pinMode(BUTTON_PIN, INPUT_PULLUP);  // Botón con pull-up interno
-  pinMode(START_SIGNAL_PIN, INPUT);    // Señal de start
-  pinMode(LED_PIN, OUTPUT);            // LED
-  pinMode(FAN_PIN, OUTPUT);            // Turbina
+  hal_gpio_input(BUTTON_PIN, true);        // Botón con pull-up interno
+  hal_gpio_input(START_SIGNAL_PIN, false); // Señal de start
+  hal_gpio_output(LED_PIN);                // LED
+  hal_gpio_output(FAN_PIN);                // Turbina
 
-  digitalWrite(LED_PIN, LOW);
-  digitalWrite(FAN_PIN, LOW);
+  hal_gpio_write(LED_PIN, LOW);
+  hal_gpio_write(FAN_PIN, LOW);
 }
 
 /**
@@ -27,16 +28,16 @@ void init_utils() {
  * @return BTN_STATES Estado actual del botón
  */
 BTN_STATES get_btn_state() {
-  bool btn_reading = !digitalRead(BUTTON_PIN); // Invertido porque usa pull-up
+  bool btn_reading = !hal_gpio_read(BUTTON_PIN); // Invertido porque usa pull-up
 
   // Detección de flanco
   if (btn_reading && !btn_last_state) {
     // Botón recién presionado
-    btn_pressed_start_ms = millis();
+    btn_pressed_start_ms = hal_millis();
     btn_current_state = BTN_PRESSING;
   } else if (!btn_reading && btn_last_state) {
     // Botón recién liberado
-    long press_duration = millis() - btn_pressed_start_ms;
+    long press_duration = hal_millis() - btn_pressed_start_ms;
 
     if (press_duration >= BTN_LONG_PRESS_MS) {
       btn_current_state = BTN_LONG_PRESSED;
@@ -71,7 +72,7 @@ BTN_STATES get_btn_state() {
  */
 long get_btn_pressing_ms() {
   if (btn_current_state == BTN_PRESSING) {
-    return millis() - btn_pressed_start_ms;
+    return hal_millis() - btn_pressed_start_ms;
   }
   return 0;
 }
@@ -83,7 +84,7 @@ long get_btn_pressing_ms() {
  * @return false Si la señal está inactiva
  */
 bool get_start_signal() {
-  return digitalRead(START_SIGNAL_PIN);
+  return hal_gpio_read(START_SIGNAL_PIN);
 }
 
 /**
@@ -92,7 +93,7 @@ bool get_start_signal() {
  * @param state true=encendido, false=apagado
  */
 void set_led(bool state) {
-  digitalWrite(LED_PIN, state ? HIGH : LOW);
+  hal_gpio_write(LED_PIN, state ? HIGH : LOW);
   led_blink_state = state;
 }
 
@@ -101,11 +102,11 @@ void set_led(bool state) {
  *
  * @param interval_ms Intervalo de parpadeo en ms
  */
-void blink_led(int interval_ms) {
-  if (millis() - last_blink_ms >= interval_ms) {
+void blink_led(unsigned long interval_ms) {
+  if (hal_millis() - last_blink_ms >= interval_ms) {
     led_blink_state = !led_blink_state;
-    digitalWrite(LED_PIN, led_blink_state ? HIGH : LOW);
-    last_blink_ms = millis();
+    hal_gpio_write(LED_PIN, led_blink_state ? HIGH : LOW);
+    last_blink_ms = hal_millis();
   }
 }
 
@@ -0,0 +1,158 @@
+#include <unity.h>
+#include <command_parser.h>
+#include <esp_rom_crc.h>
+
+static command_parser_result_t result;
+
+/**
+ * @brief Entrega los bytes al analizador
+ *
+ * @return COMMAND_PARSER_EVENTS Último evento distinto de COMMAND_PARSER_NONE
+ */
+static COMMAND_PARSER_EVENTS feed(const uint8_t *bytes, size_t length) {
+  COMMAND_PARSER_EVENTS last = COMMAND_PARSER_NONE;
+  for (size_t i = 0; i < length; i++) {
+    COMMAND_PARSER_EVENTS event = command_parser_feed(bytes[i], &result);
+    if (event != COMMAND_PARSER_NONE) {
+      last = event;
+    }
+  }
+  return last;
+}
+
+static COMMAND_PARSER_EVENTS feed_text(const char *text) {
+  return feed((const uint8_t *)text, strlen(text));
+}
+
+/**
+ * @brief Comando binario con el encuadre de commands.h
+ *
+ * @return size_t Bytes de la trama
+ */
+static size_t binary_frame(uint8_t *frame, uint8_t id, const float *value) {
+  uint8_t length = value != NULL ? sizeof(float) : 0;
+  frame[0] = COMMANDS_SYNC_0;
+  frame[1] = COMMANDS_SYNC_1;
+  frame[2] = id;
+  frame[3] = length;
+  if (value != NULL) {
+    memcpy(&frame[4], value, sizeof(float));
+  }
+  uint16_t crc = esp_rom_crc16_le(0, &frame[2], 2 + length);
+  frame[4 + length] = crc & 0xFF;
+  frame[5 + length] = crc >> 8;
+  return 6 + length;
+}
+
+void setUp() {
+  command_parser_reset();
+  memset(&result, 0, sizeof(result));
+}
+
+void tearDown() {}
+
+void test_crc16_matches_rom() {
+  // Valor de comprobación del CRC-16/X-25, el que da esp_rom_crc16_le con semilla 0
+  const char *check = "123456789";
+  TEST_ASSERT_EQUAL_HEX16(0x906E, esp_rom_crc16_le(0, (const uint8_t *)check, strlen(check)));
+}
+
+void test_text_line() {
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("v40\n"));
+  TEST_ASSERT_EQUAL_STRING("v40", result.text);
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("  kp0.3 \r"));
+  TEST_ASSERT_EQUAL_STRING("kp0.3", result.text);
+}
+
+void test_text_incomplete_until_end_of_line() {
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_NONE, feed_text("bench"));
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("s\n"));
+  TEST_ASSERT_EQUAL_STRING("benchs", result.text);
+}
+
+void test_text_too_long_is_discarded() {
+  char line[COMMANDS_BUFFER_SIZE + 8];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\0';
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TOO_LONG, feed_text(line));
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_NONE, feed_text("v40\n"));
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("v50\n"));
+  TEST_ASSERT_EQUAL_STRING("v50", result.text);
+}
+
+void test_binary_with_value() {
+  uint8_t frame[16];
+  float value = 40.5f;
+  size_t length = binary_frame(frame, CMD_SPEED, &value);
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_BINARY, feed(frame, length));
+  TEST_ASSERT_EQUAL_UINT8(CMD_SPEED, result.id);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(float), result.length);
+  TEST_ASSERT_EQUAL_FLOAT(40.5f, result.value);
+}
+
+void test_binary_without_value() {
+  uint8_t frame[16];
+  result.value = 1;
+  size_t length = binary_frame(frame, CMD_STOP, NULL);
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_BINARY, feed(frame, length));
+  TEST_ASSERT_EQUAL_UINT8(CMD_STOP, result.id);
+  TEST_ASSERT_EQUAL_UINT8(0, result.length);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.value);
+}
+
+void test_binary_bad_crc() {
+  uint8_t frame[16];
+  float value = 40;
+  size_t length = binary_frame(frame, CMD_SPEED, &value);
+  frame[length - 1] ^= 0x01;
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_BAD_CRC, feed(frame, length));
+  frame[length - 1] ^= 0x01;
+  frame[4] ^= 0x80;
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_BAD_CRC, feed(frame, length));
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("x\n"));
+  TEST_ASSERT_EQUAL_STRING("x", result.text);
+}
+
+void test_binary_length_too_long_returns_to_text() {
+  const uint8_t frame[] = {COMMANDS_SYNC_0, COMMANDS_SYNC_1, CMD_SPEED, COMMANDS_MAX_PAYLOAD + 1};
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_NONE, feed(frame, sizeof(frame)));
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed_text("x\n"));
+  TEST_ASSERT_EQUAL_STRING("x", result.text);
+}
+
+void test_resync_after_repeated_sync_byte() {
+  uint8_t frame[16];
+  frame[0] = COMMANDS_SYNC_0;
+  size_t length = 1 + binary_frame(&frame[1], CMD_START, NULL);
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_BINARY, feed(frame, length));
+  TEST_ASSERT_EQUAL_UINT8(CMD_START, result.id);
+}
+
+void test_false_sync_byte_is_text() {
+  const uint8_t line[] = {COMMANDS_SYNC_0, 's', '\n'};
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_TEXT, feed(line, sizeof(line)));
+  TEST_ASSERT_EQUAL_STRING("s", result.text);
+}
+
+void test_sync_only_at_start_of_line() {
+  uint8_t frame[16];
+  size_t length = binary_frame(frame, CMD_START, NULL);
+  TEST_ASSERT_EQUAL(COMMAND_PARSER_NONE, feed_text("v"));
+  TEST_ASSERT_NOT_EQUAL(COMMAND_PARSER_BINARY, feed(frame, length));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc16_matches_rom);
+  RUN_TEST(test_text_line);
+  RUN_TEST(test_text_incomplete_until_end_of_line);
+  RUN_TEST(test_text_too_long_is_discarded);
+  RUN_TEST(test_binary_with_value);
+  RUN_TEST(test_binary_without_value);
+  RUN_TEST(test_binary_bad_crc);
+  RUN_TEST(test_binary_length_too_long_returns_to_text);
+  RUN_TEST(test_resync_after_repeated_sync_byte);
+  RUN_TEST(test_false_sync_byte_is_text);
+  RUN_TEST(test_sync_only_at_start_of_line);
+  return UNITY_END();
+}
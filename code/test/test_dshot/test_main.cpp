@@ -0,0 +1,99 @@
+#include <unity.h>
+#include <motors.h>
+
+/**
+ * @brief Respuesta del ESC en DShot bidireccional a partir de la trama de 16 bits
+ * Cada nibble pasa a 5 bits GCR y cada 1 de GCR es un cambio de nivel en la línea
+ *
+ * @param packet Valor eeem mmmm mmmm y CRC de 4 bits
+ * @return uint32_t Niveles de la línea (21 bits, el primero en el bit 20)
+ */
+static uint32_t encode_response(uint16_t packet) {
+  static const uint8_t gcr_codes[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F,
+  };
+  uint32_t gcr = 0;
+  for (int nibble = 3; nibble >= 0; nibble--) {
+    gcr = (gcr << 5) | gcr_codes[(packet >> (nibble * 4)) & 0x0F];
+  }
+  uint32_t levels = 1UL << 20;
+  for (int bit = 19; bit >= 0; bit--) {
+    uint32_t previous = (levels >> (bit + 1)) & 1;
+    levels |= (previous ^ ((gcr >> bit) & 1)) << bit;
+  }
+  return levels;
+}
+
+static uint16_t erpm_packet(uint16_t value) {
+  uint16_t crc = ~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F;
+  return (value << 4) | crc;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_frame_carries_value_and_telemetry_bit() {
+  uint16_t values[] = {0, DSHOT_THROTTLE_MIN, 1046, 2047};
+  for (uint16_t value : values) {
+    TEST_ASSERT_EQUAL_UINT16(value << 1, dshot_frame(value) >> 4);
+  }
+}
+
+void test_frame_crc() {
+  // Ejemplo de la especificación: 1046 sin telemetría = 0x82C6 (CRC invertido en bidireccional)
+  TEST_ASSERT_EQUAL_HEX16(FAN_DSHOT_BIDIRECTIONAL ? 0x82C9 : 0x82C6, dshot_frame(1046));
+  TEST_ASSERT_EQUAL_HEX16(FAN_DSHOT_BIDIRECTIONAL ? 0x000F : 0x0000, dshot_frame(0));
+  for (uint16_t value = 0; value < 2048; value++) {
+    uint16_t frame = dshot_frame(value);
+    uint16_t crc = (frame ^ (frame >> 4) ^ (frame >> 8) ^ (frame >> 12)) & 0x0F;
+    TEST_ASSERT_EQUAL_HEX16(FAN_DSHOT_BIDIRECTIONAL ? 0x0F : 0x00, crc);
+  }
+}
+
+void test_decode_erpm() {
+  uint32_t erpm = 0;
+  // Periodo 250 << 2 = 1000 μs
+  TEST_ASSERT_TRUE(dshot_decode_erpm(encode_response(erpm_packet((2 << 9) | 250)), &erpm));
+  TEST_ASSERT_EQUAL_UINT32(60000, erpm);
+  // Periodo 100 << 0 = 100 μs
+  TEST_ASSERT_TRUE(dshot_decode_erpm(encode_response(erpm_packet(100)), &erpm));
+  TEST_ASSERT_EQUAL_UINT32(600000, erpm);
+}
+
+void test_decode_stopped_motor() {
+  uint32_t erpm = 1;
+  TEST_ASSERT_TRUE(dshot_decode_erpm(encode_response(erpm_packet(0x0FFF)), &erpm));
+  TEST_ASSERT_EQUAL_UINT32(0, erpm);
+}
+
+void test_decode_independent_of_idle_level() {
+  uint32_t erpm = 0;
+  uint32_t levels = encode_response(erpm_packet((2 << 9) | 250));
+  TEST_ASSERT_TRUE(dshot_decode_erpm(~levels & 0x1FFFFF, &erpm));
+  TEST_ASSERT_EQUAL_UINT32(60000, erpm);
+}
+
+void test_decode_rejects_bad_crc() {
+  uint32_t erpm = 0;
+  TEST_ASSERT_FALSE(dshot_decode_erpm(encode_response(erpm_packet((2 << 9) | 250) ^ 0x01), &erpm));
+}
+
+void test_decode_rejects_invalid_gcr() {
+  uint32_t erpm = 0;
+  // Línea sin cambios: el código GCR 00000 no corresponde a ningún nibble
+  TEST_ASSERT_FALSE(dshot_decode_erpm(0, &erpm));
+  TEST_ASSERT_FALSE(dshot_decode_erpm(0x1FFFFF, &erpm));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_carries_value_and_telemetry_bit);
+  RUN_TEST(test_frame_crc);
+  RUN_TEST(test_decode_erpm);
+  RUN_TEST(test_decode_stopped_motor);
+  RUN_TEST(test_decode_independent_of_idle_level);
+  RUN_TEST(test_decode_rejects_bad_crc);
+  RUN_TEST(test_decode_rejects_invalid_gcr);
+  return UNITY_END();
+}
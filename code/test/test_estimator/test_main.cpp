@@ -0,0 +1,118 @@
+#include <unity.h>
+#include <estimator.h>
+#include <control.h>
+
+#define MEASUREMENT_SIGMA 2.0f
+
+static estimator_state_t state;
+
+void setUp() {
+  set_estimator_process_noise(ESTIMATOR_PROCESS_NOISE);
+  estimator_start(MEASUREMENT_SIGMA);
+}
+
+void tearDown() {}
+
+void test_first_frame_sets_position() {
+  estimator_update(40, 1000);
+  get_estimator_state(&state);
+  TEST_ASSERT_TRUE(state.ready);
+  TEST_ASSERT_EQUAL_FLOAT(40, state.position);
+  TEST_ASSERT_EQUAL_FLOAT(0, state.rate);
+  TEST_ASSERT_EQUAL_FLOAT(MEASUREMENT_SIGMA * MEASUREMENT_SIGMA, state.covariance_pp);
+  TEST_ASSERT_EQUAL_FLOAT(ESTIMATOR_RATE_VARIANCE, state.covariance_rr);
+}
+
+void test_minimum_measurement_sigma() {
+  estimator_start(0);
+  get_estimator_state(&state);
+  TEST_ASSERT_EQUAL_FLOAT(ESTIMATOR_MEASUREMENT_SIGMA_MIN * ESTIMATOR_MEASUREMENT_SIGMA_MIN, state.measurement_variance);
+}
+
+void test_update_matches_kalman_equations() {
+  const float r = MEASUREMENT_SIGMA * MEASUREMENT_SIGMA;
+  const float q = ESTIMATOR_PROCESS_NOISE;
+  estimator_update(10, 1000);
+  estimator_update(16, 1000 + CONTROL_REFERENCE_US);
+
+  // Predicción con dt = 1 desde P = [r 0; 0 ESTIMATOR_RATE_VARIANCE] y corrección con la medida
+  float pp = r + ESTIMATOR_RATE_VARIANCE + q / 3;
+  float pr = ESTIMATOR_RATE_VARIANCE + q / 2;
+  float rr = ESTIMATOR_RATE_VARIANCE + q;
+  float gain_position = pp / (pp + r);
+  float gain_rate = pr / (pp + r);
+  get_estimator_state(&state);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 10 + gain_position * 6, state.position);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, gain_rate * 6, state.rate);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, (1 - gain_position) * pp, state.covariance_pp);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, (1 - gain_position) * pr, state.covariance_pr);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, rr - gain_rate * pr, state.covariance_rr);
+  TEST_ASSERT_EQUAL_UINT32(1000 + CONTROL_REFERENCE_US, state.us);
+}
+
+void test_tracks_constant_rate() {
+  unsigned long us = 1000;
+  for (int frame = 0; frame < 400; frame++) {
+    estimator_update(-200 + frame, us);
+    us += CONTROL_REFERENCE_US;
+  }
+  get_estimator_state(&state);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 1.0f, state.rate);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 199, state.position);
+}
+
+void test_covariance_converges_below_measurement() {
+  unsigned long us = 1000;
+  for (int frame = 0; frame < 200; frame++) {
+    estimator_update(frame % 2 == 0 ? 3 : -3, us);
+    us += CONTROL_REFERENCE_US;
+  }
+  get_estimator_state(&state);
+  TEST_ASSERT_LESS_THAN_FLOAT(state.measurement_variance, state.covariance_pp);
+  TEST_ASSERT_GREATER_THAN_FLOAT(0, state.covariance_pp);
+  TEST_ASSERT_GREATER_THAN_FLOAT(0, state.covariance_rr);
+  TEST_ASSERT_GREATER_THAN_FLOAT(0, state.covariance_pp * state.covariance_rr - state.covariance_pr * state.covariance_pr);
+  TEST_ASSERT_FLOAT_WITHIN(3, 0, state.position);
+}
+
+void test_predict_extrapolates_with_rate() {
+  float rate = 1;
+  TEST_ASSERT_EQUAL_FLOAT(0, estimator_predict(5000, 0, &rate));
+  TEST_ASSERT_EQUAL_FLOAT(0, rate);
+
+  unsigned long us = 1000;
+  for (int frame = 0; frame < 400; frame++) {
+    estimator_update(-200 + frame, us);
+    us += CONTROL_REFERENCE_US;
+  }
+  get_estimator_state(&state);
+  unsigned long last_us = state.us;
+  float predicted = estimator_predict(last_us + 2 * CONTROL_REFERENCE_US, CONTROL_REFERENCE_US, &rate);
+  TEST_ASSERT_EQUAL_FLOAT(state.rate, rate);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, state.position + 3 * state.rate, predicted);
+
+  // Sin tramas nuevas la extrapolación se limita a ESTIMATOR_MAX_HORIZON_US
+  float limited = estimator_predict(last_us + 1000000UL, 0, &rate);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, state.position + state.rate * ESTIMATOR_MAX_HORIZON_US / CONTROL_REFERENCE_US, limited);
+}
+
+void test_predict_is_clamped() {
+  float rate = 0;
+  estimator_update(SENSORS_POSITION_MAX, 1000);
+  estimator_update(SENSORS_POSITION_MAX, 1000 + CONTROL_REFERENCE_US);
+  estimator_update(SENSORS_POSITION_MAX, 1000 + 2 * CONTROL_REFERENCE_US);
+  estimator_update(SENSORS_POSITION_MAX + 50, 1000 + 3 * CONTROL_REFERENCE_US);
+  TEST_ASSERT_EQUAL_FLOAT(SENSORS_POSITION_MAX, estimator_predict(1000 + 6 * CONTROL_REFERENCE_US, 0, &rate));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_frame_sets_position);
+  RUN_TEST(test_minimum_measurement_sigma);
+  RUN_TEST(test_update_matches_kalman_equations);
+  RUN_TEST(test_tracks_constant_rate);
+  RUN_TEST(test_covariance_converges_below_measurement);
+  RUN_TEST(test_predict_extrapolates_with_rate);
+  RUN_TEST(test_predict_is_clamped);
+  return UNITY_END();
+}
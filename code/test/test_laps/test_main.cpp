@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <laps.h>
+#include <simulator.h>
+
+static uint64_t now_us = 0;
+static std::string output;
+
+/**
+ * @brief Avanza el reloj del simulador sin ejecutar el control
+ *
+ */
+static void advance_ms(unsigned long ms) {
+  now_us += ms * 1000ULL;
+  hal_native_replay_clock(now_us, now_us / 1000);
+}
+
+/**
+ * @brief Cruza la meta por la señal de START tras una vuelta de lap_ms
+ *
+ * @return true La carrera ha terminado
+ */
+static bool lap(unsigned long lap_ms, int position = 0) {
+  advance_ms(lap_ms);
+  laps_signal_mark();
+  return laps_update(position, false, false, 1000);
+}
+
+/**
+ * @brief Carrera completa de laps vueltas con tiempos y errores de hasta 32 bits
+ *
+ */
+static void race(int laps, unsigned long lap_ms) {
+  laps_start(255);
+  for (int i = 0; i < laps; i++) {
+    lap(lap_ms, 255);
+  }
+  laps_stop();
+}
+
+static int count_lines(const std::string &text) {
+  return std::count(text.begin(), text.end(), '\n');
+}
+
+void setUp() {
+  set_laps_source(LAPS_SOURCE_SIGNAL);
+  set_laps_target(0);
+  clear_laps_history();
+  laps_take_summary();
+  output.clear();
+}
+
+void tearDown() {
+  Serial.capture = nullptr;
+}
+
+void test_lap_times() {
+  set_laps_target(3);
+  laps_start(50);
+  TEST_ASSERT_FALSE(lap(1500));
+  TEST_ASSERT_TRUE(laps_crossed_line());
+  TEST_ASSERT_FALSE(lap(1400));
+  TEST_ASSERT_TRUE(lap(1600));
+  TEST_ASSERT_EQUAL(3, get_laps_count());
+  TEST_ASSERT_EQUAL_UINT32(1500, get_lap_stats(0)->time_ms);
+  TEST_ASSERT_EQUAL_UINT32(1400, get_lap_stats(1)->time_ms);
+  TEST_ASSERT_EQUAL_UINT32(1600, get_lap_stats(2)->time_ms);
+  TEST_ASSERT_NULL(get_lap_stats(3));
+}
+
+void test_marks_closer_than_min_lap_are_ignored() {
+  laps_start(50);
+  lap(1200);
+  TEST_ASSERT_FALSE(lap(LAPS_MIN_LAP_MS / 2));
+  TEST_ASSERT_FALSE(laps_crossed_line());
+  lap(1200);
+  TEST_ASSERT_EQUAL(2, get_laps_count());
+  TEST_ASSERT_EQUAL_UINT32(LAPS_MIN_LAP_MS / 2 + 1200, get_lap_stats(1)->time_ms);
+}
+
+void test_timeout_without_crossing() {
+  laps_start(50);
+  advance_ms(LAPS_TIMEOUT_MS - 1);
+  TEST_ASSERT_FALSE(laps_update(0, false, false, 1000));
+  advance_ms(1);
+  TEST_ASSERT_TRUE(laps_update(0, false, false, 1000));
+}
+
+void test_lap_statistics() {
+  laps_start(50);
+  lap(1000);
+  laps_update(-100, false, true, 1000);
+  laps_update(50, true, true, 1000);
+  laps_update(0, true, false, 1000);
+  laps_update(0, false, false, 1000);
+  laps_update(0, true, false, 1000);
+  lap(1000);
+  const lap_stats_t *stats = get_lap_stats(1);
+  TEST_ASSERT_EQUAL(100, stats->max_error);
+  TEST_ASSERT_EQUAL(2, stats->line_losses);
+  TEST_ASSERT_EQUAL_UINT32(2, stats->saturated_ms);
+  // La media incluye el ciclo del cruce que abre la vuelta: (100 + 50) / 6 en décimas
+  TEST_ASSERT_EQUAL(250, stats->mean_error);
+}
+
+void test_stop_adds_run_to_history() {
+  race(3, 2000);
+  TEST_ASSERT_TRUE(laps_take_summary());
+  TEST_ASSERT_FALSE(laps_take_summary());
+  laps_history_t history;
+  get_laps_history(&history);
+  TEST_ASSERT_EQUAL(1, history.count);
+  TEST_ASSERT_EQUAL(3, history.runs[0].laps);
+  TEST_ASSERT_EQUAL(255, history.runs[0].base_speed);
+  TEST_ASSERT_EQUAL_UINT32(2000, history.runs[0].best_ms);
+  TEST_ASSERT_EQUAL_UINT32(6000, history.runs[0].total_ms);
+}
+
+void test_history_keeps_newest_runs() {
+  laps_history_t history;
+  get_laps_history(&history);
+  uint16_t first_run = history.next_run;
+  for (int i = 0; i < LAPS_HISTORY + 2; i++) {
+    race(1, 1000);
+  }
+  get_laps_history(&history);
+  TEST_ASSERT_EQUAL(LAPS_HISTORY, history.count);
+  TEST_ASSERT_EQUAL(first_run + 2, history.runs[0].run);
+  TEST_ASSERT_EQUAL(first_run + LAPS_HISTORY + 1, history.runs[LAPS_HISTORY - 1].run);
+}
+
+void test_print_full_run() {
+  laps_start(255);
+  for (int i = 0; i < LAPS_MAX; i++) {
+    lap(4000000000UL, 255);
+  }
+  laps_stop();
+  Serial.capture = &output;
+  print_laps_run();
+  TEST_ASSERT_EQUAL(LAPS_MAX + 1, count_lines(output));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, output.find("\n    16 | 4000000000 |"));
+}
+
+void test_print_full_history() {
+  for (int i = 0; i < LAPS_HISTORY; i++) {
+    race(LAPS_MAX, 4000000000UL);
+  }
+  laps_history_t history;
+  get_laps_history(&history);
+  char newest[16];
+  snprintf(newest, sizeof(newest), "\n%7u |", history.runs[LAPS_HISTORY - 1].run);
+  Serial.capture = &output;
+  print_laps_history();
+  TEST_ASSERT_EQUAL(LAPS_HISTORY + 1, count_lines(output));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, output.find(newest));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_lap_times);
+  RUN_TEST(test_marks_closer_than_min_lap_are_ignored);
+  RUN_TEST(test_timeout_without_crossing);
+  RUN_TEST(test_lap_statistics);
+  RUN_TEST(test_stop_adds_run_to_history);
+  RUN_TEST(test_history_keeps_newest_runs);
+  RUN_TEST(test_print_full_run);
+  RUN_TEST(test_print_full_history);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+#include <markers.h>
+#include <sensors.h>
+
+static unsigned long frame_us = 0;
+
+/**
+ * @brief Clasifica una trama nueva (cada llamada avanza el instante una trama)
+ *
+ */
+static MARKER_TYPES classify(uint16_t detected, int last_position, uint16_t *line) {
+  frame_us += 1000;
+  return markers_classify(detected, last_position, frame_us, line);
+}
+
+void setUp() {
+  markers_reset();
+  frame_us = 0;
+}
+
+void tearDown() {}
+
+void test_line_only() {
+  uint16_t line = 0;
+  TEST_ASSERT_EQUAL(MARKER_NONE, classify(0x0180, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x0180, line);
+  TEST_ASSERT_EQUAL(MARKER_NONE, classify(0, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0, line);
+}
+
+void test_side_markers_are_excluded_from_the_line() {
+  uint16_t line = 0;
+  TEST_ASSERT_EQUAL(MARKER_LEFT, classify(0x0182, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x0180, line);
+  TEST_ASSERT_EQUAL(MARKER_RIGHT, classify(0x4180, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x0180, line);
+}
+
+void test_line_is_the_group_closest_to_last_position() {
+  uint16_t line = 0;
+  TEST_ASSERT_EQUAL(MARKER_RIGHT, classify(0x300C, -SENSORS_POSITION_MAX, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x000C, line);
+  TEST_ASSERT_EQUAL(MARKER_LEFT, classify(0x300C, SENSORS_POSITION_MAX, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x3000, line);
+}
+
+void test_crossing_and_wide_line_hold_position() {
+  uint16_t line = 0xFFFF;
+  TEST_ASSERT_EQUAL(MARKER_CROSSING, classify(0x4182, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0, line);
+  TEST_ASSERT_EQUAL(MARKER_CROSSING, classify(0x0FFC, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0, line);
+  TEST_ASSERT_EQUAL(MARKER_WIDE, classify(0x03E0, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0, line);
+}
+
+void test_hold_expires() {
+  uint16_t line = 0;
+  for (unsigned long elapsed_us = 0; elapsed_us < MARKERS_HOLD_MAX_MS * 1000UL; elapsed_us += 1000) {
+    TEST_ASSERT_EQUAL(MARKER_CROSSING, classify(0xFFFF, 0, &line));
+    TEST_ASSERT_EQUAL_HEX16(0, line);
+  }
+  TEST_ASSERT_EQUAL(MARKER_CROSSING, classify(0xFFFF, 0, &line));
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, line);
+}
+
+void test_same_frame_is_classified_once() {
+  uint16_t line = 0;
+  classify(0x0182, 0, &line);
+  TEST_ASSERT_EQUAL(MARKER_LEFT, markers_classify(0x0180, 0, frame_us, &line));
+  TEST_ASSERT_EQUAL_HEX16(0x0180, line);
+  TEST_ASSERT_EQUAL(MARKER_NONE, get_marker_active());
+}
+
+void test_event_after_confirm_frames() {
+  uint16_t line = 0;
+  marker_event_t event;
+  classify(0x0180, 0, &line);
+  unsigned long first_us = frame_us + 1000;
+  for (int frame = 0; frame < MARKERS_CONFIRM_FRAMES - 1; frame++) {
+    classify(0x4180, 0, &line);
+    TEST_ASSERT_FALSE(markers_pop_event(&event));
+  }
+  classify(0x4180, 0, &line);
+  TEST_ASSERT_EQUAL(MARKER_RIGHT, get_marker_active());
+  TEST_ASSERT_TRUE(markers_pop_event(&event));
+  TEST_ASSERT_EQUAL(MARKER_RIGHT, event.type);
+  TEST_ASSERT_EQUAL_UINT32(first_us, event.us);
+  TEST_ASSERT_FALSE(markers_pop_event(&event));
+  TEST_ASSERT_EQUAL_UINT32(1, get_marker_count(MARKER_RIGHT));
+}
+
+void test_event_release_after_release_frames() {
+  uint16_t line = 0;
+  for (int frame = 0; frame < MARKERS_CONFIRM_FRAMES; frame++) {
+    classify(0x0182, 0, &line);
+  }
+  TEST_ASSERT_EQUAL(MARKER_LEFT, get_marker_active());
+  for (int frame = 0; frame < MARKERS_RELEASE_FRAMES - 1; frame++) {
+    classify(0x0180, 0, &line);
+    TEST_ASSERT_EQUAL(MARKER_LEFT, get_marker_active());
+  }
+  classify(0x0180, 0, &line);
+  TEST_ASSERT_EQUAL(MARKER_NONE, get_marker_active());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_line_only);
+  RUN_TEST(test_side_markers_are_excluded_from_the_line);
+  RUN_TEST(test_line_is_the_group_closest_to_last_position);
+  RUN_TEST(test_crossing_and_wide_line_hold_position);
+  RUN_TEST(test_hold_expires);
+  RUN_TEST(test_same_frame_is_classified_once);
+  RUN_TEST(test_event_after_confirm_frames);
+  RUN_TEST(test_event_release_after_release_frames);
+  return UNITY_END();
+}
@@ -0,0 +1,76 @@
+#include <unity.h>
+#include <profiler.h>
+
+void setUp() {
+  Serial.quiet = true;
+  // El reinicio se aplica al empezar el siguiente ciclo
+  reset_profiler_stats();
+  profiler_loop_start(1000, 1);
+}
+
+void tearDown() {}
+
+void test_empty_stage() {
+  TEST_ASSERT_EQUAL_UINT32(0, get_profiler_percentile(STAGE_PID, 99));
+}
+
+void test_small_values_are_exact() {
+  for (uint32_t cycles = 1; cycles <= 7; cycles++) {
+    profiler_record(STAGE_PID, cycles);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, get_profiler_percentile(STAGE_PID, 20));
+  TEST_ASSERT_EQUAL_UINT32(4, get_profiler_percentile(STAGE_PID, 50));
+  TEST_ASSERT_EQUAL_UINT32(7, get_profiler_percentile(STAGE_PID, 100));
+}
+
+void test_percentile_error_bound() {
+  for (uint32_t cycles = 1; cycles <= 10000; cycles++) {
+    profiler_record(STAGE_PID, cycles);
+  }
+  int percentiles[] = {1, 10, 50, 90, 99};
+  uint32_t previous = 0;
+  for (int percentile : percentiles) {
+    uint32_t exact = 100 * percentile;
+    uint32_t estimate = get_profiler_percentile(STAGE_PID, percentile);
+    // Por exceso como mucho el ancho de la barra (1/8 de la octava)
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(exact, estimate);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(exact + exact / 8, estimate);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(previous, estimate);
+    previous = estimate;
+  }
+}
+
+void test_percentile_never_above_max() {
+  profiler_record(STAGE_PID, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1000, get_profiler_percentile(STAGE_PID, 99));
+  profiler_record(STAGE_PID, 0x80000001UL);
+  TEST_ASSERT_EQUAL_UINT32(0x80000001UL, get_profiler_percentile(STAGE_PID, 100));
+}
+
+void test_p99_ignores_rare_outliers() {
+  for (int i = 0; i < 1000; i++) {
+    profiler_record(STAGE_PID, 100);
+  }
+  for (int i = 0; i < 5; i++) {
+    profiler_record(STAGE_PID, 50000);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(100 + 100 / 8, get_profiler_percentile(STAGE_PID, 99));
+  TEST_ASSERT_EQUAL_UINT32(50000, get_profiler_percentile(STAGE_PID, 100));
+}
+
+void test_stages_are_independent() {
+  profiler_record(STAGE_MOTORS, 500);
+  TEST_ASSERT_EQUAL_UINT32(0, get_profiler_percentile(STAGE_PID, 99));
+  TEST_ASSERT_EQUAL_UINT32(500, get_profiler_percentile(STAGE_MOTORS, 99));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_stage);
+  RUN_TEST(test_small_values_are_exact);
+  RUN_TEST(test_percentile_error_bound);
+  RUN_TEST(test_percentile_never_above_max);
+  RUN_TEST(test_p99_ignores_rare_outliers);
+  RUN_TEST(test_stages_are_independent);
+  return UNITY_END();
+}
@@ -0,0 +1,115 @@
+#include <unity.h>
+#include <recovery.h>
+
+#define PERIOD_US 1000
+#define SPEED 60
+
+static int left_speed = 0;
+static int right_speed = 0;
+
+/**
+ * @brief Un ciclo de control con la velocidad de prueba
+ *
+ */
+static RECOVERY_STATES update(bool line_detected, int position = 0, long position_rate = 0, int correction = 0) {
+  return recovery_update(line_detected, position, position_rate, correction, SPEED, PERIOD_US, &left_speed,
+                         &right_speed);
+}
+
+/**
+ * @brief Ciclos sin línea hasta cumplir ms en el estado actual
+ *
+ */
+static RECOVERY_STATES lost_for_ms(unsigned long ms) {
+  RECOVERY_STATES state = get_recovery_state();
+  for (unsigned long i = 0; i < ms * 1000 / PERIOD_US; i++) {
+    state = update(false);
+  }
+  return state;
+}
+
+void setUp() {
+  Serial.quiet = true;
+  recovery_start();
+  left_speed = -1;
+  right_speed = -1;
+}
+
+void tearDown() {}
+
+void test_tracking_leaves_speeds_untouched() {
+  TEST_ASSERT_EQUAL(RECOVERY_TRACKING, update(true, 50, 0, 10));
+  TEST_ASSERT_EQUAL(-1, left_speed);
+  TEST_ASSERT_EQUAL(-1, right_speed);
+}
+
+void test_centered_loss_is_a_gap() {
+  update(true, 20, 0, 12);
+  TEST_ASSERT_EQUAL(RECOVERY_GAP, update(false));
+  // Mismo rumbo que antes del hueco
+  TEST_ASSERT_EQUAL(SPEED + 12, left_speed);
+  TEST_ASSERT_EQUAL(SPEED - 12, right_speed);
+}
+
+void test_side_loss_searches_towards_that_side() {
+  update(true, -200, 0, 0);
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH, update(false));
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH_SPEED - RECOVERY_SEARCH_TURN, left_speed);
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH_SPEED + RECOVERY_SEARCH_TURN, right_speed);
+}
+
+void test_trend_predicts_the_side() {
+  // Centrada pero moviéndose deprisa a la derecha: a RECOVERY_TREND_MS ya está fuera del hueco
+  long rate = (RECOVERY_GAP_POSITION + 10) * 1000L / RECOVERY_TREND_MS;
+  update(true, 0, rate, 0);
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH, update(false));
+  TEST_ASSERT_GREATER_THAN(right_speed, left_speed);
+}
+
+void test_states_time_out_in_order() {
+  update(true, 0, 0, 0);
+  TEST_ASSERT_EQUAL(RECOVERY_GAP, update(false));
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH, lost_for_ms(RECOVERY_GAP_MS));
+  TEST_ASSERT_EQUAL(RECOVERY_REVERSE, lost_for_ms(RECOVERY_SEARCH_MS));
+  TEST_ASSERT_LESS_THAN(0, left_speed + right_speed);
+  TEST_ASSERT_EQUAL(RECOVERY_ABORT, lost_for_ms(RECOVERY_REVERSE_MS));
+  TEST_ASSERT_EQUAL(0, left_speed);
+  TEST_ASSERT_EQUAL(0, right_speed);
+}
+
+void test_abort_is_final() {
+  update(true, 200, 0, 0);
+  update(false);
+  lost_for_ms(RECOVERY_SEARCH_MS + RECOVERY_REVERSE_MS);
+  TEST_ASSERT_EQUAL(RECOVERY_ABORT, get_recovery_state());
+  TEST_ASSERT_EQUAL(RECOVERY_ABORT, update(true, 0, 0, 0));
+  TEST_ASSERT_EQUAL(0, left_speed);
+}
+
+void test_line_found_returns_to_tracking() {
+  update(true, 200, 0, 0);
+  TEST_ASSERT_EQUAL(RECOVERY_SEARCH, update(false));
+  lost_for_ms(RECOVERY_SEARCH_MS);
+  TEST_ASSERT_EQUAL(RECOVERY_REVERSE, get_recovery_state());
+  TEST_ASSERT_EQUAL(RECOVERY_TRACKING, update(true, 150, 0, 0));
+}
+
+void test_search_speed_never_above_target() {
+  update(true, 200, 0, 0);
+  recovery_update(false, 0, 0, 0, 10, PERIOD_US, &left_speed, &right_speed);
+  TEST_ASSERT_EQUAL(10 + RECOVERY_SEARCH_TURN, left_speed);
+  TEST_ASSERT_EQUAL(10 - RECOVERY_SEARCH_TURN, right_speed);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_tracking_leaves_speeds_untouched);
+  RUN_TEST(test_centered_loss_is_a_gap);
+  RUN_TEST(test_side_loss_searches_towards_that_side);
+  RUN_TEST(test_trend_predicts_the_side);
+  RUN_TEST(test_states_time_out_in_order);
+  RUN_TEST(test_abort_is_final);
+  RUN_TEST(test_line_found_returns_to_tracking);
+  RUN_TEST(test_search_speed_never_above_target);
+  return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+#include <suction.h>
+
+#define PERIOD_US 1000
+
+static const int default_fan[SUCTION_SCHEDULE_POINTS] = SUCTION_SCHEDULE_FAN;
+
+/**
+ * @brief Un ciclo largo con la rampa máxima: el mando llega directamente al objetivo
+ *
+ * @return int Succión (0-100%)
+ */
+static int settle(int speed, int position, long position_rate, bool braking, int fan_max = 100) {
+  int ramp = get_suction_ramp();
+  set_suction_ramp(SUCTION_RAMP_MAX_PCT_PER_S);
+  suction_update(speed, position, position_rate, braking, fan_max, 1000000);
+  set_suction_ramp(ramp);
+  return get_suction_fan_speed();
+}
+
+void setUp() {
+  set_suction_enabled(true);
+  for (int point = 0; point < SUCTION_SCHEDULE_POINTS; point++) {
+    set_suction_fan(point, default_fan[point]);
+  }
+  set_suction_curve_gain(SUCTION_CURVE_GAIN);
+  set_suction_brake_boost(SUCTION_BRAKE_BOOST);
+  set_suction_ramp(SUCTION_RAMP_PCT_PER_S);
+  suction_reset();
+}
+
+void tearDown() {}
+
+void test_disabled_is_constant() {
+  set_suction_enabled(false);
+  TEST_ASSERT_EQUAL(80, settle(0, 255, 5000, true, 80));
+  TEST_ASSERT_EQUAL(80, settle(100, 0, 0, false, 80));
+}
+
+void test_straight_table_points() {
+  TEST_ASSERT_EQUAL(70, settle(0, 0, 0, false));
+  TEST_ASSERT_EQUAL(55, settle(40, 0, 0, false));
+  TEST_ASSERT_EQUAL(70, settle(80, 0, 0, false));
+  // Fuera de la tabla, el extremo
+  TEST_ASSERT_EQUAL(70, settle(100, 0, 0, false));
+}
+
+void test_straight_table_interpolation() {
+  TEST_ASSERT_EQUAL(62, settle(20, 0, 0, false));
+  TEST_ASSERT_EQUAL(64, settle(64, 0, 0, false));
+}
+
+void test_curve_from_position_or_rate() {
+  TEST_ASSERT_EQUAL(55 + SUCTION_CURVE_GAIN, settle(40, 255, 0, false));
+  TEST_ASSERT_EQUAL(55 + SUCTION_CURVE_GAIN, settle(40, -255, 0, false));
+  TEST_ASSERT_EQUAL(55 + SUCTION_CURVE_GAIN, settle(40, 0, -SUCTION_RATE_FULL * 2, false));
+  // La mayor de las dos fracciones, no la suma
+  int half = settle(40, 0, SUCTION_RATE_FULL / 2, false);
+  TEST_ASSERT_EQUAL(half, settle(40, 128, SUCTION_RATE_FULL / 2, false));
+  TEST_ASSERT_EQUAL(55 + SUCTION_CURVE_GAIN / 2, half);
+}
+
+void test_brake_boost() {
+  TEST_ASSERT_EQUAL(55 + SUCTION_BRAKE_BOOST, settle(40, 0, 0, true));
+}
+
+void test_limited_by_fan_max() {
+  TEST_ASSERT_EQUAL(60, settle(0, 255, 0, true, 60));
+  TEST_ASSERT_EQUAL(0, settle(0, 255, 0, true, 0));
+}
+
+void test_ramp() {
+  // 200 %/s: 0.2% por ciclo de 1 ms
+  for (int cycle = 0; cycle < 100; cycle++) {
+    suction_update(0, 0, 0, false, 100, PERIOD_US);
+  }
+  TEST_ASSERT_EQUAL(20, get_suction_fan_speed());
+  for (int cycle = 0; cycle < 1000; cycle++) {
+    suction_update(0, 0, 0, false, 100, PERIOD_US);
+  }
+  TEST_ASSERT_EQUAL(70, get_suction_fan_speed());
+  // Bajando también con rampa
+  for (int cycle = 0; cycle < 50; cycle++) {
+    suction_update(0, 0, 0, false, 50, PERIOD_US);
+  }
+  TEST_ASSERT_EQUAL(60, get_suction_fan_speed());
+}
+
+void test_reset_stops_the_fan() {
+  settle(0, 0, 0, false);
+  suction_reset();
+  TEST_ASSERT_EQUAL(0, get_suction_fan_speed());
+}
+
+void test_settings_are_clamped() {
+  set_suction_fan(0, 150);
+  TEST_ASSERT_EQUAL(100, get_suction_fan(0));
+  set_suction_fan(SUCTION_SCHEDULE_POINTS, 10);
+  TEST_ASSERT_EQUAL(default_fan[SUCTION_SCHEDULE_POINTS - 1], get_suction_fan(SUCTION_SCHEDULE_POINTS - 1));
+  set_suction_ramp(0);
+  TEST_ASSERT_EQUAL(1, get_suction_ramp());
+  set_suction_curve_gain(-5);
+  TEST_ASSERT_EQUAL(0, get_suction_curve_gain());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_disabled_is_constant);
+  RUN_TEST(test_straight_table_points);
+  RUN_TEST(test_straight_table_interpolation);
+  RUN_TEST(test_curve_from_position_or_rate);
+  RUN_TEST(test_brake_boost);
+  RUN_TEST(test_limited_by_fan_max);
+  RUN_TEST(test_ramp);
+  RUN_TEST(test_reset_stops_the_fan);
+  RUN_TEST(test_settings_are_clamped);
+  return UNITY_END();
+}
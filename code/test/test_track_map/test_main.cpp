@@ -0,0 +1,141 @@
+#include <unity.h>
+#include <track_map.h>
+#include <control.h>
+
+#define DRIVE_SPEED 50
+#define CURVE_TURN 20
+
+// A velocidad constante cada ciclo de CONTROL_LOOP_US avanza DRIVE_SPEED unidades
+#define CYCLES_PER_BIN (TRACK_MAP_BIN_UNITS / DRIVE_SPEED)
+
+static std::string output;
+
+/**
+ * @brief Ciclos de control con las mismas velocidades de los motores
+ *
+ */
+static void drive(int left_speed, int right_speed, int cycles) {
+  for (int cycle = 0; cycle < cycles; cycle++) {
+    track_map_update(left_speed, right_speed);
+  }
+}
+
+/**
+ * @brief Vuelta de aprendizaje de meta a meta: recta, curva a la derecha y recta
+ *
+ */
+static void learn_lap(int straight_bins, int curve_bins, int exit_bins) {
+  set_track_map_mode(TRACK_MAP_LEARN);
+  track_map_start();
+  drive(DRIVE_SPEED, DRIVE_SPEED, CYCLES_PER_BIN);
+  track_map_lap(0);
+  drive(DRIVE_SPEED, DRIVE_SPEED, straight_bins * CYCLES_PER_BIN);
+  drive(DRIVE_SPEED + CURVE_TURN, DRIVE_SPEED - CURVE_TURN, curve_bins * CYCLES_PER_BIN);
+  drive(DRIVE_SPEED, DRIVE_SPEED, exit_bins * CYCLES_PER_BIN);
+  track_map_lap(1);
+  track_map_stop();
+}
+
+void setUp() {
+  Serial.quiet = true;
+  set_track_map_speeds(TRACK_MAP_SPEED_STRAIGHT, TRACK_MAP_SPEED_CURVE);
+  output.clear();
+}
+
+void tearDown() {
+  Serial.capture = nullptr;
+}
+
+void test_replay_needs_a_map() {
+  set_track_map_mode(TRACK_MAP_REPLAY);
+  TEST_ASSERT_EQUAL(TRACK_MAP_OFF, get_track_map_mode());
+  TEST_ASSERT_EQUAL(33, get_track_map_speed(33));
+}
+
+void test_short_learning_lap_is_discarded() {
+  learn_lap(1, 1, 1);
+  TEST_ASSERT_EQUAL(TRACK_MAP_LEARN, get_track_map_mode());
+  TEST_ASSERT_EQUAL(33, get_track_map_speed(33));
+  set_track_map_mode(TRACK_MAP_REPLAY);
+  TEST_ASSERT_EQUAL(TRACK_MAP_LEARN, get_track_map_mode());
+}
+
+void test_learning_lap_switches_to_replay() {
+  learn_lap(30, 10, 20);
+  TEST_ASSERT_EQUAL(TRACK_MAP_REPLAY, get_track_map_mode());
+  // En la meta, tramo 0: recta con la curva lejos en ambos sentidos
+  track_map_lap(1);
+  TEST_ASSERT_EQUAL(TRACK_MAP_SPEED_STRAIGHT, get_track_map_speed(33));
+}
+
+void test_profile_brakes_before_and_accelerates_after_the_curve() {
+  learn_lap(30, 10, 20);
+  track_map_lap(1);
+  int previous = get_track_map_speed(0);
+  int slowest = previous;
+  int fastest = previous;
+  int first_slow_cycle = -1;
+  for (int cycle = 0; cycle < 60 * CYCLES_PER_BIN; cycle++) {
+    track_map_update(DRIVE_SPEED, DRIVE_SPEED);
+    int speed = get_track_map_speed(0);
+    TEST_ASSERT_TRUE(previous - speed <= TRACK_MAP_BRAKE_PER_BIN);
+    TEST_ASSERT_TRUE(speed - previous <= TRACK_MAP_ACCEL_PER_BIN);
+    if (speed == TRACK_MAP_SPEED_CURVE && first_slow_cycle < 0) {
+      first_slow_cycle = cycle;
+    }
+    slowest = min(slowest, speed);
+    fastest = max(fastest, speed);
+    previous = speed;
+  }
+  TEST_ASSERT_EQUAL(TRACK_MAP_SPEED_CURVE, slowest);
+  TEST_ASSERT_EQUAL(TRACK_MAP_SPEED_STRAIGHT, fastest);
+  // Ya a velocidad de curva antes de llegar a ella (tramos de anticipación)
+  TEST_ASSERT_TRUE(first_slow_cycle >= 0);
+  TEST_ASSERT_TRUE(first_slow_cycle < 30 * CYCLES_PER_BIN);
+}
+
+void test_speeds_recompute_the_profile() {
+  learn_lap(30, 10, 20);
+  set_track_map_speeds(60, 30);
+  track_map_lap(1);
+  TEST_ASSERT_EQUAL(60, get_track_map_speed(0));
+  int slowest = 100;
+  for (int cycle = 0; cycle < 60 * CYCLES_PER_BIN; cycle++) {
+    track_map_update(DRIVE_SPEED, DRIVE_SPEED);
+    slowest = min(slowest, get_track_map_speed(0));
+  }
+  TEST_ASSERT_EQUAL(30, slowest);
+  // La curva nunca por encima de la recta
+  set_track_map_speeds(50, 80);
+  TEST_ASSERT_EQUAL(50, get_track_map_curve_speed());
+}
+
+void test_finish_line_restarts_the_map() {
+  learn_lap(30, 10, 20);
+  track_map_lap(1);
+  drive(DRIVE_SPEED, DRIVE_SPEED, 32 * CYCLES_PER_BIN);
+  TEST_ASSERT_EQUAL(TRACK_MAP_SPEED_CURVE, get_track_map_speed(0));
+  track_map_lap(2);
+  TEST_ASSERT_EQUAL(TRACK_MAP_SPEED_STRAIGHT, get_track_map_speed(0));
+}
+
+void test_print_shows_the_curve_side() {
+  learn_lap(30, 10, 20);
+  Serial.capture = &output;
+  print_track_map();
+  TEST_ASSERT_TRUE(output.find("Recta") != std::string::npos);
+  TEST_ASSERT_TRUE(output.find("Curva D") != std::string::npos);
+  TEST_ASSERT_TRUE(output.find("Curva I") == std::string::npos);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_needs_a_map);
+  RUN_TEST(test_short_learning_lap_is_discarded);
+  RUN_TEST(test_learning_lap_switches_to_replay);
+  RUN_TEST(test_profile_brakes_before_and_accelerates_after_the_curve);
+  RUN_TEST(test_speeds_recompute_the_profile);
+  RUN_TEST(test_finish_line_restarts_the_map);
+  RUN_TEST(test_print_shows_the_curve_side);
+  return UNITY_END();
+}